@@ -0,0 +1,171 @@
+#include "AdaptiveTessellator.h"
+#include <algorithm>
+
+AdaptiveTessellator::AdaptiveTessellator(const BSplineSurface& surface, int maxDepth)
+    : surface(surface), maxDepth(maxDepth), cellUnits(1 << maxDepth)
+{
+}
+
+void AdaptiveTessellator::tessellate(float tolerance)
+{
+    leaves.clear();
+    cornersOnRow.clear();
+    cornersOnColumn.clear();
+    vertexLookup.clear();
+    vertices.clear();
+    triangles.clear();
+
+    //One root cell for each non-empty knot span. Inside a span the surface is a single polynomial (or rational) patch.
+    spansU = nonEmptySpans(surface.knotsU, surface.degreeU, surface.height);
+    spansV = nonEmptySpans(surface.knotsV, surface.degreeV, surface.width);
+    for (int i = 0; i < static_cast<int>(spansU.size()); ++i)
+    {
+        for (int j = 0; j < static_cast<int>(spansV.size()); ++j)
+        {
+            subdivide(j * cellUnits, i * cellUnits, cellUnits, 0, tolerance);
+        }
+    }
+
+    //All corners have to be known before the cells are triangulated, because a cell needs the corners
+    //of its smaller neighbours on its edges
+    for (const glm::ivec3& leaf : leaves)
+    {
+        int x0 = leaf.x, y0 = leaf.y, x1 = leaf.x + leaf.z, y1 = leaf.y + leaf.z;
+        cornersOnRow[y0].insert(x0);
+        cornersOnRow[y0].insert(x1);
+        cornersOnRow[y1].insert(x0);
+        cornersOnRow[y1].insert(x1);
+        cornersOnColumn[x0].insert(y0);
+        cornersOnColumn[x0].insert(y1);
+        cornersOnColumn[x1].insert(y0);
+        cornersOnColumn[x1].insert(y1);
+    }
+
+    for (const glm::ivec3& leaf : leaves)
+    {
+        triangulateCell(leaf.x, leaf.y, leaf.z);
+    }
+}
+
+void AdaptiveTessellator::subdivide(int x, int y, int size, int depth, float tolerance)
+{
+    //Always splits the root cell once, so a bump in the middle of a flat looking span is not missed
+    if (depth >= maxDepth || (depth > 0 && flatnessError(x, y, size) <= tolerance))
+    {
+        leaves.push_back(glm::ivec3(x, y, size));
+        return;
+    }
+    int half = size / 2;
+    subdivide(x, y, half, depth + 1, tolerance);
+    subdivide(x + half, y, half, depth + 1, tolerance);
+    subdivide(x, y + half, half, depth + 1, tolerance);
+    subdivide(x + half, y + half, half, depth + 1, tolerance);
+}
+
+float AdaptiveTessellator::flatnessError(int x, int y, int size) const
+{
+    int half = size / 2;
+    glm::vec3 p00 = evaluateAt(x, y);
+    glm::vec3 p10 = evaluateAt(x + size, y);
+    glm::vec3 p01 = evaluateAt(x, y + size);
+    glm::vec3 p11 = evaluateAt(x + size, y + size);
+
+    //Distance between the surface and the bilinear interpolation of the corners
+    float error = glm::length(evaluateAt(x + half, y + half) - 0.25f * (p00 + p10 + p01 + p11));
+    error = std::max(error, glm::length(evaluateAt(x + half, y) - 0.5f * (p00 + p10)));
+    error = std::max(error, glm::length(evaluateAt(x + half, y + size) - 0.5f * (p01 + p11)));
+    error = std::max(error, glm::length(evaluateAt(x, y + half) - 0.5f * (p00 + p01)));
+    error = std::max(error, glm::length(evaluateAt(x + size, y + half) - 0.5f * (p10 + p11)));
+    return error;
+}
+
+void AdaptiveTessellator::triangulateCell(int x, int y, int size)
+{
+    int x0 = x, y0 = y, x1 = x + size, y1 = y + size;
+
+    //Walks around the cell counter-clockwise and collects the corners and every vertex on the edges
+    std::vector<unsigned int> boundary;
+    const std::set<int>& bottom = cornersOnRow[y0];
+    for (auto it = bottom.lower_bound(x0); it != bottom.end() && *it < x1; ++it)
+        boundary.push_back(vertexIndex(*it, y0));
+    const std::set<int>& right = cornersOnColumn[x1];
+    for (auto it = right.lower_bound(y0); it != right.end() && *it < y1; ++it)
+        boundary.push_back(vertexIndex(x1, *it));
+    const std::set<int>& top = cornersOnRow[y1];
+    for (auto it = std::set<int>::const_reverse_iterator(top.upper_bound(x1)); it != top.rend() && *it > x0; ++it)
+        boundary.push_back(vertexIndex(*it, y1));
+    const std::set<int>& left = cornersOnColumn[x0];
+    for (auto it = std::set<int>::const_reverse_iterator(left.upper_bound(y1)); it != left.rend() && *it > y0; ++it)
+        boundary.push_back(vertexIndex(x0, *it));
+
+    if (boundary.size() == 4)
+    {
+        triangles.insert(triangles.end(), { boundary[0], boundary[1], boundary[2] });
+        triangles.insert(triangles.end(), { boundary[0], boundary[2], boundary[3] });
+        return;
+    }
+
+    //The cell has vertices from smaller neighbours on its edges. A fan from the middle of the cell
+    //uses all of them, so the edges match the neighbours exactly.
+    unsigned int center = vertexIndex(x + size / 2, y + size / 2);
+    for (size_t k = 0; k < boundary.size(); ++k)
+    {
+        triangles.insert(triangles.end(), { center, boundary[k], boundary[(k + 1) % boundary.size()] });
+    }
+}
+
+unsigned int AdaptiveTessellator::vertexIndex(int x, int y)
+{
+    std::uint64_t key = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(y)) << 32) | static_cast<std::uint32_t>(x);
+    auto found = vertexLookup.find(key);
+    if (found != vertexLookup.end())
+        return found->second;
+
+    unsigned int index = static_cast<unsigned int>(vertices.size());
+    vertices.push_back(evaluateAt(x, y));
+    vertexLookup[key] = index;
+    return index;
+}
+
+glm::vec3 AdaptiveTessellator::evaluateAt(int x, int y) const
+{
+    //x follows the columns (v) and y follows the rows (u), the same as in the control point grid
+    float u = parameter(surface.knotsU, spansU, y);
+    float v = parameter(surface.knotsV, spansV, x);
+    return surface.evaluate(u, v);
+}
+
+float AdaptiveTessellator::parameter(const std::vector<float>& knots, const std::vector<int>& spans, int coordinate) const
+{
+    //Integer coordinate to parameter value, inside the knot span the coordinate belongs to
+    int span = coordinate / cellUnits;
+    int lastSpan = static_cast<int>(spans.size()) - 1;
+    if (span > lastSpan)
+        span = lastSpan;
+    float fraction = static_cast<float>(coordinate - span * cellUnits) / cellUnits;
+    float start = knots[spans[span]];
+    float end = knots[spans[span] + 1];
+    return start + fraction * (end - start);
+}
+
+std::vector<int> AdaptiveTessellator::nonEmptySpans(const std::vector<float>& knots, int degree, int numPoints)
+{
+    std::vector<int> spans;
+    for (int k = degree; k < numPoints; ++k)
+    {
+        if (knots[k + 1] > knots[k])
+            spans.push_back(k);
+    }
+    return spans;
+}
+
+std::vector<unsigned int> AdaptiveTessellator::getLines() const
+{
+    std::vector<unsigned int> lines;
+    lines.reserve(triangles.size() * 2);
+    for (size_t t = 0; t < triangles.size(); t += 3)
+    {
+        lines.insert(lines.end(), { triangles[t], triangles[t + 1], triangles[t + 1], triangles[t + 2], triangles[t + 2], triangles[t] });
+    }
+    return lines;
+}
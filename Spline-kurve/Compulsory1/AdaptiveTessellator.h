@@ -0,0 +1,62 @@
+#ifndef ADAPTIVETESSELLATOR_H
+#define ADAPTIVETESSELLATOR_H
+
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "BSplineSurface.h"
+
+//Tessellates a B-spline surface with more triangles where it is curved and fewer where it is flat.
+//Every knot span is a root cell that is split in four until the surface inside the cell is flat enough.
+//The flatness is the largest distance between the surface and the bilinear patch through the cell corners,
+//measured in the middle of the cell and in the middle of each edge.
+//Cells are addressed with integer coordinates, 2^maxDepth units per knot span, so vertices that are shared
+//between cells get the same key. When a neighbour cell is split further, its corners on the shared edge
+//are added to the edge of the bigger cell, so there are no T-junctions and no cracks between the cells.
+class AdaptiveTessellator
+{
+public:
+    AdaptiveTessellator(const BSplineSurface& surface, int maxDepth = 6);
+
+    //Builds a new mesh. The tolerance is the largest flatness error allowed, in the same units as the control points.
+    void tessellate(float tolerance);
+
+    const std::vector<glm::vec3>& getVertices() const { return vertices; }
+    //Three indices per triangle
+    const std::vector<unsigned int>& getTriangles() const { return triangles; }
+    //The edges of the triangles, two indices per line. Used for drawing the mesh as a wireframe.
+    std::vector<unsigned int> getLines() const;
+
+private:
+    void subdivide(int x, int y, int size, int depth, float tolerance);
+    float flatnessError(int x, int y, int size) const;
+    void triangulateCell(int x, int y, int size);
+    unsigned int vertexIndex(int x, int y);
+    glm::vec3 evaluateAt(int x, int y) const;
+    float parameter(const std::vector<float>& knots, const std::vector<int>& spans, int coordinate) const;
+    static std::vector<int> nonEmptySpans(const std::vector<float>& knots, int degree, int numPoints);
+
+    const BSplineSurface& surface;
+    int maxDepth;
+    //Units per knot span
+    int cellUnits;
+    //The first knot of every knot span that is longer than zero. Repeated knots (for example in the exact
+    //circles of a NURBS surface) give empty spans, and those get no cells, so the cells stay next to each other.
+    std::vector<int> spansU;
+    std::vector<int> spansV;
+
+    //The leaf cells that are left after the subdivision (x, y, size)
+    std::vector<glm::ivec3> leaves;
+    //Cell corners on each horizontal line (y -> x) and each vertical line (x -> y)
+    std::map<int, std::set<int>> cornersOnRow;
+    std::map<int, std::set<int>> cornersOnColumn;
+
+    std::unordered_map<std::uint64_t, unsigned int> vertexLookup;
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> triangles;
+};
+
+#endif
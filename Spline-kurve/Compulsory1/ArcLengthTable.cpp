@@ -0,0 +1,177 @@
+#include "ArcLengthTable.h"
+#include <algorithm>
+#include <cmath>
+
+//Halving stops here even if the tolerance is not reached, 2^20 parts per knot span is far more than needed
+static const int MAX_DEPTH = 20;
+//How far the interpolated parameter may be from the real one, relative to the size of the interval
+static const double PARAMETER_TOLERANCE = 1e-4;
+
+//Five point Gauss-Legendre nodes and weights on [-1, 1]
+static const double GAUSS_NODES[5] = { 0.0, -0.5384693101056831, 0.5384693101056831, -0.9061798459386640, 0.9061798459386640 };
+static const double GAUSS_WEIGHTS[5] = { 0.5688888888888889, 0.4786286704993665, 0.4786286704993665, 0.2369268850561891, 0.2369268850561891 };
+
+ArcLengthTable::ArcLengthTable(const BSplineCurve& curve, float tolerance) : curve(curve)
+{
+    addEntry(curve.startParameter(), 0.0);
+
+    //Every knot span is integrated on its own, the curve can have a kink at a knot
+    int n = curve.numPoints();
+    for (int span = curve.degree; span < n; ++span)
+    {
+        double a = curve.knots[span];
+        double b = curve.knots[span + 1];
+        if (b <= a)
+            continue;
+        //Starts with four parts, so a span that is curved in the middle is not mistaken for a straight one
+        for (int part = 0; part < 4; ++part)
+        {
+            double start = a + (b - a) * part / 4.0;
+            double end = a + (b - a) * (part + 1) / 4.0;
+            double whole = gaussLegendre(start, end);
+            integrate(start, end, whole, tolerance * std::max(whole, 1e-12), 0);
+        }
+    }
+
+    //Hermite slopes from the exact speed of the curve
+    slopes.resize(parameters.size());
+    for (size_t k = 0; k < parameters.size(); ++k)
+    {
+        float speed = glm::length(curve.derivative(parameters[k]));
+        slopes[k] = speed > 0.0f ? 1.0f / speed : 0.0f;
+    }
+    //Fritsch-Carlson: the curve t(s) between two entries is monotone when both slopes are less than three times the secant
+    for (size_t k = 0; k + 1 < parameters.size(); ++k)
+    {
+        float secant = (parameters[k + 1] - parameters[k]) / (lengths[k + 1] - lengths[k]);
+        float alpha = slopes[k] / secant;
+        float beta = slopes[k + 1] / secant;
+        float sum = alpha * alpha + beta * beta;
+        if (sum > 9.0f)
+        {
+            float scale = 3.0f / std::sqrt(sum);
+            slopes[k] = scale * alpha * secant;
+            slopes[k + 1] = scale * beta * secant;
+        }
+    }
+}
+
+double ArcLengthTable::gaussLegendre(double a, double b) const
+{
+    double half = 0.5 * (b - a);
+    double middle = 0.5 * (a + b);
+    double sum = 0.0;
+    for (int k = 0; k < 5; ++k)
+        sum += GAUSS_WEIGHTS[k] * glm::length(curve.derivative(static_cast<float>(middle + half * GAUSS_NODES[k])));
+    return sum * half;
+}
+
+void ArcLengthTable::integrate(double a, double b, double whole, double tolerance, int depth)
+{
+    double middle = 0.5 * (a + b);
+    double left = gaussLegendre(a, middle);
+    double right = gaussLegendre(middle, b);
+
+    //The lookup interpolates t(s) between the entries, so the interval is also halved until the Hermite curve
+    //through its ends gives the middle parameter back at the middle length
+    double speedA = glm::length(curve.derivative(static_cast<float>(a)));
+    double speedB = glm::length(curve.derivative(static_cast<float>(b)));
+    double x = left / whole;
+    double predicted = a + (3.0 * x * x - 2.0 * x * x * x) * (b - a);
+    if (speedA > 0.0 && speedB > 0.0)
+        predicted += whole * ((x * x * x - 2.0 * x * x + x) / speedA + (x * x * x - x * x) / speedB);
+    bool smooth = std::abs(predicted - middle) <= PARAMETER_TOLERANCE * (b - a);
+
+    if (depth >= MAX_DEPTH || (smooth && std::abs(left + right - whole) <= tolerance))
+    {
+        double start = lengths.back();
+        addEntry(middle, start + left);
+        addEntry(b, start + left + right);
+        return;
+    }
+    integrate(a, middle, left, 0.5 * tolerance, depth + 1);
+    integrate(middle, b, right, 0.5 * tolerance, depth + 1);
+}
+
+void ArcLengthTable::addEntry(double t, double length)
+{
+    //Zero length parts (a cusp or a point where the curve stops) would give a division by zero in the lookup
+    if (!lengths.empty() && static_cast<float>(length) <= lengths.back())
+    {
+        parameters.back() = static_cast<float>(t);
+        return;
+    }
+    parameters.push_back(static_cast<float>(t));
+    lengths.push_back(static_cast<float>(length));
+}
+
+size_t ArcLengthTable::findInterval(float length) const
+{
+    //The last entry that is not after the length, never the very last entry so k + 1 is valid
+    size_t k = std::upper_bound(lengths.begin(), lengths.end(), length) - lengths.begin();
+    return std::min(k == 0 ? 0 : k - 1, lengths.size() - 2);
+}
+
+float ArcLengthTable::interpolate(size_t k, float length) const
+{
+    float h = lengths[k + 1] - lengths[k];
+    float x = glm::clamp((length - lengths[k]) / h, 0.0f, 1.0f);
+    float x2 = x * x;
+    float x3 = x2 * x;
+    //Cubic Hermite basis functions
+    float h00 = 2.0f * x3 - 3.0f * x2 + 1.0f;
+    float h10 = x3 - 2.0f * x2 + x;
+    float h01 = -2.0f * x3 + 3.0f * x2;
+    float h11 = x3 - x2;
+    return h00 * parameters[k] + h10 * h * slopes[k] + h01 * parameters[k + 1] + h11 * h * slopes[k + 1];
+}
+
+float ArcLengthTable::parameterAtLength(float length) const
+{
+    if (parameters.size() < 2)
+        return parameters.front();
+    return interpolate(findInterval(length), length);
+}
+
+void ArcLengthTable::parametersAtLengths(const float* queryLengths, size_t count, float* result) const
+{
+    if (parameters.size() < 2)
+    {
+        std::fill(result, result + count, parameters.front());
+        return;
+    }
+    size_t k = 0;
+    for (size_t q = 0; q < count; ++q)
+    {
+        float length = queryLengths[q];
+        //Walks a few entries forward, and falls back to the binary search for big jumps or when going backwards
+        int steps = 0;
+        while (k + 2 < lengths.size() && lengths[k + 1] <= length && steps < 8)
+        {
+            ++k;
+            ++steps;
+        }
+        if (length < lengths[k] || (k + 2 < lengths.size() && lengths[k + 1] <= length))
+            k = findInterval(length);
+        result[q] = interpolate(k, length);
+    }
+}
+
+void ArcLengthTable::parametersAtLengths(ThreadPool& pool, const float* queryLengths, size_t count, float* result) const
+{
+    pool.parallelFor(count, 4096, [&](size_t begin, size_t end)
+    {
+        parametersAtLengths(queryLengths + begin, end - begin, result + begin);
+    });
+}
+
+void ArcLengthTable::uniformSamples(size_t count, glm::vec3* points) const
+{
+    std::vector<float> queryLengths(count);
+    std::vector<float> result(count);
+    float step = count > 1 ? totalLength() / (count - 1) : 0.0f;
+    for (size_t k = 0; k < count; ++k)
+        queryLengths[k] = k * step;
+    parametersAtLengths(queryLengths.data(), count, result.data());
+    curve.evaluateBatch(result.data(), count, points);
+}
@@ -0,0 +1,47 @@
+#ifndef ARCLENGTHTABLE_H
+#define ARCLENGTHTABLE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "BSplineCurve.h"
+#include "ThreadPool.h"
+
+//Precomputed arc length of a curve, used to move along the curve with constant speed.
+//The length is integrated with Gauss-Legendre quadrature, and intervals are halved until the two halves agree
+//with the whole interval, so curved parts get more table entries than straight parts.
+//The parameter for a length is found with a binary search in the table and a cubic Hermite interpolation
+//of t(s), where the slopes dt/ds = 1 / |C'(t)| are limited (Fritsch-Carlson) so the result never goes backwards.
+class ArcLengthTable
+{
+public:
+    //The tolerance is relative to the length of each knot span
+    ArcLengthTable(const BSplineCurve& curve, float tolerance = 1e-6f);
+
+    float totalLength() const { return lengths.back(); }
+    size_t size() const { return parameters.size(); }
+
+    //Curve parameter at the given distance from the start, the length is clamped to [0, totalLength]
+    float parameterAtLength(float length) const;
+    //Many queries at once. Increasing lengths walk through the table instead of searching it.
+    void parametersAtLengths(const float* queryLengths, size_t count, float* result) const;
+    //The same split into blocks on the thread pool
+    void parametersAtLengths(ThreadPool& pool, const float* queryLengths, size_t count, float* result) const;
+
+    //count points with the same distance between them along the curve
+    void uniformSamples(size_t count, glm::vec3* points) const;
+
+private:
+    double gaussLegendre(double a, double b) const;
+    void integrate(double a, double b, double whole, double tolerance, int depth);
+    void addEntry(double t, double length);
+    float interpolate(size_t k, float length) const;
+    size_t findInterval(float length) const;
+
+    const BSplineCurve& curve;
+    std::vector<float> parameters;
+    std::vector<float> lengths;
+    //dt/ds at every entry after the monotonicity limit
+    std::vector<float> slopes;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "BSplineCurve.h"
+#include "BSplineSurface.h"
+
+//The highest degree the curve supports, the same as BSplineSurface
+static const int MAX_DEGREE = 7;
+
+BSplineCurve::BSplineCurve(const std::vector<glm::vec3>& points, int degree)
+    : BSplineCurve(points, std::vector<float>(points.size(), 1.0f), degree,
+        BSplineSurface::clampedUniformKnots(static_cast<int>(points.size()), degree))
+{
+}
+
+BSplineCurve::BSplineCurve(const std::vector<glm::vec3>& points, const std::vector<float>& weights, int degree, const std::vector<float>& knots)
+    : controlPoints(points), weights(weights), degree(degree), knots(knots)
+{
+    homogeneousPoints.resize(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        homogeneousPoints[i] = glm::vec4(points[i] * weights[i], weights[i]);
+}
+
+glm::vec3 BSplineCurve::evaluate(float t) const
+{
+    glm::vec3 point;
+    evaluateInSpan(BSplineSurface::findSpan(knots, degree, numPoints(), t), t, point, nullptr);
+    return point;
+}
+
+glm::vec3 BSplineCurve::derivative(float t) const
+{
+    glm::vec3 point, tangent;
+    evaluateInSpan(BSplineSurface::findSpan(knots, degree, numPoints(), t), t, point, &tangent);
+    return tangent;
+}
+
+void BSplineCurve::evaluate(float t, glm::vec3& point, glm::vec3& derivative) const
+{
+    evaluateInSpan(BSplineSurface::findSpan(knots, degree, numPoints(), t), t, point, &derivative);
+}
+
+void BSplineCurve::evaluateBatch(const float* parameters, size_t count, glm::vec3* points, glm::vec3* derivatives) const
+{
+    int n = numPoints();
+    int span = degree;
+    for (size_t k = 0; k < count; ++k)
+    {
+        float t = parameters[k];
+        //The last span also owns the end of the parameter range, the same as findSpan
+        bool inSpan = t >= knots[span] && (t < knots[span + 1] || (span == n - 1 && t <= knots[span + 1]));
+        if (!inSpan)
+            span = BSplineSurface::findSpan(knots, degree, n, t);
+        evaluateInSpan(span, t, points[k], derivatives != nullptr ? &derivatives[k] : nullptr);
+    }
+}
+
+void BSplineCurve::evaluateInSpan(int span, float t, glm::vec3& point, glm::vec3* derivative) const
+{
+    float basis[MAX_DEGREE + 1];
+    float basisDerivatives[MAX_DEGREE + 1];
+    if (derivative != nullptr)
+        basisFunctionsAndDerivatives(knots, degree, span, t, basis, basisDerivatives);
+    else
+        BSplineSurface::basisFunctions(knots, degree, span, t, basis);
+
+    const glm::vec4* first = &homogeneousPoints[span - degree];
+    glm::vec4 sum(0.0f);
+    for (int k = 0; k <= degree; ++k)
+        sum += basis[k] * first[k];
+    point = glm::vec3(sum) / sum.w;
+
+    if (derivative != nullptr)
+    {
+        //Quotient rule: C = A / w gives C' = (A' - w' * C) / w
+        glm::vec4 sumDerivative(0.0f);
+        for (int k = 0; k <= degree; ++k)
+            sumDerivative += basisDerivatives[k] * first[k];
+        *derivative = (glm::vec3(sumDerivative) - sumDerivative.w * point) / sum.w;
+    }
+}
+
+void BSplineCurve::basisFunctionsAndDerivatives(const std::vector<float>& knots, int degree, int span, float t, float* basis, float* derivatives)
+{
+    BSplineSurface::basisFunctions(knots, degree, span, t, basis);
+    if (degree == 0)
+    {
+        derivatives[0] = 0.0f;
+        return;
+    }
+
+    //The derivative of a basis function of degree p is made from the two basis functions of degree p - 1 under it
+    //(The NURBS Book, equation 2.7). lower[k] belongs to control point span - degree + 1 + k.
+    //Repeated knots give zero length intervals, the basis function under them is zero and the term is left out.
+    float lower[MAX_DEGREE + 1];
+    BSplineSurface::basisFunctions(knots, degree - 1, span, t, lower);
+    for (int k = 0; k <= degree; ++k)
+    {
+        int j = span - degree + k;
+        float value = 0.0f;
+        if (k >= 1 && knots[j + degree] > knots[j])
+            value += lower[k - 1] / (knots[j + degree] - knots[j]);
+        if (k < degree && knots[j + degree + 1] > knots[j + 1])
+            value -= lower[k] / (knots[j + degree + 1] - knots[j + 1]);
+        derivatives[k] = degree * value;
+    }
+}
+
+void BSplineCurve::setControlPoint(int index, const glm::vec3& point)
+{
+    controlPoints[index] = point;
+    homogeneousPoints[index] = glm::vec4(point * weights[index], weights[index]);
+}
+
+void BSplineCurve::setWeight(int index, float weight)
+{
+    weights[index] = weight;
+    homogeneousPoints[index] = glm::vec4(controlPoints[index] * weight, weight);
+}
@@ -0,0 +1,47 @@
+#ifndef BSPLINECURVE_H
+#define BSPLINECURVE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+//A B-spline curve, polynomial or rational (NURBS), with the same conventions as BSplineSurface:
+//the curve is evaluated in homogeneous coordinates (w * point, w) and divided by w at the end.
+class BSplineCurve
+{
+public:
+    std::vector<glm::vec3> controlPoints;
+    std::vector<float> weights;
+    //The weighted control points (w * point, w), kept up to date by setControlPoint and setWeight
+    std::vector<glm::vec4> homogeneousPoints;
+    int degree;
+    std::vector<float> knots;
+
+    //Polynomial curve with a clamped uniform knot vector
+    BSplineCurve(const std::vector<glm::vec3>& points, int degree);
+    //Rational curve with given weights and knot vector
+    BSplineCurve(const std::vector<glm::vec3>& points, const std::vector<float>& weights, int degree, const std::vector<float>& knots);
+
+    glm::vec3 evaluate(float t) const;
+    //First derivative with respect to t
+    glm::vec3 derivative(float t) const;
+    void evaluate(float t, glm::vec3& point, glm::vec3& derivative) const;
+
+    //Evaluates many parameters at once. The knot span of the previous parameter is tried first, so sorted
+    //parameters skip most of the span searches. derivatives can be nullptr if they are not needed.
+    void evaluateBatch(const float* parameters, size_t count, glm::vec3* points, glm::vec3* derivatives = nullptr) const;
+
+    void setControlPoint(int index, const glm::vec3& point);
+    void setWeight(int index, float weight);
+
+    int numPoints() const { return static_cast<int>(controlPoints.size()); }
+    float startParameter() const { return knots[degree]; }
+    float endParameter() const { return knots[controlPoints.size()]; }
+
+    //The degree + 1 basis functions of the span and their first derivatives
+    static void basisFunctionsAndDerivatives(const std::vector<float>& knots, int degree, int span, float t, float* basis, float* derivatives);
+
+private:
+    void evaluateInSpan(int span, float t, glm::vec3& point, glm::vec3* derivative) const;
+};
+
+#endif
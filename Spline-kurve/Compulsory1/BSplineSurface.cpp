@@ -0,0 +1,282 @@
+#include "BSplineSurface.h"
+#include "BSplineCurve.h"
+#include <cmath>
+
+//The highest degree the surface supports. Used for the fixed size arrays with basis functions.
+static const int MAX_DEGREE = 7;
+
+BSplineSurface::BSplineSurface(const std::vector<glm::vec3>& points, int width, int degreeU, int degreeV)
+    : BSplineSurface(points, std::vector<float>(points.size(), 1.0f), width, degreeU, degreeV,
+        clampedUniformKnots(static_cast<int>(points.size()) / width, degreeU), clampedUniformKnots(width, degreeV))
+{
+}
+
+BSplineSurface::BSplineSurface(const std::vector<glm::vec3>& points, const std::vector<float>& weights, int width, int degreeU, int degreeV,
+    const std::vector<float>& knotsU, const std::vector<float>& knotsV)
+    : controlPoints(points), weights(weights), width(width), height(static_cast<int>(points.size()) / width),
+    degreeU(degreeU), degreeV(degreeV), knotsU(knotsU), knotsV(knotsV)
+{
+    homogeneousPoints.resize(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        homogeneousPoints[i] = glm::vec4(points[i] * weights[i], weights[i]);
+}
+
+glm::vec3 BSplineSurface::evaluate(float u, float v) const
+{
+    float basisU[MAX_DEGREE + 1];
+    float basisV[MAX_DEGREE + 1];
+    int spanU = findSpan(knotsU, degreeU, height, u);
+    int spanV = findSpan(knotsV, degreeV, width, v);
+    basisFunctions(knotsU, degreeU, spanU, u, basisU);
+    basisFunctions(knotsV, degreeV, spanV, v, basisV);
+
+    //Only the (degreeU + 1) x (degreeV + 1) control points of the span contribute to the point
+    glm::vec4 point(0.0f);
+    for (int i = 0; i <= degreeU; ++i)
+    {
+        int row = spanU - degreeU + i;
+        glm::vec4 rowPoint(0.0f);
+        for (int j = 0; j <= degreeV; ++j)
+        {
+            rowPoint += basisV[j] * homogeneousPoints[row * width + spanV - degreeV + j];
+        }
+        point += basisU[i] * rowPoint;
+    }
+    return glm::vec3(point) / point.w;
+}
+
+void BSplineSurface::evaluate(float u, float v, glm::vec3& point, glm::vec3& derivativeU, glm::vec3& derivativeV) const
+{
+    float basisU[MAX_DEGREE + 1], basisDerivativeU[MAX_DEGREE + 1];
+    float basisV[MAX_DEGREE + 1], basisDerivativeV[MAX_DEGREE + 1];
+    int spanU = findSpan(knotsU, degreeU, height, u);
+    int spanV = findSpan(knotsV, degreeV, width, v);
+    BSplineCurve::basisFunctionsAndDerivatives(knotsU, degreeU, spanU, u, basisU, basisDerivativeU);
+    BSplineCurve::basisFunctionsAndDerivatives(knotsV, degreeV, spanV, v, basisV, basisDerivativeV);
+
+    //The homogeneous point and its derivatives, then the quotient rule: (A / w)' = (A' - w' * point) / w
+    glm::vec4 sum(0.0f), sumU(0.0f), sumV(0.0f);
+    for (int i = 0; i <= degreeU; ++i)
+    {
+        int row = spanU - degreeU + i;
+        glm::vec4 rowPoint(0.0f), rowDerivative(0.0f);
+        for (int j = 0; j <= degreeV; ++j)
+        {
+            const glm::vec4& control = homogeneousPoints[row * width + spanV - degreeV + j];
+            rowPoint += basisV[j] * control;
+            rowDerivative += basisDerivativeV[j] * control;
+        }
+        sum += basisU[i] * rowPoint;
+        sumU += basisDerivativeU[i] * rowPoint;
+        sumV += basisU[i] * rowDerivative;
+    }
+    point = glm::vec3(sum) / sum.w;
+    derivativeU = (glm::vec3(sumU) - sumU.w * point) / sum.w;
+    derivativeV = (glm::vec3(sumV) - sumV.w * point) / sum.w;
+}
+
+void BSplineSurface::setControlPoint(int index, const glm::vec3& point)
+{
+    controlPoints[index] = point;
+    homogeneousPoints[index] = glm::vec4(point * weights[index], weights[index]);
+}
+
+void BSplineSurface::setWeight(int index, float weight)
+{
+    weights[index] = weight;
+    homogeneousPoints[index] = glm::vec4(controlPoints[index] * weight, weight);
+}
+
+//Boehm knot insertion on one line of control points. The points of the line are count points apart (stride) in
+//the input and in the output, and the output has one point more. Only the degree points in the span of t change.
+static void insertKnotInLine(const std::vector<float>& knots, int degree, int span, float t,
+    const glm::vec4* in, glm::vec4* out, int numPoints, int stride)
+{
+    for (int i = 0; i <= numPoints; ++i)
+    {
+        if (i <= span - degree)
+            out[i * stride] = in[i * stride];
+        else if (i > span)
+            out[i * stride] = in[(i - 1) * stride];
+        else
+        {
+            float alpha = (t - knots[i]) / (knots[i + degree] - knots[i]);
+            out[i * stride] = alpha * in[i * stride] + (1.0f - alpha) * in[(i - 1) * stride];
+        }
+    }
+}
+
+void BSplineSurface::insertKnotU(float u)
+{
+    int span = findSpan(knotsU, degreeU, height, u);
+    //The columns are the lines in the u direction
+    std::vector<glm::vec4> refined((height + 1) * width);
+    for (int c = 0; c < width; ++c)
+        insertKnotInLine(knotsU, degreeU, span, u, &homogeneousPoints[c], &refined[c], height, width);
+    knotsU.insert(knotsU.begin() + span + 1, u);
+    height += 1;
+    setHomogeneousPoints(refined);
+}
+
+void BSplineSurface::insertKnotV(float v)
+{
+    int span = findSpan(knotsV, degreeV, width, v);
+    std::vector<glm::vec4> refined(height * (width + 1));
+    for (int r = 0; r < height; ++r)
+        insertKnotInLine(knotsV, degreeV, span, v, &homogeneousPoints[r * width], &refined[r * (width + 1)], width, 1);
+    knotsV.insert(knotsV.begin() + span + 1, v);
+    width += 1;
+    setHomogeneousPoints(refined);
+}
+
+void BSplineSurface::refineU(const std::vector<float>& newKnots)
+{
+    for (float u : newKnots)
+        insertKnotU(u);
+}
+
+void BSplineSurface::refineV(const std::vector<float>& newKnots)
+{
+    for (float v : newKnots)
+        insertKnotV(v);
+}
+
+//The inner knots that have to be inserted to make every inner knot repeated degree times
+static std::vector<float> bezierKnots(const std::vector<float>& knots, int degree, int numPoints)
+{
+    std::vector<float> missing;
+    int k = degree + 1;
+    while (k < numPoints)
+    {
+        int multiplicity = 1;
+        while (k + multiplicity < numPoints && knots[k + multiplicity] == knots[k])
+            ++multiplicity;
+        for (int m = multiplicity; m < degree; ++m)
+            missing.push_back(knots[k]);
+        k += multiplicity;
+    }
+    return missing;
+}
+
+BSplineSurface BSplineSurface::bezierForm() const
+{
+    BSplineSurface bezier(*this);
+    bezier.refineU(bezierKnots(knotsU, degreeU, height));
+    bezier.refineV(bezierKnots(knotsV, degreeV, width));
+    return bezier;
+}
+
+void BSplineSurface::setHomogeneousPoints(const std::vector<glm::vec4>& points)
+{
+    homogeneousPoints = points;
+    controlPoints.resize(points.size());
+    weights.resize(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        weights[i] = points[i].w;
+        controlPoints[i] = glm::vec3(points[i]) / points[i].w;
+    }
+}
+
+int BSplineSurface::findSpan(const std::vector<float>& knots, int degree, int numPoints, float t)
+{
+    //The end of the parameter range belongs to the last span
+    if (t >= knots[numPoints])
+        return numPoints - 1;
+    if (t <= knots[degree])
+        return degree;
+
+    //Binary search in the knot vector
+    int low = degree;
+    int high = numPoints;
+    int mid = (low + high) / 2;
+    while (t < knots[mid] || t >= knots[mid + 1])
+    {
+        if (t < knots[mid])
+            high = mid;
+        else
+            low = mid;
+        mid = (low + high) / 2;
+    }
+    return mid;
+}
+
+void BSplineSurface::basisFunctions(const std::vector<float>& knots, int degree, int span, float t, float* basis)
+{
+    //Cox-de Boor recursion written without the zero terms (The NURBS Book, algorithm A2.2)
+    float left[MAX_DEGREE + 1];
+    float right[MAX_DEGREE + 1];
+    basis[0] = 1.0f;
+    for (int j = 1; j <= degree; ++j)
+    {
+        left[j] = t - knots[span + 1 - j];
+        right[j] = knots[span + j] - t;
+        float saved = 0.0f;
+        for (int r = 0; r < j; ++r)
+        {
+            float temp = basis[r] / (right[r + 1] + left[j - r]);
+            basis[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        basis[j] = saved;
+    }
+}
+
+std::vector<float> BSplineSurface::clampedUniformKnots(int numPoints, int degree)
+{
+    //degree + 1 equal knots at each end and uniformly spaced knots in between
+    std::vector<float> knots(numPoints + degree + 1);
+    int innerSpans = numPoints - degree;
+    for (int i = 0; i < static_cast<int>(knots.size()); ++i)
+    {
+        if (i <= degree)
+            knots[i] = 0.0f;
+        else if (i >= numPoints)
+            knots[i] = 1.0f;
+        else
+            knots[i] = static_cast<float>(i - degree) / innerSpans;
+    }
+    return knots;
+}
+
+BSplineSurface BSplineSurface::revolve(const std::vector<glm::vec3>& profile, const std::vector<float>& profileWeights,
+    const std::vector<float>& profileKnots, int profileDegree)
+{
+    //The corners and the edge midpoints of a square around the axis. The corners get the weight cos(45),
+    //which makes the quadratic curve through them an exact circle.
+    const float corner = std::sqrt(0.5f);
+    const glm::vec2 directions[9] = {
+        glm::vec2(1.0f, 0.0f), glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f), glm::vec2(-1.0f, 1.0f), glm::vec2(-1.0f, 0.0f),
+        glm::vec2(-1.0f, -1.0f), glm::vec2(0.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 0.0f) };
+    const float circleWeights[9] = { 1.0f, corner, 1.0f, corner, 1.0f, corner, 1.0f, corner, 1.0f };
+    const std::vector<float> circleKnots = { 0.0f, 0.0f, 0.0f, 0.25f, 0.25f, 0.5f, 0.5f, 0.75f, 0.75f, 1.0f, 1.0f, 1.0f };
+
+    std::vector<glm::vec3> points;
+    std::vector<float> weights;
+    for (size_t r = 0; r < profile.size(); ++r)
+    {
+        for (int c = 0; c < 9; ++c)
+        {
+            points.push_back(glm::vec3(profile[r].x * directions[c].x, profile[r].x * directions[c].y, profile[r].z));
+            weights.push_back(profileWeights[r] * circleWeights[c]);
+        }
+    }
+    return BSplineSurface(points, weights, 9, profileDegree, 2, profileKnots, circleKnots);
+}
+
+BSplineSurface BSplineSurface::cylinder(float radius, float height)
+{
+    //A straight line from the bottom to the top
+    std::vector<glm::vec3> profile = { glm::vec3(radius, 0.0f, 0.0f), glm::vec3(radius, 0.0f, height) };
+    return revolve(profile, { 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f, 1.0f }, 1);
+}
+
+BSplineSurface BSplineSurface::sphere(float radius)
+{
+    //Half a circle from the south pole to the north pole
+    const float corner = std::sqrt(0.5f);
+    std::vector<glm::vec3> profile = {
+        glm::vec3(0.0f, 0.0f, -radius), glm::vec3(radius, 0.0f, -radius), glm::vec3(radius, 0.0f, 0.0f),
+        glm::vec3(radius, 0.0f, radius), glm::vec3(0.0f, 0.0f, radius) };
+    return revolve(profile, { 1.0f, corner, 1.0f, corner, 1.0f }, { 0.0f, 0.0f, 0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f }, 2);
+}
@@ -0,0 +1,79 @@
+#ifndef BSPLINESURFACE_H
+#define BSPLINESURFACE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+//A tensor product B-spline surface, polynomial or rational (NURBS).
+//The control points are stored row by row, the same way as the controlPoints vector in main:
+//controlPoints[row * width + column]. The u parameter runs over the rows and v runs over the columns.
+//Every control point only influences the part of the surface inside its knot spans (local support),
+//which is what makes it possible to update only a small part of the surface when a point is moved.
+//Every control point has a weight. The surface is always evaluated in homogeneous coordinates
+//(w * x, w * y, w * z, w) and divided by w at the end, so a polynomial surface is just a NURBS surface
+//with all weights 1 and both kinds go through the same code.
+class BSplineSurface
+{
+public:
+    std::vector<glm::vec3> controlPoints;
+    std::vector<float> weights;
+    //The weighted control points (w * point, w), kept up to date by setControlPoint and setWeight
+    std::vector<glm::vec4> homogeneousPoints;
+    //Number of control points in the v direction (columns) and the u direction (rows)
+    int width;
+    int height;
+    int degreeU;
+    int degreeV;
+    std::vector<float> knotsU;
+    std::vector<float> knotsV;
+
+    //Polynomial surface with clamped uniform knot vectors
+    BSplineSurface(const std::vector<glm::vec3>& points, int width, int degreeU, int degreeV);
+    //Rational surface with given weights and knot vectors
+    BSplineSurface(const std::vector<glm::vec3>& points, const std::vector<float>& weights, int width, int degreeU, int degreeV,
+        const std::vector<float>& knotsU, const std::vector<float>& knotsV);
+
+    //Calculates the point on the surface for the parameters u and v in the range 0 to 1
+    glm::vec3 evaluate(float u, float v) const;
+    //The point and the first partial derivatives with respect to u and v
+    void evaluate(float u, float v, glm::vec3& point, glm::vec3& derivativeU, glm::vec3& derivativeV) const;
+
+    //Moves one control point. The index is the same as the index in the controlPoints vector
+    void setControlPoint(int index, const glm::vec3& point);
+    void setWeight(int index, float weight);
+
+    //Knot insertion (Boehm). Adds the knot to knotsU or knotsV and one row or column of control points,
+    //without changing the shape of the surface. The new control points are calculated in homogeneous coordinates.
+    void insertKnotU(float u);
+    void insertKnotV(float v);
+    //Inserts several knots, one at a time (the knots do not need to be sorted)
+    void refineU(const std::vector<float>& newKnots);
+    void refineV(const std::vector<float>& newKnots);
+    //The same surface split into Bezier patches: every inner knot is inserted until it is repeated degree times,
+    //so the control points of each knot span can be used on their own
+    BSplineSurface bezierForm() const;
+
+    //Finds the knot span [knots[span], knots[span + 1]) that contains the parameter t
+    static int findSpan(const std::vector<float>& knots, int degree, int numPoints, float t);
+
+    //Calculates the degree + 1 basis functions that are non-zero in the given span.
+    //basis[k] belongs to control point span - degree + k.
+    static void basisFunctions(const std::vector<float>& knots, int degree, int span, float t, float* basis);
+
+    //Makes a clamped uniform knot vector, the curve starts at the first and ends at the last control point
+    static std::vector<float> clampedUniformKnots(int numPoints, int degree);
+
+    //Surface of revolution: the profile is a NURBS curve in the xz plane (x is the radius) that is turned a full
+    //circle around the z axis. The circle is an exact quadratic NURBS with 9 control points, so the rows (u) follow
+    //the profile and the columns (v) go around the axis.
+    static BSplineSurface revolve(const std::vector<glm::vec3>& profile, const std::vector<float>& profileWeights,
+        const std::vector<float>& profileKnots, int profileDegree);
+    static BSplineSurface cylinder(float radius, float height);
+    static BSplineSurface sphere(float radius);
+
+private:
+    //Sets controlPoints and weights from new homogeneous points after the size of the net has changed
+    void setHomogeneousPoints(const std::vector<glm::vec4>& points);
+};
+
+#endif
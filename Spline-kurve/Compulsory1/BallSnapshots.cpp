@@ -0,0 +1,49 @@
+#include "BallSnapshots.h"
+#include <algorithm>
+
+void BallSnapshots::publish(const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z, double time)
+{
+    //When the balls have been replaced, there is nothing to blend from
+    if (lastX.size() != x.size())
+    {
+        lastX = x;
+        lastY = y;
+        lastZ = z;
+    }
+
+    BallSnapshot& snapshot = buffer.writeBuffer();
+    snapshot.previousX = lastX;
+    snapshot.previousY = lastY;
+    snapshot.previousZ = lastZ;
+    snapshot.x = x;
+    snapshot.y = y;
+    snapshot.z = z;
+    snapshot.time = time;
+    buffer.publish();
+
+    lastX = x;
+    lastY = y;
+    lastZ = z;
+}
+
+size_t BallSnapshots::interpolate(double now, double timeStep, std::vector<float>& x, std::vector<float>& y, std::vector<float>& z)
+{
+    buffer.update();
+    const BallSnapshot& snapshot = buffer.readBuffer();
+    size_t count = snapshot.x.size();
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+
+    //The previous positions belong to time - timeStep, and the render time is now - timeStep. The newest snapshot
+    //is at most one step old, so the render time is between its two positions and the blend goes from 0 to 1.
+    double renderTime = now - timeStep;
+    float blend = static_cast<float>(std::min(std::max((renderTime - (snapshot.time - timeStep)) / timeStep, 0.0), 1.0));
+    for (size_t i = 0; i < count; ++i)
+    {
+        x[i] = snapshot.previousX[i] + (snapshot.x[i] - snapshot.previousX[i]) * blend;
+        y[i] = snapshot.previousY[i] + (snapshot.y[i] - snapshot.previousY[i]) * blend;
+        z[i] = snapshot.previousZ[i] + (snapshot.z[i] - snapshot.previousZ[i]) * blend;
+    }
+    return count;
+}
@@ -0,0 +1,34 @@
+#ifndef BALLSNAPSHOTS_H
+#define BALLSNAPSHOTS_H
+
+#include <vector>
+#include <cstddef>
+#include "TripleBuffer.h"
+
+//The ball positions after one simulation step and the positions one step before, at the given time
+struct BallSnapshot
+{
+    std::vector<float> previousX, previousY, previousZ;
+    std::vector<float> x, y, z;
+    double time = 0.0;
+};
+
+//Moves ball positions from the simulation thread to the render thread through a triple buffer.
+//The render thread draws one time step behind the simulation and blends the two positions in the newest snapshot,
+//so the balls move smoothly even when the frame rate and the simulation rate are different.
+class BallSnapshots
+{
+public:
+    //Simulation thread: the positions after a step that ends at time
+    void publish(const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z, double time);
+
+    //Render thread: the positions at the time now - timeStep. Returns the number of balls.
+    size_t interpolate(double now, double timeStep, std::vector<float>& x, std::vector<float>& y, std::vector<float>& z);
+
+private:
+    TripleBuffer<BallSnapshot> buffer;
+    //The positions of the last published snapshot, kept by the simulation thread for the previous positions of the next one
+    std::vector<float> lastX, lastY, lastZ;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <glad/glad.h>
+#include "Flythrough.h"
+#include "Profiler.h"
+
+//Runs the render loop for a fixed number of frames with the camera on a flythrough, and writes a JSON report.
+//The window is hidden and the frames are drawn into a framebuffer object of their own, so nothing depends on a
+//visible window and the benchmark can run without a display (an invisible GLFW window on Mesa llvmpipe works).
+//The animation time moves 1/60 second per frame, not with the clock. The simulations are stepped with the same time
+//on the render thread (SimulationThread::runUntil), so the camera and the simulations are the same in every run.
+//The first warmupFrames frames are drawn but not counted, they include the first uploads and shader compiles. The
+//statistics of the profiler are reset when they end, so the scopes in the report cover the same frames as the frame
+//times. The profiler has to keep at least frames samples per scope for that.
+class Benchmark
+{
+public:
+    Benchmark(const Flythrough& path, int frames, int warmupFrames = 10);
+    ~Benchmark();
+
+    Benchmark(const Benchmark&) = delete;
+    Benchmark& operator=(const Benchmark&) = delete;
+
+    //Makes the framebuffer with a colour and a depth buffer and binds it
+    void createTarget(int width, int height);
+    //Measures the frame that ended and moves the camera on. Returns false when all frames are drawn.
+    bool nextFrame(Camera& camera, Profiler& profiler);
+    //The animation time of the frame in seconds
+    float time() const;
+
+    //The frame times in milliseconds with their percentiles, and the CPU and GPU scopes of the profiler
+    bool writeReport(const std::string& path, const std::string& program, const Profiler& profiler) const;
+
+private:
+    Flythrough path;
+    int frames;
+    int warmupFrames;
+    int frame;
+    std::chrono::steady_clock::time_point frameStart;
+    std::vector<double> frameTimes;
+
+    GLuint framebuffer, colorBuffer, depthBuffer;
+    int width, height;
+};
+
+#endif
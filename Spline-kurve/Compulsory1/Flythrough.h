@@ -0,0 +1,37 @@
+#ifndef FLYTHROUGH_H
+#define FLYTHROUGH_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Camera.h"
+
+//A camera path for benchmarks. The keyframes are camera positions with a point to look at, and the path is a closed
+//Catmull-Rom spline through them, so the camera moves smoothly and ends where it started. The same t always gives
+//the same view, so two runs of a benchmark draw the same frames.
+class Flythrough
+{
+public:
+    struct Keyframe
+    {
+        glm::vec3 position;
+        glm::vec3 target;
+    };
+    std::vector<Keyframe> keyframes;
+
+    //A circle around center in the xy plane, height above it, looking at center
+    static Flythrough orbit(const glm::vec3& center, float radius, float height, int keyframeCount = 8);
+
+    //A keyframe file has one keyframe per line: the position and the target, six numbers
+    bool load(const std::string& path);
+    //Adds the view of the camera to the end of a keyframe file, so a path can be recorded while flying around
+    static bool appendKeyframe(const std::string& path, const Camera& camera);
+
+    //Puts the camera on the path. t from 0 to 1 goes around the whole path once.
+    void apply(Camera& camera, float t) const;
+
+private:
+    static glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t);
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "ForwardDifferenceTessellator.h"
+
+//The highest degree the tessellator supports, the same as BSplineSurface
+static const int MAX_DEGREE = 7;
+
+//The same recursion as BSplineSurface::basisFunctions, but in double. The higher differences are small numbers
+//made from the difference of almost equal values, so they lose too many digits in float.
+static void basisFunctionsDouble(const std::vector<float>& knots, int degree, int span, double t, double* basis)
+{
+    double left[MAX_DEGREE + 1];
+    double right[MAX_DEGREE + 1];
+    basis[0] = 1.0;
+    for (int j = 1; j <= degree; ++j)
+    {
+        left[j] = t - knots[span + 1 - j];
+        right[j] = knots[span + j] - t;
+        double saved = 0.0;
+        for (int r = 0; r < j; ++r)
+        {
+            double temp = basis[r] / (right[r + 1] + left[j - r]);
+            basis[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        basis[j] = saved;
+    }
+}
+
+ForwardDifferenceTessellator::ForwardDifferenceTessellator(const BSplineSurface& surface, int samplesU, int samplesV, int reseedInterval)
+    : surface(surface), samplesU(samplesU), samplesV(samplesV)
+{
+    int orderU = surface.degreeU + 1;
+    int orderV = surface.degreeV + 1;
+    spansU.resize(samplesU);
+    basisU.resize(samplesU * orderU);
+    blendedRow.resize(surface.width);
+    for (int i = 0; i < samplesU; ++i)
+    {
+        float u = i / static_cast<float>(samplesU - 1);
+        spansU[i] = BSplineSurface::findSpan(surface.knotsU, surface.degreeU, surface.height, u);
+        BSplineSurface::basisFunctions(surface.knotsU, surface.degreeU, spansU[i], u, &basisU[i * orderU]);
+    }
+
+    //A new seed at the first sample, at every change of knot span and after reseedInterval steps
+    double step = 1.0 / (samplesV - 1);
+    int lastSeed = 0;
+    for (int j = 0; j < samplesV; ++j)
+    {
+        float v = j / static_cast<float>(samplesV - 1);
+        int span = BSplineSurface::findSpan(surface.knotsV, surface.degreeV, surface.width, v);
+        if (j > 0 && span == seeds.back().span && j - lastSeed < reseedInterval)
+            continue;
+        seeds.push_back({ j, span });
+        lastSeed = j;
+
+        //The basis functions of the span at the seed and the next degreeV samples. The span is kept fixed, so the
+        //values belong to the same polynomial even if the samples are past the end of the span.
+        double values[MAX_DEGREE + 1][MAX_DEGREE + 1];
+        for (int m = 0; m < orderV; ++m)
+            basisFunctionsDouble(surface.knotsV, surface.degreeV, span, (j + m) * step, values[m]);
+
+        //Difference table: after round k, values[0] holds the k-th difference
+        for (int k = 0; k < orderV; ++k)
+        {
+            for (int b = 0; b < orderV; ++b)
+                basisDifferences.push_back(static_cast<float>(values[0][b]));
+            for (int m = 0; m + 1 < orderV - k; ++m)
+            {
+                for (int b = 0; b < orderV; ++b)
+                    values[m][b] = values[m + 1][b] - values[m][b];
+            }
+        }
+    }
+}
+
+void ForwardDifferenceTessellator::tessellate(glm::vec3* out)
+{
+    for (int i = 0; i < samplesU; ++i)
+        tessellateRow(i, out + static_cast<size_t>(i) * samplesV);
+}
+
+void ForwardDifferenceTessellator::tessellateInto(GLuint vbo)
+{
+    GLsizeiptr size = static_cast<GLsizeiptr>(samplesU) * samplesV * sizeof(glm::vec3);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    //The old content is not needed, so the driver can give a new block of memory instead of waiting for the GPU.
+    //glUnmapBuffer returns false if the memory was lost while it was mapped, then the rows are written again once.
+    //If that fails too, or the buffer cannot be mapped, the rows are made in memory and uploaded with glBufferSubData.
+    bool written = false;
+    for (int attempt = 0; attempt < 2 && !written; ++attempt)
+    {
+        void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped == nullptr)
+            break;
+        tessellate(static_cast<glm::vec3*>(mapped));
+        written = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+    }
+    if (!written)
+    {
+        std::vector<glm::vec3> points(static_cast<size_t>(samplesU) * samplesV);
+        tessellate(points.data());
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, points.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ForwardDifferenceTessellator::tessellateRow(int i, glm::vec3* out)
+{
+    int orderU = surface.degreeU + 1;
+    int orderV = surface.degreeV + 1;
+    int width = surface.width;
+
+    //Blends the control point rows in the u direction
+    const float* nu = &basisU[i * orderU];
+    const glm::vec4* firstRow = &surface.homogeneousPoints[(spansU[i] - surface.degreeU) * width];
+    for (int c = 0; c < width; ++c)
+    {
+        glm::vec4 sum(0.0f);
+        for (int a = 0; a < orderU; ++a)
+            sum += nu[a] * firstRow[a * width + c];
+        blendedRow[c] = sum;
+    }
+
+    glm::vec4 differences[MAX_DEGREE + 1];
+    for (size_t s = 0; s < seeds.size(); ++s)
+    {
+        //Exact differences at the seed from the difference table of the basis functions
+        const glm::vec4* blended = &blendedRow[seeds[s].span - surface.degreeV];
+        const float* table = &basisDifferences[s * orderV * orderV];
+        for (int k = 0; k < orderV; ++k)
+        {
+            glm::vec4 sum(0.0f);
+            for (int b = 0; b < orderV; ++b)
+                sum += table[k * orderV + b] * blended[b];
+            differences[k] = sum;
+        }
+
+        int end = s + 1 < seeds.size() ? seeds[s + 1].column : samplesV;
+        for (int j = seeds[s].column; j < end; ++j)
+        {
+            out[j] = glm::vec3(differences[0]) / differences[0].w;
+            for (int k = 0; k < surface.degreeV; ++k)
+                differences[k] += differences[k + 1];
+        }
+    }
+}
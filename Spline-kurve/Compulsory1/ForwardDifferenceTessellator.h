@@ -0,0 +1,56 @@
+#ifndef FORWARDDIFFERENCETESSELLATOR_H
+#define FORWARDDIFFERENCETESSELLATOR_H
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "BSplineSurface.h"
+
+//Samples a B-spline surface on a uniform samplesU x samplesV grid with forward differencing.
+//Inside one knot span a row of the surface is a polynomial of degree p in v (in homogeneous coordinates), and
+//for a polynomial sampled with a fixed step the p-th difference is constant. When the p + 1 differences at the
+//first sample are known, every next sample only needs p vector additions instead of a sum over the control points.
+//The differences are seeded again from exact values at every knot span and every reseedInterval samples, so the
+//float error that builds up while stepping stays small.
+class ForwardDifferenceTessellator
+{
+public:
+    ForwardDifferenceTessellator(const BSplineSurface& surface, int samplesU, int samplesV, int reseedInterval = 32);
+
+    //Writes the samples as out[i * samplesV + j], the same layout as SurfaceTessellator
+    void tessellate(glm::vec3* out);
+    //Maps the vertex buffer with glMapBufferRange and writes the rows straight into it.
+    //The buffer has to hold samplesU * samplesV points.
+    void tessellateInto(GLuint vbo);
+
+    int getSamplesU() const { return samplesU; }
+    int getSamplesV() const { return samplesV; }
+
+private:
+    //A sample column where the differences are calculated again
+    struct Seed
+    {
+        int column;
+        int span;
+    };
+
+    void tessellateRow(int i, glm::vec3* out);
+
+    const BSplineSurface& surface;
+    int samplesU;
+    int samplesV;
+
+    //Knot span and basis functions of every sample row, the u direction is blended first like in SurfaceTessellator
+    std::vector<int> spansU;
+    std::vector<float> basisU;
+
+    std::vector<Seed> seeds;
+    //For every seed the (degreeV + 1) differences of the (degreeV + 1) basis functions of its span,
+    //basisDifferences[(seed * (degreeV + 1) + k) * (degreeV + 1) + b] is the k-th difference of basis function b
+    std::vector<float> basisDifferences;
+
+    //The u-blended homogeneous control points of one sample row
+    std::vector<glm::vec4> blendedRow;
+};
+
+#endif
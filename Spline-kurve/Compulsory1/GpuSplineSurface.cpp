@@ -0,0 +1,80 @@
+#include "GpuSplineSurface.h"
+#include <vector>
+
+GpuSplineSurface::GpuSplineSurface(const BSplineSurface& surface) : surface(surface)
+{
+    glGenBuffers(1, &controlBuffer);
+    glGenTextures(1, &controlTexture);
+    glGenBuffers(1, &knotBuffer);
+    glGenTextures(1, &knotTexture);
+    glGenVertexArrays(1, &emptyVAO);
+    upload();
+}
+
+GpuSplineSurface::~GpuSplineSurface()
+{
+    glDeleteVertexArrays(1, &emptyVAO);
+    glDeleteTextures(1, &controlTexture);
+    glDeleteTextures(1, &knotTexture);
+    glDeleteBuffers(1, &controlBuffer);
+    glDeleteBuffers(1, &knotBuffer);
+}
+
+void GpuSplineSurface::upload()
+{
+    //The homogeneous control points (w * point, w), so the shader handles NURBS surfaces as well
+    const std::vector<glm::vec4>& points = surface.homogeneousPoints;
+    glBindBuffer(GL_TEXTURE_BUFFER, controlBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, points.size() * sizeof(glm::vec4), points.data(), GL_DYNAMIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, controlTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, controlBuffer);
+
+    //knotsU followed by knotsV in one buffer
+    std::vector<float> knots(surface.knotsU);
+    knots.insert(knots.end(), surface.knotsV.begin(), surface.knotsV.end());
+    glBindBuffer(GL_TEXTURE_BUFFER, knotBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, knots.size() * sizeof(float), knots.data(), GL_STATIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, knotTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, knotBuffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void GpuSplineSurface::updateControlPoint(int index)
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, controlBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, index * sizeof(glm::vec4), sizeof(glm::vec4), &surface.homogeneousPoints[index]);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void GpuSplineSurface::draw(Shader& shader, int samplesU, int samplesV)
+{
+    shader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, controlTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, knotTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.setInt("controlNet", 0);
+    shader.setInt("knots", 1);
+    shader.setInt("width", surface.width);
+    shader.setInt("height", surface.height);
+    shader.setInt("degreeU", surface.degreeU);
+    shader.setInt("degreeV", surface.degreeV);
+    shader.setInt("samplesU", samplesU);
+    shader.setInt("samplesV", samplesV);
+    shader.setVec3("color", glm::vec3(0.0f));
+
+    glBindVertexArray(emptyVAO);
+    //Two vertices for every line between neighbouring samples in the rows and in the columns
+    shader.setInt("drawLines", 1);
+    GLsizei lineVertices = 2 * (samplesU * (samplesV - 1) + (samplesU - 1) * samplesV);
+    glDrawArrays(GL_LINES, 0, lineVertices);
+
+    shader.setInt("drawLines", 0);
+    glPointSize(6.0f);
+    glDrawArrays(GL_POINTS, 0, samplesU * samplesV);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,35 @@
+#ifndef GPUSPLINESURFACE_H
+#define GPUSPLINESURFACE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "BSplineSurface.h"
+#include "Shader.h"
+
+//Draws a B-spline surface that is evaluated in the vertex shader (spline.vs).
+//The control net and the knot vectors are kept in texture buffers, and the vertices are generated from
+//gl_VertexID, so there is no CPU tessellation. Changing the resolution only changes two uniforms and
+//moving a control point uploads 16 bytes. The control points are homogeneous, so NURBS surfaces work too.
+class GpuSplineSurface
+{
+public:
+    GpuSplineSurface(const BSplineSurface& surface);
+    ~GpuSplineSurface();
+
+    //Uploads all control points and knots again, used when the surface is replaced
+    void upload();
+    //Uploads one control point after it has been moved
+    void updateControlPoint(int index);
+
+    //Draws the surface as a samplesU x samplesV grid of lines and points with the spline shader
+    void draw(Shader& shader, int samplesU, int samplesV);
+
+private:
+    const BSplineSurface& surface;
+    GLuint controlBuffer, controlTexture;
+    GLuint knotBuffer, knotTexture;
+    //Core profile needs a bound vertex array object even if there are no vertex attributes
+    GLuint emptyVAO;
+};
+
+#endif
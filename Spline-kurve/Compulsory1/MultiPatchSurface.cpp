@@ -0,0 +1,128 @@
+#include "MultiPatchSurface.h"
+
+unsigned int MultiPatchSurface::addControlPoint(const glm::vec3& point)
+{
+    poolX.push_back(point.x);
+    poolY.push_back(point.y);
+    poolZ.push_back(point.z);
+    return static_cast<unsigned int>(poolX.size() - 1);
+}
+
+int MultiPatchSurface::addPatch(const unsigned int indices[16])
+{
+    patchIndices.insert(patchIndices.end(), indices, indices + 16);
+    return static_cast<int>(patchCount() - 1);
+}
+
+MultiPatchSurface MultiPatchSurface::createGrid(int latticeWidth, int latticeHeight, float spacing,
+    const std::function<float(float, float)>& heightFunction)
+{
+    MultiPatchSurface surface;
+    surface.poolX.reserve(latticeWidth * latticeHeight);
+    surface.poolY.reserve(latticeWidth * latticeHeight);
+    surface.poolZ.reserve(latticeWidth * latticeHeight);
+    for (int row = 0; row < latticeHeight; ++row)
+    {
+        for (int column = 0; column < latticeWidth; ++column)
+        {
+            float x = column * spacing;
+            float y = row * spacing;
+            surface.addControlPoint(glm::vec3(x, y, heightFunction(x, y)));
+        }
+    }
+
+    //Patch (row, column) uses the lattice points row..row + 3 and column..column + 3
+    surface.patchIndices.reserve((latticeWidth - 3) * (latticeHeight - 3) * 16);
+    for (int row = 0; row + 3 < latticeHeight; ++row)
+    {
+        for (int column = 0; column + 3 < latticeWidth; ++column)
+        {
+            unsigned int indices[16];
+            for (int a = 0; a < 4; ++a)
+                for (int b = 0; b < 4; ++b)
+                    indices[a * 4 + b] = (row + a) * latticeWidth + column + b;
+            surface.addPatch(indices);
+        }
+    }
+    return surface;
+}
+
+//The four uniform cubic B-spline basis functions for t in [0, 1]
+static void uniformCubicBasis(float t, float* basis)
+{
+    float s = 1.0f - t;
+    basis[0] = s * s * s / 6.0f;
+    basis[1] = (3.0f * t * t * t - 6.0f * t * t + 4.0f) / 6.0f;
+    basis[2] = (-3.0f * t * t * t + 3.0f * t * t + 3.0f * t + 1.0f) / 6.0f;
+    basis[3] = t * t * t / 6.0f;
+}
+
+void MultiPatchSurface::tessellate(ThreadPool& pool, int samples, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices) const
+{
+    size_t patches = patchCount();
+    size_t verticesPerPatch = static_cast<size_t>(samples) * samples;
+    size_t indicesPerPatch = static_cast<size_t>(samples - 1) * (samples - 1) * 6;
+    //The sizes are known up front, so every patch can write straight into its own part of the buffers
+    vertices.resize(patches * verticesPerPatch);
+    indices.resize(patches * indicesPerPatch);
+
+    //All patches are sampled at the same parameters, so the basis functions are calculated once
+    std::vector<float> basis(samples * 4);
+    for (int i = 0; i < samples; ++i)
+        uniformCubicBasis(i / static_cast<float>(samples - 1), &basis[i * 4]);
+
+    pool.parallelFor(patches, 64, [&](size_t begin, size_t end)
+    {
+        for (size_t patch = begin; patch < end; ++patch)
+        {
+            //Gathers the 16 control points of the patch from the pool
+            const unsigned int* patchPoints = &patchIndices[patch * 16];
+            float x[16], y[16], z[16];
+            for (int k = 0; k < 16; ++k)
+            {
+                x[k] = poolX[patchPoints[k]];
+                y[k] = poolY[patchPoints[k]];
+                z[k] = poolZ[patchPoints[k]];
+            }
+
+            glm::vec3* patchVertices = &vertices[patch * verticesPerPatch];
+            for (int i = 0; i < samples; ++i)
+            {
+                //Blends the four control point rows in the u direction first
+                const float* bu = &basis[i * 4];
+                float rowX[4], rowY[4], rowZ[4];
+                for (int b = 0; b < 4; ++b)
+                {
+                    rowX[b] = bu[0] * x[b] + bu[1] * x[4 + b] + bu[2] * x[8 + b] + bu[3] * x[12 + b];
+                    rowY[b] = bu[0] * y[b] + bu[1] * y[4 + b] + bu[2] * y[8 + b] + bu[3] * y[12 + b];
+                    rowZ[b] = bu[0] * z[b] + bu[1] * z[4 + b] + bu[2] * z[8 + b] + bu[3] * z[12 + b];
+                }
+                for (int j = 0; j < samples; ++j)
+                {
+                    const float* bv = &basis[j * 4];
+                    patchVertices[i * samples + j] = glm::vec3(
+                        bv[0] * rowX[0] + bv[1] * rowX[1] + bv[2] * rowX[2] + bv[3] * rowX[3],
+                        bv[0] * rowY[0] + bv[1] * rowY[1] + bv[2] * rowY[2] + bv[3] * rowY[3],
+                        bv[0] * rowZ[0] + bv[1] * rowZ[1] + bv[2] * rowZ[2] + bv[3] * rowZ[3]);
+                }
+            }
+
+            //Two triangles for each quad of the patch grid
+            unsigned int first = static_cast<unsigned int>(patch * verticesPerPatch);
+            unsigned int* patchIndexData = &indices[patch * indicesPerPatch];
+            for (int i = 0; i < samples - 1; ++i)
+            {
+                for (int j = 0; j < samples - 1; ++j)
+                {
+                    unsigned int corner = first + i * samples + j;
+                    *patchIndexData++ = corner;
+                    *patchIndexData++ = corner + samples;
+                    *patchIndexData++ = corner + 1;
+                    *patchIndexData++ = corner + 1;
+                    *patchIndexData++ = corner + samples;
+                    *patchIndexData++ = corner + samples + 1;
+                }
+            }
+        }
+    });
+}
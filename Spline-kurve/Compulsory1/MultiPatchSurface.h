@@ -0,0 +1,40 @@
+#ifndef MULTIPATCHSURFACE_H
+#define MULTIPATCHSURFACE_H
+
+#include <vector>
+#include <functional>
+#include <glm/glm.hpp>
+#include "ThreadPool.h"
+
+//Many bicubic uniform B-spline patches that share one pool of control points.
+//The pool is stored as structure of arrays (all x, then all y, then all z), and every patch is 16 indices
+//into the pool, row by row. Neighbouring patches that share three rows or columns of control points
+//meet with C2 continuity, which is how a large terrain is built from a single control lattice.
+class MultiPatchSurface
+{
+public:
+    std::vector<float> poolX;
+    std::vector<float> poolY;
+    std::vector<float> poolZ;
+    //16 pool indices per patch
+    std::vector<unsigned int> patchIndices;
+
+    unsigned int addControlPoint(const glm::vec3& point);
+    //Adds a patch from 4x4 pool indices and returns the patch number
+    int addPatch(const unsigned int indices[16]);
+
+    size_t patchCount() const { return patchIndices.size() / 16; }
+    size_t controlPointCount() const { return poolX.size(); }
+
+    //Makes a latticeWidth x latticeHeight control lattice in the xy plane with the heights from the function,
+    //and one patch for every 4x4 window of the lattice, (latticeWidth - 3) x (latticeHeight - 3) patches in total
+    static MultiPatchSurface createGrid(int latticeWidth, int latticeHeight, float spacing,
+        const std::function<float(float, float)>& heightFunction);
+
+    //Tessellates every patch with samples x samples vertices into one vertex and one index buffer (triangles),
+    //so the whole surface is drawn with one draw call. The patches are shared between the threads of the pool,
+    //and every patch writes to its own part of the buffers, so no locking is needed.
+    void tessellate(ThreadPool& pool, int samples, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices) const;
+};
+
+#endif
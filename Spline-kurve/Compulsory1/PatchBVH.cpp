@@ -0,0 +1,477 @@
+#include "PatchBVH.h"
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+//The highest degree the patches support, the same as BSplineSurface
+static const int MAX_DEGREE = 7;
+static const int MAX_NET = (MAX_DEGREE + 1) * (MAX_DEGREE + 1);
+//Patches per leaf of the tree
+static const int LEAF_SIZE = 2;
+//How many times a control net is halved before Newton's method takes over
+static const int MAX_SUBDIVISION_DEPTH = 8;
+
+//Bernstein polynomials of the given degree at s, and their derivatives
+static void bernstein(int degree, float s, float* basis, float* derivatives)
+{
+    //Degree - 1 polynomials first, the derivative is degree * (B[k - 1] - B[k]) of those
+    float lower[MAX_DEGREE + 1];
+    lower[0] = 1.0f;
+    for (int p = 1; p < degree; ++p)
+    {
+        float saved = 0.0f;
+        for (int k = 0; k < p; ++k)
+        {
+            float temp = lower[k];
+            lower[k] = saved + (1.0f - s) * temp;
+            saved = s * temp;
+        }
+        lower[p] = saved;
+    }
+    for (int k = 0; k <= degree; ++k)
+    {
+        float left = k >= 1 ? lower[k - 1] : 0.0f;
+        float right = k < degree ? lower[k] : 0.0f;
+        derivatives[k] = degree * (left - right);
+        basis[k] = (k < degree ? (1.0f - s) * right : 0.0f) + (k >= 1 ? s * left : 0.0f);
+    }
+    if (degree == 0)
+    {
+        basis[0] = 1.0f;
+        derivatives[0] = 0.0f;
+    }
+}
+
+static void netBounds(const glm::vec4* net, int count, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (int k = 0; k < count; ++k)
+    {
+        glm::vec3 point = glm::vec3(net[k]) / net[k].w;
+        boundsMin = glm::min(boundsMin, point);
+        boundsMax = glm::max(boundsMax, point);
+    }
+}
+
+//Slab test. Returns the ray parameter where the ray enters the box, or a negative value if it misses.
+static float rayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance)
+{
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    glm::vec3 closer = glm::min(t0, t1);
+    glm::vec3 farther = glm::max(t0, t1);
+    float enter = std::max(std::max(closer.x, closer.y), std::max(closer.z, 0.0f));
+    float leave = std::min(std::min(farther.x, farther.y), std::min(farther.z, maxDistance));
+    return enter <= leave ? enter : -1.0f;
+}
+
+static float boxDistanceSquared(const glm::vec3& point, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 outside = glm::max(glm::max(boundsMin - point, point - boundsMax), glm::vec3(0.0f));
+    return glm::dot(outside, outside);
+}
+
+//Splits a Bezier net of rows x columns points in the middle of the rows (u) or the columns (v)
+static void splitNet(const glm::vec4* net, int degreeU, int degreeV, bool splitU, glm::vec4* first, glm::vec4* second)
+{
+    int columns = degreeV + 1;
+    int degree = splitU ? degreeU : degreeV;
+    int lines = splitU ? degreeV + 1 : degreeU + 1;
+    for (int line = 0; line < lines; ++line)
+    {
+        //Point k of the line in the net
+        auto index = [&](int k) { return splitU ? k * columns + line : line * columns + k; };
+        glm::vec4 work[MAX_DEGREE + 1];
+        for (int k = 0; k <= degree; ++k)
+            work[k] = net[index(k)];
+        first[index(0)] = work[0];
+        second[index(degree)] = work[degree];
+        for (int level = 1; level <= degree; ++level)
+        {
+            for (int k = 0; k <= degree - level; ++k)
+                work[k] = 0.5f * (work[k] + work[k + 1]);
+            first[index(level)] = work[0];
+            second[index(degree - level)] = work[degree - level];
+        }
+    }
+}
+
+PatchBVH::PatchBVH(const BSplineSurface& surface) : degreeU(surface.degreeU), degreeV(surface.degreeV)
+{
+    //Every non-empty knot span of the Bezier form is one patch
+    BSplineSurface bezier = surface.bezierForm();
+    for (int i = degreeU; i < bezier.height; i += degreeU)
+    {
+        if (bezier.knotsU[i + 1] <= bezier.knotsU[i])
+            continue;
+        for (int j = degreeV; j < bezier.width; j += degreeV)
+        {
+            if (bezier.knotsV[j + 1] <= bezier.knotsV[j])
+                continue;
+            Patch patch;
+            patch.firstPoint = patchPoints.size();
+            patch.u0 = bezier.knotsU[i];
+            patch.u1 = bezier.knotsU[i + 1];
+            patch.v0 = bezier.knotsV[j];
+            patch.v1 = bezier.knotsV[j + 1];
+            for (int a = 0; a <= degreeU; ++a)
+                for (int b = 0; b <= degreeV; ++b)
+                    patchPoints.push_back(bezier.homogeneousPoints[(i - degreeU + a) * bezier.width + j - degreeV + b]);
+            netBounds(&patchPoints[patch.firstPoint], (degreeU + 1) * (degreeV + 1), patch.boundsMin, patch.boundsMax);
+            patches.push_back(patch);
+        }
+    }
+
+    nodes.reserve(2 * patches.size());
+    nodes.push_back(Node());
+    nodes[0].count = 0;
+    nodes[0].first = 0;
+    if (!patches.empty())
+        build(0, 0, static_cast<int>(patches.size()));
+}
+
+void PatchBVH::build(int nodeIndex, int begin, int end)
+{
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    glm::vec3 centerMin = boundsMin, centerMax = boundsMax;
+    for (int k = begin; k < end; ++k)
+    {
+        boundsMin = glm::min(boundsMin, patches[k].boundsMin);
+        boundsMax = glm::max(boundsMax, patches[k].boundsMax);
+        glm::vec3 center = 0.5f * (patches[k].boundsMin + patches[k].boundsMax);
+        centerMin = glm::min(centerMin, center);
+        centerMax = glm::max(centerMax, center);
+    }
+    nodes[nodeIndex].boundsMin = boundsMin;
+    nodes[nodeIndex].boundsMax = boundsMax;
+
+    if (end - begin <= LEAF_SIZE)
+    {
+        nodes[nodeIndex].first = begin;
+        nodes[nodeIndex].count = end - begin;
+        return;
+    }
+
+    //Median split along the longest axis of the patch centres
+    glm::vec3 extent = centerMax - centerMin;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    int middle = (begin + end) / 2;
+    std::nth_element(patches.begin() + begin, patches.begin() + middle, patches.begin() + end, [axis](const Patch& a, const Patch& b)
+    {
+        return a.boundsMin[axis] + a.boundsMax[axis] < b.boundsMin[axis] + b.boundsMax[axis];
+    });
+
+    //Both children are added before either is built, so they are next to each other
+    int left = static_cast<int>(nodes.size());
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    nodes[nodeIndex].first = left;
+    nodes[nodeIndex].count = 0;
+    build(left, begin, middle);
+    build(left + 1, middle, end);
+}
+
+void PatchBVH::evaluatePatch(const Patch& patch, float s, float t, glm::vec3& point, glm::vec3& du, glm::vec3& dv) const
+{
+    float bu[MAX_DEGREE + 1], dbu[MAX_DEGREE + 1], bv[MAX_DEGREE + 1], dbv[MAX_DEGREE + 1];
+    bernstein(degreeU, s, bu, dbu);
+    bernstein(degreeV, t, bv, dbv);
+
+    const glm::vec4* net = &patchPoints[patch.firstPoint];
+    glm::vec4 sum(0.0f), sumU(0.0f), sumV(0.0f);
+    for (int a = 0; a <= degreeU; ++a)
+    {
+        glm::vec4 row(0.0f), rowV(0.0f);
+        for (int b = 0; b <= degreeV; ++b)
+        {
+            row += bv[b] * net[a * (degreeV + 1) + b];
+            rowV += dbv[b] * net[a * (degreeV + 1) + b];
+        }
+        sum += bu[a] * row;
+        sumU += dbu[a] * row;
+        sumV += bu[a] * rowV;
+    }
+    point = glm::vec3(sum) / sum.w;
+    //Quotient rule for the rational patch, derivatives with respect to the local parameters
+    du = (glm::vec3(sumU) - sumU.w * point) / sum.w;
+    dv = (glm::vec3(sumV) - sumV.w * point) / sum.w;
+}
+
+void PatchBVH::fillHit(const Patch& patch, int patchIndex, float s, float t, float distance, SurfaceHit& hit) const
+{
+    glm::vec3 du, dv;
+    evaluatePatch(patch, s, t, hit.point, du, dv);
+    glm::vec3 normal = glm::cross(du, dv);
+    float length = glm::length(normal);
+    hit.hit = true;
+    hit.distance = distance;
+    hit.u = patch.u0 + s * (patch.u1 - patch.u0);
+    hit.v = patch.v0 + t * (patch.v1 - patch.v0);
+    hit.normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    hit.patch = patchIndex;
+}
+
+bool PatchBVH::intersect(const glm::vec3& origin, const glm::vec3& direction, SurfaceHit& hit) const
+{
+    hit = SurfaceHit();
+    hit.distance = std::numeric_limits<float>::max();
+    if (patches.empty())
+        return false;
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+    //Stack of nodes to visit, the nearer child is visited first so the farther one can often be skipped
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node& node = nodes[stack[--top]];
+        if (rayBox(origin, inverseDirection, node.boundsMin, node.boundsMax, hit.distance) < 0.0f)
+            continue;
+        if (node.count > 0)
+        {
+            for (int k = node.first; k < node.first + node.count; ++k)
+            {
+                if (rayBox(origin, inverseDirection, patches[k].boundsMin, patches[k].boundsMax, hit.distance) >= 0.0f)
+                    intersectPatch(patches[k], k, origin, direction, hit);
+            }
+            continue;
+        }
+        float leftEnter = rayBox(origin, inverseDirection, nodes[node.first].boundsMin, nodes[node.first].boundsMax, hit.distance);
+        float rightEnter = rayBox(origin, inverseDirection, nodes[node.first + 1].boundsMin, nodes[node.first + 1].boundsMax, hit.distance);
+        int nearChild = leftEnter <= rightEnter ? node.first : node.first + 1;
+        int farChild = nearChild == node.first ? node.first + 1 : node.first;
+        stack[top++] = farChild;
+        stack[top++] = nearChild;
+    }
+    if (!hit.hit)
+        hit.distance = 0.0f;
+    return hit.hit;
+}
+
+void PatchBVH::intersectPatch(const Patch& patch, int patchIndex, const glm::vec3& origin, const glm::vec3& direction, SurfaceHit& hit) const
+{
+    intersectNet(patch, patchIndex, &patchPoints[patch.firstPoint], 0.0f, 1.0f, 0.0f, 1.0f, 0, origin, direction, hit);
+}
+
+void PatchBVH::intersectNet(const Patch& patch, int patchIndex, const glm::vec4* net, float s0, float s1, float t0, float t1, int depth,
+    const glm::vec3& origin, const glm::vec3& direction, SurfaceHit& hit) const
+{
+    int count = (degreeU + 1) * (degreeV + 1);
+    glm::vec3 boundsMin, boundsMax;
+    netBounds(net, count, boundsMin, boundsMax);
+    //A little margin, a flat net gives a box with zero thickness
+    glm::vec3 margin(1e-5f * (1.0f + glm::length(boundsMax - boundsMin)));
+    if (rayBox(origin, 1.0f / direction, boundsMin - margin, boundsMax + margin, hit.distance) < 0.0f)
+        return;
+
+    if (depth >= MAX_SUBDIVISION_DEPTH)
+    {
+        //Newton's method from the middle of the small piece, the answer has to stay close to the piece
+        float s = 0.5f * (s0 + s1);
+        float t = 0.5f * (t0 + t1);
+        float lambda = glm::dot(glm::vec3(net[count / 2]) / net[count / 2].w - origin, direction) / glm::dot(direction, direction);
+        float slackS = s1 - s0, slackT = t1 - t0;
+        if (newtonRay(patch, s, t, lambda, origin, direction) && lambda > 0.0f && lambda < hit.distance &&
+            s >= s0 - slackS && s <= s1 + slackS && t >= t0 - slackT && t <= t1 + slackT &&
+            s >= 0.0f && s <= 1.0f && t >= 0.0f && t <= 1.0f)
+        {
+            fillHit(patch, patchIndex, s, t, lambda, hit);
+        }
+        return;
+    }
+
+    //Splits the longer direction of the piece, measured by the control net
+    glm::vec3 cornerU = glm::vec3(net[degreeU * (degreeV + 1)]) / net[degreeU * (degreeV + 1)].w - glm::vec3(net[0]) / net[0].w;
+    glm::vec3 cornerV = glm::vec3(net[degreeV]) / net[degreeV].w - glm::vec3(net[0]) / net[0].w;
+    bool splitU = glm::dot(cornerU, cornerU) >= glm::dot(cornerV, cornerV);
+    glm::vec4 first[MAX_NET], second[MAX_NET];
+    splitNet(net, degreeU, degreeV, splitU, first, second);
+    if (splitU)
+    {
+        float middle = 0.5f * (s0 + s1);
+        intersectNet(patch, patchIndex, first, s0, middle, t0, t1, depth + 1, origin, direction, hit);
+        intersectNet(patch, patchIndex, second, middle, s1, t0, t1, depth + 1, origin, direction, hit);
+    }
+    else
+    {
+        float middle = 0.5f * (t0 + t1);
+        intersectNet(patch, patchIndex, first, s0, s1, t0, middle, depth + 1, origin, direction, hit);
+        intersectNet(patch, patchIndex, second, s0, s1, middle, t1, depth + 1, origin, direction, hit);
+    }
+}
+
+bool PatchBVH::newtonRay(const Patch& patch, float& s, float& t, float& lambda, const glm::vec3& origin, const glm::vec3& direction) const
+{
+    //Solves S(s, t) - (origin + lambda * direction) = 0 for s, t and lambda
+    for (int iteration = 0; iteration < 10; ++iteration)
+    {
+        glm::vec3 point, du, dv;
+        evaluatePatch(patch, s, t, point, du, dv);
+        glm::vec3 f = point - origin - lambda * direction;
+        if (glm::dot(f, f) < 1e-12f * (1.0f + glm::dot(point, point)))
+            return true;
+        //Cramer's rule for the 3 x 3 system [du dv -direction] * step = -f
+        glm::mat3 jacobian(du, dv, -direction);
+        float determinant = glm::determinant(jacobian);
+        if (std::abs(determinant) < 1e-20f)
+            return false;
+        glm::vec3 step = glm::inverse(jacobian) * (-f);
+        s += step.x;
+        t += step.y;
+        lambda += step.z;
+    }
+    glm::vec3 point, du, dv;
+    evaluatePatch(patch, s, t, point, du, dv);
+    glm::vec3 f = point - origin - lambda * direction;
+    return glm::dot(f, f) < 1e-8f * (1.0f + glm::dot(point, point));
+}
+
+SurfaceHit PatchBVH::closestPoint(const glm::vec3& point) const
+{
+    SurfaceHit best;
+    best.distance = std::numeric_limits<float>::max();
+    if (patches.empty())
+        return best;
+
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node& node = nodes[stack[--top]];
+        if (boxDistanceSquared(point, node.boundsMin, node.boundsMax) >= best.distance * best.distance)
+            continue;
+        if (node.count > 0)
+        {
+            for (int k = node.first; k < node.first + node.count; ++k)
+            {
+                if (boxDistanceSquared(point, patches[k].boundsMin, patches[k].boundsMax) < best.distance * best.distance)
+                    closestOnPatch(patches[k], k, point, best);
+            }
+            continue;
+        }
+        //The nearer child is visited first
+        float leftDistance = boxDistanceSquared(point, nodes[node.first].boundsMin, nodes[node.first].boundsMax);
+        float rightDistance = boxDistanceSquared(point, nodes[node.first + 1].boundsMin, nodes[node.first + 1].boundsMax);
+        int nearChild = leftDistance <= rightDistance ? node.first : node.first + 1;
+        stack[top++] = nearChild == node.first ? node.first + 1 : node.first;
+        stack[top++] = nearChild;
+    }
+    return best;
+}
+
+void PatchBVH::closestOnPatch(const Patch& patch, int patchIndex, const glm::vec3& point, SurfaceHit& best) const
+{
+    //Starting guess: the nearest of 5 x 5 samples inside the patch. The edges are left out, because an edge can be
+    //collapsed to one point (the poles of a sphere) where the derivative is zero and Newton's method cannot move.
+    const int samples = 5;
+    float s = 0.0f, t = 0.0f;
+    float nearest = std::numeric_limits<float>::max();
+    for (int a = 0; a < samples; ++a)
+    {
+        for (int b = 0; b < samples; ++b)
+        {
+            float sa = (a + 0.5f) / samples;
+            float tb = (b + 0.5f) / samples;
+            glm::vec3 surfacePoint, du, dv;
+            evaluatePatch(patch, sa, tb, surfacePoint, du, dv);
+            float distance = glm::dot(surfacePoint - point, surfacePoint - point);
+            if (distance < nearest)
+            {
+                nearest = distance;
+                s = sa;
+                t = tb;
+            }
+        }
+    }
+
+    //Gauss-Newton: the step makes the difference vector orthogonal to both tangents, and is clamped to the patch.
+    //Far from the surface the step can overshoot, so it is halved until the distance gets smaller.
+    glm::vec3 surfacePoint, du, dv;
+    evaluatePatch(patch, s, t, surfacePoint, du, dv);
+    float current = glm::dot(point - surfacePoint, point - surfacePoint);
+    for (int iteration = 0; iteration < 40; ++iteration)
+    {
+        glm::vec3 difference = point - surfacePoint;
+        float a = glm::dot(du, du), b = glm::dot(du, dv), c = glm::dot(dv, dv);
+        float determinant = a * c - b * b;
+        float ru = glm::dot(difference, du), rv = glm::dot(difference, dv);
+        float stepS, stepT;
+        if (determinant > 1e-6f * a * c && determinant > 1e-20f)
+        {
+            stepS = (c * ru - b * rv) / determinant;
+            stepT = (a * rv - b * ru) / determinant;
+        }
+        else
+        {
+            //The tangents are (almost) parallel, each direction is stepped on its own
+            stepS = a > 0.0f ? ru / a : 0.0f;
+            stepT = c > 0.0f ? rv / c : 0.0f;
+        }
+        //On an edge of the patch where the distance gets smaller outside the patch, the step is only taken along
+        //the edge. In a corner where both directions point out, the corner is the closest point of the patch.
+        bool edgeS = (s <= 0.0f && ru <= 0.0f) || (s >= 1.0f && ru >= 0.0f);
+        bool edgeT = (t <= 0.0f && rv <= 0.0f) || (t >= 1.0f && rv >= 0.0f);
+        if (edgeS && edgeT)
+            break;
+        if (edgeS)
+        {
+            stepS = 0.0f;
+            stepT = c > 0.0f ? rv / c : 0.0f;
+        }
+        else if (edgeT)
+        {
+            stepT = 0.0f;
+            stepS = a > 0.0f ? ru / a : 0.0f;
+        }
+        stepS = glm::clamp(s + stepS, 0.0f, 1.0f) - s;
+        stepT = glm::clamp(t + stepT, 0.0f, 1.0f) - t;
+
+        bool improved = false;
+        for (int halving = 0; halving < 8 && !improved; ++halving)
+        {
+            glm::vec3 trialPoint, trialU, trialV;
+            evaluatePatch(patch, s + stepS, t + stepT, trialPoint, trialU, trialV);
+            float trial = glm::dot(point - trialPoint, point - trialPoint);
+            if (trial <= current)
+            {
+                s += stepS;
+                t += stepT;
+                current = trial;
+                surfacePoint = trialPoint;
+                du = trialU;
+                dv = trialV;
+                improved = true;
+            }
+            stepS *= 0.5f;
+            stepT *= 0.5f;
+        }
+        if (!improved || (std::abs(stepS) < 1e-6f && std::abs(stepT) < 1e-6f))
+            break;
+    }
+
+    float distance = std::sqrt(current);
+    if (distance < best.distance)
+        fillHit(patch, patchIndex, s, t, distance, best);
+}
+
+void PatchBVH::intersectBatch(ThreadPool& pool, const glm::vec3* origins, const glm::vec3* directions, size_t count, SurfaceHit* hits) const
+{
+    pool.parallelFor(count, 256, [&](size_t begin, size_t end)
+    {
+        for (size_t k = begin; k < end; ++k)
+            intersect(origins[k], directions[k], hits[k]);
+    });
+}
+
+void PatchBVH::closestPointBatch(ThreadPool& pool, const glm::vec3* points, size_t count, SurfaceHit* hits) const
+{
+    pool.parallelFor(count, 256, [&](size_t begin, size_t end)
+    {
+        for (size_t k = begin; k < end; ++k)
+            hits[k] = closestPoint(points[k]);
+    });
+}
@@ -0,0 +1,77 @@
+#ifndef PATCHBVH_H
+#define PATCHBVH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "BSplineSurface.h"
+#include "ThreadPool.h"
+
+//The result of a ray or closest point query. u and v are the parameters of the original surface.
+struct SurfaceHit
+{
+    bool hit = false;
+    //Ray parameter for ray queries, distance to the query point for closest point queries
+    float distance = 0.0f;
+    float u = 0.0f;
+    float v = 0.0f;
+    glm::vec3 point = glm::vec3(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f);
+    int patch = -1;
+};
+
+//Bounding volume hierarchy over the Bezier patches of a B-spline surface, for picking and collision.
+//The surface is split into Bezier patches with knot insertion, and every patch is bounded by the box around its
+//control points (the surface is inside the convex hull of the control points when all weights are positive).
+//Ray queries subdivide the control net of a patch until the boxes are small and then solve surface = ray with
+//Newton's method. Closest point queries start from the nearest of a few samples and use Gauss-Newton steps.
+//All queries are const and keep their state on the stack, so any number of threads can use the same tree.
+class PatchBVH
+{
+public:
+    PatchBVH(const BSplineSurface& surface);
+
+    //The nearest hit with a positive ray parameter. direction does not have to be normalized.
+    bool intersect(const glm::vec3& origin, const glm::vec3& direction, SurfaceHit& hit) const;
+    SurfaceHit closestPoint(const glm::vec3& point) const;
+
+    //Many queries at once, split into blocks on the thread pool
+    void intersectBatch(ThreadPool& pool, const glm::vec3* origins, const glm::vec3* directions, size_t count, SurfaceHit* hits) const;
+    void closestPointBatch(ThreadPool& pool, const glm::vec3* points, size_t count, SurfaceHit* hits) const;
+
+    size_t patchCount() const { return patches.size(); }
+
+private:
+    struct Patch
+    {
+        //First control point in patchPoints, (degreeU + 1) x (degreeV + 1) points row by row
+        size_t firstPoint;
+        float u0, u1, v0, v1;
+        glm::vec3 boundsMin, boundsMax;
+    };
+
+    struct Node
+    {
+        glm::vec3 boundsMin, boundsMax;
+        //Leaf: patches [first, first + count). Inner node: the children are at first and first + 1.
+        int first;
+        int count;
+    };
+
+    void build(int nodeIndex, int begin, int end);
+    //Surface point and first derivatives of a patch at the local parameters s, t in [0, 1]
+    void evaluatePatch(const Patch& patch, float s, float t, glm::vec3& point, glm::vec3& du, glm::vec3& dv) const;
+    void intersectPatch(const Patch& patch, int patchIndex, const glm::vec3& origin, const glm::vec3& direction, SurfaceHit& hit) const;
+    void intersectNet(const Patch& patch, int patchIndex, const glm::vec4* net, float s0, float s1, float t0, float t1, int depth,
+        const glm::vec3& origin, const glm::vec3& direction, SurfaceHit& hit) const;
+    bool newtonRay(const Patch& patch, float& s, float& t, float& lambda, const glm::vec3& origin, const glm::vec3& direction) const;
+    void closestOnPatch(const Patch& patch, int patchIndex, const glm::vec3& point, SurfaceHit& best) const;
+    void fillHit(const Patch& patch, int patchIndex, float s, float t, float distance, SurfaceHit& hit) const;
+
+    int degreeU;
+    int degreeV;
+    std::vector<glm::vec4> patchPoints;
+    std::vector<Patch> patches;
+    std::vector<Node> nodes;
+};
+
+#endif
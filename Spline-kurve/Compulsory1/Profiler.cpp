@@ -0,0 +1,274 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+
+//The name of the timer for the whole frame
+const char* FRAME_TIMER = "frame";
+
+Profiler::Profiler(size_t window, size_t historyFrames)
+    : startTime(std::chrono::steady_clock::now()), window(window), historyFrames(historyFrames), frameNumber(0), firstCountedFrame(0),
+    frameStart(-1.0), openGpuTimer(-1), openGpuSlot(0), ignoredGpuScopes(0)
+{
+    currentFrame.number = 0;
+    findTimer(FRAME_TIMER, false);
+}
+
+Profiler::~Profiler()
+{
+    for (Timer& timer : timers)
+        if (timer.gpu)
+            glDeleteQueries(GPU_LATENCY, timer.queries);
+}
+
+double Profiler::now() const
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+int Profiler::findTimer(const std::string& name, bool gpu)
+{
+    std::unordered_map<std::string, int>& index = gpu ? gpuTimerIndex : cpuTimerIndex;
+    auto found = index.find(name);
+    if (found != index.end())
+        return found->second;
+
+    Timer timer;
+    timer.name = name;
+    timer.gpu = gpu;
+    timer.samples.assign(window, 0.0f);
+    timer.nextSample = 0;
+    timer.sampleCount = 0;
+    for (int i = 0; i < GPU_LATENCY; ++i)
+    {
+        timer.queries[i] = 0;
+        timer.queryFrame[i] = -1;
+        timer.queryStart[i] = 0.0;
+    }
+    if (gpu)
+        glGenQueries(GPU_LATENCY, timer.queries);
+    timers.push_back(timer);
+    return index[name] = static_cast<int>(timers.size()) - 1;
+}
+
+void Profiler::addSample(Timer& timer, float milliseconds)
+{
+    timer.samples[timer.nextSample] = milliseconds;
+    timer.nextSample = (timer.nextSample + 1) % window;
+    timer.sampleCount = std::min(timer.sampleCount + 1, window);
+}
+
+void Profiler::beginFrame()
+{
+    double time = now();
+    if (frameStart >= 0.0)
+    {
+        //The last frame lasted until now
+        double duration = time - frameStart;
+        if (currentFrame.number >= firstCountedFrame)
+            addSample(timers[0], static_cast<float>(duration));
+        currentFrame.events.insert(currentFrame.events.begin(), Event{ 0, 0, frameStart, duration });
+        history.push_back(std::move(currentFrame));
+        if (history.size() > historyFrames)
+            history.pop_front();
+    }
+    currentFrame.number = frameNumber;
+    currentFrame.events.clear();
+    frameStart = time;
+}
+
+void Profiler::endFrame()
+{
+    for (size_t i = 0; i < timers.size(); ++i)
+        if (timers[i].gpu)
+            for (int slot = 0; slot < GPU_LATENCY; ++slot)
+                readQuery(static_cast<int>(i), slot, false);
+    ++frameNumber;
+}
+
+void Profiler::beginCpu(const std::string& name)
+{
+    int timer = findTimer(name, false);
+    openScopes.push_back(currentFrame.events.size());
+    currentFrame.events.push_back(Event{ timer, static_cast<int>(openScopes.size()), now(), 0.0 });
+}
+
+void Profiler::endCpu()
+{
+    if (openScopes.empty())
+        return;
+    Event& event = currentFrame.events[openScopes.back()];
+    openScopes.pop_back();
+    event.duration = now() - event.start;
+    addSample(timers[event.timer], static_cast<float>(event.duration));
+}
+
+void Profiler::beginGpu(const std::string& name)
+{
+    if (openGpuTimer >= 0)
+    {
+        ++ignoredGpuScopes;
+        return;
+    }
+    openGpuTimer = findTimer(name, true);
+    openGpuSlot = static_cast<int>(frameNumber % GPU_LATENCY);
+    Timer& timer = timers[openGpuTimer];
+    //The query in this slot is from GPU_LATENCY frames ago. If it is still not read, the GPU is that far behind
+    //and the result is waited for, so the query can be used again.
+    if (timer.queryFrame[openGpuSlot] >= 0)
+        readQuery(openGpuTimer, openGpuSlot, true);
+    timer.queryFrame[openGpuSlot] = frameNumber;
+    timer.queryStart[openGpuSlot] = now();
+    glBeginQuery(GL_TIME_ELAPSED, timer.queries[openGpuSlot]);
+}
+
+void Profiler::endGpu()
+{
+    if (ignoredGpuScopes > 0)
+    {
+        --ignoredGpuScopes;
+        return;
+    }
+    if (openGpuTimer < 0)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    openGpuTimer = -1;
+}
+
+bool Profiler::readQuery(int timerIndex, int slot, bool wait)
+{
+    Timer& timer = timers[timerIndex];
+    long long frame = timer.queryFrame[slot];
+    //The query of the scope that is open right now is not done yet
+    if (frame < 0 || (timerIndex == openGpuTimer && slot == openGpuSlot))
+        return false;
+    if (!wait)
+    {
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(timer.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available != GL_TRUE)
+            return false;
+    }
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(timer.queries[slot], GL_QUERY_RESULT, &nanoseconds);
+    timer.queryFrame[slot] = -1;
+
+    double duration = nanoseconds / 1.0e6;
+    if (frame >= firstCountedFrame)
+        addSample(timer, static_cast<float>(duration));
+    //The GPU has no start time for the pass, so the trace shows it from when the CPU started the query
+    Event event{ timerIndex, 1, timer.queryStart[slot], duration };
+    if (frame == currentFrame.number)
+    {
+        currentFrame.events.push_back(event);
+        return true;
+    }
+    for (Frame& stored : history)
+    {
+        if (stored.number == frame)
+        {
+            stored.events.push_back(event);
+            break;
+        }
+    }
+    return true;
+}
+
+void Profiler::resetStatistics()
+{
+    for (Timer& timer : timers)
+    {
+        timer.nextSample = 0;
+        timer.sampleCount = 0;
+    }
+    firstCountedFrame = frameNumber;
+}
+
+std::vector<Profiler::Statistics> Profiler::statistics() const
+{
+    std::vector<Statistics> result;
+    std::vector<float> sorted;
+    for (const Timer& timer : timers)
+    {
+        Statistics statistics = { timer.name, timer.gpu, timer.sampleCount, 0.0f, 0.0f, 0.0f, 0.0f };
+        if (timer.sampleCount > 0)
+        {
+            sorted.assign(timer.samples.begin(), timer.samples.begin() + timer.sampleCount);
+            std::sort(sorted.begin(), sorted.end());
+            double sum = 0.0;
+            for (float sample : sorted)
+                sum += sample;
+            statistics.mean = static_cast<float>(sum / sorted.size());
+            //Nearest rank percentiles
+            auto percentile = [&sorted](float p) {
+                size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+                return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+            };
+            statistics.p50 = percentile(0.50f);
+            statistics.p95 = percentile(0.95f);
+            statistics.p99 = percentile(0.99f);
+        }
+        result.push_back(statistics);
+    }
+    return result;
+}
+
+bool Profiler::writeCsv(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        return false;
+    file << "frame,scope,type,depth,start_ms,duration_ms\n";
+    for (const Frame& frame : history)
+        for (const Event& event : frame.events)
+        {
+            const Timer& timer = timers[event.timer];
+            file << frame.number << ',' << timer.name << ',' << (timer.gpu ? "gpu" : "cpu") << ',' << event.depth << ','
+                << event.start << ',' << event.duration << '\n';
+        }
+    return true;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        return false;
+    //The trace format uses microseconds
+    file << "{\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+    for (const Frame& frame : history)
+        for (const Event& event : frame.events)
+        {
+            const Timer& timer = timers[event.timer];
+            file << ",\n{\"name\":" << jsonString(timer.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << (timer.gpu ? 2 : 1)
+                << ",\"ts\":" << static_cast<long long>(event.start * 1000.0) << ",\"dur\":" << static_cast<long long>(event.duration * 1000.0)
+                << ",\"args\":{\"frame\":" << frame.number << "}}";
+        }
+    file << "\n]}\n";
+    return true;
+}
+
+std::string Profiler::jsonString(const std::string& text)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            const char* hex = "0123456789abcdef";
+            quoted += "\\u00";
+            quoted += hex[(c >> 4) & 0xF];
+            quoted += hex[c & 0xF];
+        }
+        else
+            quoted += c;
+    }
+    return quoted + "\"";
+}
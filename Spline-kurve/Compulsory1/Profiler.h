@@ -0,0 +1,143 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <unordered_map>
+#include <glad/glad.h>
+
+//Measures the frames of the render loop. CPU scopes measure the time on the render thread, and they can be nested.
+//GPU scopes put a GL_TIME_ELAPSED query around a render pass. The result of a query is only read when the GPU
+//says it is ready, so every GPU scope has a ring of GPU_LATENCY queries and the results come a few frames later
+//without the CPU ever waiting for them. GL_TIME_ELAPSED queries can not be nested, so only one GPU scope can be open.
+//A GPU scope that is opened inside another one is not measured, and its end does not end the outer one.
+//Every scope keeps its last samples, which give the percentiles in statistics. The last frames are also kept whole,
+//so they can be written as CSV or as a Chrome trace (chrome://tracing or ui.perfetto.dev).
+class Profiler
+{
+public:
+    static constexpr int GPU_LATENCY = 4;
+
+    //Times a CPU scope until the end of the block
+    class CpuScope
+    {
+    public:
+        CpuScope(Profiler& profiler, const std::string& name) : profiler(profiler) { profiler.beginCpu(name); }
+        ~CpuScope() { profiler.endCpu(); }
+    private:
+        Profiler& profiler;
+    };
+    //Times the GPU work of the draw calls in the block
+    class GpuScope
+    {
+    public:
+        GpuScope(Profiler& profiler, const std::string& name) : profiler(profiler) { profiler.beginGpu(name); }
+        ~GpuScope() { profiler.endGpu(); }
+    private:
+        Profiler& profiler;
+    };
+
+    struct Statistics
+    {
+        std::string name;
+        bool gpu;
+        size_t samples;
+        //In milliseconds
+        float mean, p50, p95, p99;
+    };
+
+    //window is how many samples each scope keeps for the percentiles, and historyFrames how many frames are
+    //kept for the export
+    Profiler(size_t window = 240, size_t historyFrames = 600);
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    //The time between two calls is the sample of the "frame" scope
+    void beginFrame();
+    //Reads the GPU queries that are done and stores the frame
+    void endFrame();
+
+    void beginCpu(const std::string& name);
+    void endCpu();
+    void beginGpu(const std::string& name);
+    void endGpu();
+
+    //Forgets the samples so far, for example after the warm-up frames of a benchmark. GPU results of the earlier
+    //frames that arrive later are not counted either.
+    void resetStatistics();
+
+    //The frame first, then the scopes in the order they were first used
+    std::vector<Statistics> statistics() const;
+    long long getFrameCount() const { return frameNumber; }
+
+    //One line per sample: frame, scope, cpu or gpu, start and duration in milliseconds
+    bool writeCsv(const std::string& path) const;
+    //Complete events, the CPU scopes on thread 1 and the GPU scopes on thread 2
+    bool writeChromeTrace(const std::string& path) const;
+
+    //The text as a JSON string with quotes, with the quotes, backslashes and control characters escaped
+    static std::string jsonString(const std::string& text);
+
+private:
+    struct Timer
+    {
+        std::string name;
+        bool gpu;
+        //The last samples in milliseconds, as a ring
+        std::vector<float> samples;
+        size_t nextSample;
+        size_t sampleCount;
+        //The query ring of a GPU scope, the frame each query was started in (-1 if it is not waiting) and the
+        //CPU time it was started at
+        GLuint queries[GPU_LATENCY];
+        long long queryFrame[GPU_LATENCY];
+        double queryStart[GPU_LATENCY];
+    };
+    struct Event
+    {
+        int timer;
+        int depth;
+        //Milliseconds since the profiler was made
+        double start;
+        double duration;
+    };
+    struct Frame
+    {
+        long long number;
+        std::vector<Event> events;
+    };
+
+    int findTimer(const std::string& name, bool gpu);
+    void addSample(Timer& timer, float milliseconds);
+    //Reads a finished query into the timer and the frame it belongs to. wait is only used when a query has to be reused.
+    bool readQuery(int timerIndex, int slot, bool wait);
+    double now() const;
+
+    std::chrono::steady_clock::time_point startTime;
+    size_t window;
+    size_t historyFrames;
+    long long frameNumber;
+    //Samples of frames before this one are not counted in the statistics
+    long long firstCountedFrame;
+    double frameStart;
+
+    std::vector<Timer> timers;
+    std::unordered_map<std::string, int> cpuTimerIndex;
+    std::unordered_map<std::string, int> gpuTimerIndex;
+    //The open CPU scopes, as events in the current frame
+    std::vector<size_t> openScopes;
+    int openGpuTimer;
+    int openGpuSlot;
+    //GPU scopes that were opened while another one was open, their ends are skipped
+    int ignoredGpuScopes;
+
+    Frame currentFrame;
+    //The last frames, oldest first. GPU results are added to them when they arrive.
+    std::deque<Frame> history;
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include "Shader.h"
+#include "CameraUniforms.h"
+#include <algorithm>
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath)
 {
@@ -31,58 +33,115 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
     }
+    // 2. compile shaders
+    vertex = 0;
+    fragment = 0;
+    ID = compileProgram(vertexCode, fragmentCode);
+    linkUniforms();
+}
+
+Shader::Shader(GLuint program) : ID(program), vertex(0), fragment(0)
+{
+    linkUniforms();
+}
+
+GLuint Shader::compileProgram(const std::string& vertexCode, const std::string& fragmentCode, void (*beforeLink)(GLuint))
+{
+    GLuint program = beginProgram(vertexCode, fragmentCode, beforeLink);
+    finishProgram(program);
+    return program;
+}
+
+GLuint Shader::beginProgram(const std::string& vertexCode, const std::string& fragmentCode, void (*beforeLink)(GLuint))
+{
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
-    // std::cout << vShaderCode << std::endl;
-    // std::cout << fShaderCode << std::endl;
-
-     // 2. compile shaders
- // 2. compile shaders
-    // unsigned int vertex, fragment;
-    int success;
-    char infoLog[512];
 
     // vertex Shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
+    unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertex, 1, &vShaderCode, NULL);
     glCompileShader(vertex);
-    // print compile errors if any
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-    };
 
     unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(fragmentShader, 1, &fShaderCode, NULL);
     glCompileShader(fragmentShader);
-    // check for shader compile errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+
+    // link shaders
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragmentShader);
+    if (beforeLink != nullptr)
+        beforeLink(program);
+    glLinkProgram(program);
+    return program;
+}
+
+bool Shader::finishProgram(GLuint program)
+{
+    int success;
+    char infoLog[512];
+
+    // print compile errors if any
+    GLuint attached[2];
+    GLsizei attachedCount = 0;
+    glGetAttachedShaders(program, 2, &attachedCount, attached);
+    for (GLsizei i = 0; i < attachedCount; ++i)
     {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glGetShaderiv(attached[i], GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            GLint type = 0;
+            glGetShaderiv(attached[i], GL_SHADER_TYPE, &type);
+            glGetShaderInfoLog(attached[i], 512, NULL, infoLog);
+            std::cout << (type == GL_VERTEX_SHADER ? "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" : "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n")
+                << infoLog << std::endl;
+        }
     }
-    // link shaders
-    // 
-        // shader Program
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragmentShader);
-    glLinkProgram(ID);
     // print linking errors if any
-    glGetProgramiv(ID, GL_LINK_STATUS, &success);
-    if (!success)
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
     {
-        glGetProgramInfoLog(ID, 512, NULL, infoLog);
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
     }
 
     // delete the shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    for (GLsizei i = 0; i < attachedCount; ++i)
+    {
+        glDetachShader(program, attached[i]);
+        glDeleteShader(attached[i]);
+    }
+    return linked == GL_TRUE;
+}
+
+void Shader::linkUniforms()
+{
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(std::max(maxLength, 1), '\0');
+    for (GLint i = 0; i < count; ++i)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, i, maxLength, &length, &size, &type, &name[0]);
+        std::string uniformName = name.substr(0, length);
+        //Uniforms in a block have no location, they are set through the buffer
+        GLint uniformLocation = glGetUniformLocation(ID, uniformName.c_str());
+        if (uniformLocation < 0)
+            continue;
+        uniformLocations[uniformName] = uniformLocation;
+        //Arrays are listed as "name[0]", and can be set by "name" as well
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+            uniformLocations[uniformName.substr(0, uniformName.size() - 3)] = uniformLocation;
+    }
 
+    GLuint cameraBlock = glGetUniformBlockIndex(ID, CameraUniforms::BLOCK_NAME);
+    if (cameraBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, cameraBlock, CameraUniforms::BINDING);
 }
 
 void Shader::use()
@@ -92,15 +151,15 @@ void Shader::use()
 
 void Shader::setBool(const std::string& name, bool value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(location(name), (int)value);
 }
 
 void Shader::setInt(const std::string& name, int value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(location(name), value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(location(name), value);
 }
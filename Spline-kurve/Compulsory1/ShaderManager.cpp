@@ -0,0 +1,292 @@
+#include "ShaderManager.h"
+#include "ShaderFileLoader.h"
+#include <fstream>
+#include <cstring>
+
+//The program binary functions and enums from GL_ARB_get_program_binary, which glad does not have for OpenGL 3.3
+typedef void (APIENTRYP GetProgramBinaryFunction)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP ProgramBinaryFunction)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriFunction)(GLuint program, GLenum pname, GLint value);
+const GLenum PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;
+const GLenum PROGRAM_BINARY_LENGTH = 0x8741;
+const GLenum NUM_PROGRAM_BINARY_FORMATS = 0x87FE;
+//And from GL_KHR_parallel_shader_compile (GL_ARB_parallel_shader_compile has the same values)
+typedef void (APIENTRYP MaxShaderCompilerThreadsFunction)(GLuint count);
+const GLenum COMPLETION_STATUS = 0x91B1;
+
+static GetProgramBinaryFunction getProgramBinary = nullptr;
+static ProgramBinaryFunction programBinary = nullptr;
+static ProgramParameteriFunction programParameteri = nullptr;
+
+//Tells the driver before the link that the binary will be asked for
+static void retrievableHint(GLuint program)
+{
+    programParameteri(program, PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+//The first bytes of the cache file, a file with another version is ignored
+const char CACHE_MAGIC[8] = { 'S', 'H', 'C', 'A', 'C', 'H', 'E', '1' };
+
+//64-bit FNV-1a
+static uint64_t hashText(const std::string& text, uint64_t hash = 14695981039346656037ull)
+{
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+//Puts the defines on the line after #version, which has to stay the first line
+static std::string withDefines(const std::string& code, const std::string& defines)
+{
+    if (defines.empty())
+        return code;
+    size_t lineEnd = code.compare(0, 8, "#version") == 0 ? code.find('\n') : std::string::npos;
+    if (lineEnd == std::string::npos)
+        return defines + code;
+    return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
+}
+
+ShaderManager::ShaderManager(const std::string& cachePath)
+    : cachePath(cachePath), binarySupport(false), parallelSupport(false), cacheChanged(false), cachedCount(0), compiledCount(0)
+{
+    const char* vendor = reinterpret_cast<const char*>(glGetString(GL_VENDOR));
+    const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    driver = std::string(vendor ? vendor : "") + "\n" + (renderer ? renderer : "") + "\n" + (version ? version : "");
+
+    if (glfwExtensionSupported("GL_ARB_get_program_binary") || GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1))
+    {
+        getProgramBinary = reinterpret_cast<GetProgramBinaryFunction>(glfwGetProcAddress("glGetProgramBinary"));
+        programBinary = reinterpret_cast<ProgramBinaryFunction>(glfwGetProcAddress("glProgramBinary"));
+        programParameteri = reinterpret_cast<ProgramParameteriFunction>(glfwGetProcAddress("glProgramParameteri"));
+        //Some drivers have the extension but no binary formats, then there is nothing to cache
+        GLint formats = 0;
+        glGetIntegerv(NUM_PROGRAM_BINARY_FORMATS, &formats);
+        binarySupport = getProgramBinary && programBinary && programParameteri && formats > 0;
+    }
+    if (binarySupport)
+        loadCache();
+
+    //Lets the driver use as many compiler threads as it wants
+    MaxShaderCompilerThreadsFunction maxCompilerThreads = nullptr;
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+        maxCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsFunction>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+    else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+        maxCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsFunction>(glfwGetProcAddress("glMaxShaderCompilerThreadsARB"));
+    if (maxCompilerThreads != nullptr)
+    {
+        maxCompilerThreads(0xFFFFFFFF);
+        parallelSupport = true;
+    }
+}
+
+ShaderManager::~ShaderManager()
+{
+    if (cacheChanged)
+        saveCache();
+}
+
+const std::string& ShaderManager::source(const std::string& path)
+{
+    auto found = sources.find(path);
+    if (found != sources.end())
+        return found->second;
+    return sources[path] = ShaderLoader::LoadShaderFromFile(path);
+}
+
+Shader& ShaderManager::get(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
+{
+    std::string name = startProgram(vertexPath, fragmentPath, defines);
+    auto found = programs.find(name);
+    if (found != programs.end())
+        return *found->second;
+
+    auto pending = pendingPrograms.find(name);
+    GLuint program = finishProgram(pending->second);
+    pendingPrograms.erase(pending);
+    std::unique_ptr<Shader>& shader = programs[name];
+    shader.reset(new Shader(program));
+    return *shader;
+}
+
+void ShaderManager::prepare(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
+{
+    startProgram(vertexPath, fragmentPath, defines);
+}
+
+bool ShaderManager::ready(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
+{
+    std::string name = vertexPath + "|" + fragmentPath + "|" + defines;
+    if (programs.count(name) > 0)
+        return true;
+    auto pending = pendingPrograms.find(name);
+    if (pending == pendingPrograms.end() || !parallelSupport)
+        return false;
+    GLint done = GL_FALSE;
+    glGetProgramiv(pending->second.program, COMPLETION_STATUS, &done);
+    return done == GL_TRUE;
+}
+
+std::string ShaderManager::startProgram(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
+{
+    std::string name = vertexPath + "|" + fragmentPath + "|" + defines;
+    if (programs.count(name) > 0 || pendingPrograms.count(name) > 0)
+        return name;
+
+    std::string vertexCode = withDefines(source(vertexPath), defines);
+    std::string fragmentCode = withDefines(source(fragmentPath), defines);
+    uint64_t key = programKey(vertexCode, fragmentCode);
+    GLuint program = binarySupport ? loadCachedProgram(key) : 0;
+    if (program != 0)
+    {
+        programs[name].reset(new Shader(program));
+        return name;
+    }
+
+    ++compiledCount;
+    pendingPrograms[name] = { Shader::beginProgram(vertexCode, fragmentCode, binarySupport ? retrievableHint : nullptr), key };
+    return name;
+}
+
+GLuint ShaderManager::finishProgram(const PendingProgram& pending)
+{
+    GLuint program = pending.program;
+    GLint length = 0;
+    if (!Shader::finishProgram(program) || !binarySupport)
+        return program;
+
+    glGetProgramiv(program, PROGRAM_BINARY_LENGTH, &length);
+    if (length > 0)
+    {
+        CachedBinary binary;
+        binary.data.resize(length);
+        GLsizei written = 0;
+        getProgramBinary(program, length, &written, &binary.format, binary.data.data());
+        binary.data.resize(written);
+        cache[pending.key] = std::move(binary);
+        usedKeys.insert(pending.key);
+        cacheChanged = true;
+    }
+    return program;
+}
+
+GLuint ShaderManager::loadCachedProgram(uint64_t key)
+{
+    auto found = cache.find(key);
+    if (found == cache.end())
+        return 0;
+
+    GLuint program = glCreateProgram();
+    programBinary(program, found->second.format, found->second.data.data(), static_cast<GLsizei>(found->second.data.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked == GL_TRUE)
+    {
+        ++cachedCount;
+        usedKeys.insert(key);
+        return program;
+    }
+    //The driver did not accept the binary, so the program is compiled again
+    glDeleteProgram(program);
+    cache.erase(found);
+    cacheChanged = true;
+    return 0;
+}
+
+uint64_t ShaderManager::programKey(const std::string& vertexCode, const std::string& fragmentCode) const
+{
+    uint64_t hash = hashText(driver);
+    hash = hashText(std::string(1, '\0') + vertexCode, hash);
+    return hashText(std::string(1, '\0') + fragmentCode, hash);
+}
+//The file is the magic bytes, the number of binaries, and then the key, format, length and bytes of each binary
+//A file that is cut off or broken is thrown away, and written again when the program ends. The lengths are checked
+//against the bytes left in the file before anything is allocated.
+void ShaderManager::loadCache()
+{
+    std::ifstream file(cachePath, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return;
+    uint64_t remaining = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+    const uint64_t entryHeader = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+    char magic[sizeof(CACHE_MAGIC)];
+    uint32_t count = 0;
+    if (remaining < sizeof(magic) + sizeof(count) || !file.read(magic, sizeof(magic))
+        || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || !file.read(reinterpret_cast<char*>(&count), sizeof(count)))
+    {
+        discardCache();
+        return;
+    }
+    remaining -= sizeof(magic) + sizeof(count);
+    if (count > remaining / entryHeader)
+    {
+        discardCache();
+        return;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint64_t key = 0;
+        uint32_t format = 0;
+        uint32_t length = 0;
+        if (remaining < entryHeader || !file.read(reinterpret_cast<char*>(&key), sizeof(key))
+            || !file.read(reinterpret_cast<char*>(&format), sizeof(format)) || !file.read(reinterpret_cast<char*>(&length), sizeof(length)))
+        {
+            discardCache();
+            return;
+        }
+        remaining -= entryHeader;
+        if (length == 0 || length > remaining)
+        {
+            discardCache();
+            return;
+        }
+        CachedBinary binary;
+        binary.format = format;
+        binary.data.resize(length);
+        if (!file.read(binary.data.data(), length))
+        {
+            discardCache();
+            return;
+        }
+        remaining -= length;
+        cache[key] = std::move(binary);
+    }
+}
+
+void ShaderManager::discardCache()
+{
+    std::cerr << "Warning: The shader cache " << cachePath << " cannot be read and is thrown away" << std::endl;
+    cache.clear();
+    cacheChanged = true;
+}
+
+void ShaderManager::saveCache()
+{
+    std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to write shader cache: " << cachePath << std::endl;
+        return;
+    }
+    uint32_t count = 0;
+    for (uint64_t key : usedKeys)
+        count += cache.count(key) > 0 ? 1 : 0;
+    file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const auto& entry : cache)
+    {
+        if (usedKeys.count(entry.first) == 0)
+            continue;
+        uint32_t format = entry.second.format;
+        uint32_t length = static_cast<uint32_t>(entry.second.data.size());
+        file.write(reinterpret_cast<const char*>(&entry.first), sizeof(entry.first));
+        file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        file.write(entry.second.data.data(), length);
+    }
+    cacheChanged = false;
+}
@@ -0,0 +1,90 @@
+#ifndef SHADERMANAGER_H
+#define SHADERMANAGER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include "Shader.h"
+
+//Makes and owns the shader programs. Every source file is read once, however many programs use it.
+//When the driver can hand out linked programs (GL_ARB_get_program_binary, core in OpenGL 4.1), the binaries are
+//kept in one cache file. A binary is found by a hash of the two sources and the vendor, renderer and version of
+//the driver, so an edited shader or a new driver gets a new key. If the driver refuses a cached binary, the program
+//is compiled from the sources again and the binary is replaced. Only the binaries used in this run are written
+//back, so the programs of old sources drop out of the file instead of piling up.
+//A program can be asked for with a block of #define lines, which is put after the #version line of both sources.
+//Programs can be prepared before they are needed. With GL_KHR_parallel_shader_compile the driver compiles them on
+//its own threads, and ready tells when a program can be used without waiting.
+//The program binary and parallel compile functions are not part of OpenGL 3.3, so they are loaded with glfwGetProcAddress.
+class ShaderManager
+{
+public:
+    //The context must be current
+    ShaderManager(const std::string& cachePath = "shaders.cache");
+    //Writes the cache file if a new binary was added
+    ~ShaderManager();
+
+    ShaderManager(const ShaderManager&) = delete;
+    ShaderManager& operator=(const ShaderManager&) = delete;
+
+    //The program for the two files, made the first time it is asked for, or finished if it was prepared
+    Shader& get(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+    //Starts making the program without waiting for it
+    void prepare(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+    //True if get will not have to wait for the compiler
+    bool ready(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines = "");
+    //The text of a shader file, read the first time it is asked for
+    const std::string& source(const std::string& path);
+
+    void saveCache();
+
+    bool binariesSupported() const { return binarySupport; }
+    bool parallelCompileSupported() const { return parallelSupport; }
+    //Programs loaded from the cache and programs compiled from the sources
+    int getCachedCount() const { return cachedCount; }
+    int getCompiledCount() const { return compiledCount; }
+
+private:
+    struct CachedBinary
+    {
+        GLenum format;
+        std::vector<char> data;
+    };
+    //A program the driver is still compiling, and the key its binary is cached under
+    struct PendingProgram
+    {
+        GLuint program;
+        uint64_t key;
+    };
+
+    //Loads the program from the cache or starts compiling it, returns the name of the program
+    std::string startProgram(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines);
+    //Waits for a compiled program and puts its binary in the cache
+    GLuint finishProgram(const PendingProgram& pending);
+    GLuint loadCachedProgram(uint64_t key);
+    uint64_t programKey(const std::string& vertexCode, const std::string& fragmentCode) const;
+    void loadCache();
+    //Empties the cache so a broken file is written again
+    void discardCache();
+
+    std::string cachePath;
+    bool binarySupport;
+    bool parallelSupport;
+    bool cacheChanged;
+    int cachedCount;
+    int compiledCount;
+    //Vendor, renderer and version of the driver, part of every key
+    std::string driver;
+
+    std::unordered_map<std::string, std::string> sources;
+    std::unordered_map<std::string, std::unique_ptr<Shader>> programs;
+    std::unordered_map<std::string, PendingProgram> pendingPrograms;
+    std::unordered_map<uint64_t, CachedBinary> cache;
+    //The keys of the binaries loaded or added in this run, the ones saveCache writes
+    std::unordered_set<uint64_t> usedKeys;
+};
+
+#endif
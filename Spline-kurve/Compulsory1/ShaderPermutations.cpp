@@ -0,0 +1,36 @@
+#include "ShaderPermutations.h"
+
+ShaderPermutations::ShaderPermutations(ShaderManager& shaders, const std::string& vertexPath, const std::string& fragmentPath,
+    const std::vector<std::string>& featureDefines)
+    : shaders(shaders), vertexPath(vertexPath), fragmentPath(fragmentPath), featureDefines(featureDefines),
+    variants(size_t(1) << featureDefines.size(), nullptr)
+{
+}
+
+Shader& ShaderPermutations::get(unsigned int features)
+{
+    Shader*& variant = variants.at(features);
+    if (variant == nullptr)
+        variant = &shaders.get(vertexPath, fragmentPath, defines(features));
+    return *variant;
+}
+
+void ShaderPermutations::prepare(unsigned int features)
+{
+    if (variants.at(features) == nullptr)
+        shaders.prepare(vertexPath, fragmentPath, defines(features));
+}
+
+bool ShaderPermutations::ready(unsigned int features)
+{
+    return variants.at(features) != nullptr || shaders.ready(vertexPath, fragmentPath, defines(features));
+}
+
+std::string ShaderPermutations::defines(unsigned int features) const
+{
+    std::string lines;
+    for (size_t i = 0; i < featureDefines.size(); ++i)
+        if (features & (1u << i))
+            lines += "#define " + featureDefines[i] + "\n";
+    return lines;
+}
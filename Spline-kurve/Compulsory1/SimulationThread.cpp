@@ -0,0 +1,88 @@
+#include "SimulationThread.h"
+
+SimulationThread::SimulationThread(float timeStep, const std::function<void(double)>& step, int maxCatchUpSteps)
+    : timeStep(timeStep), step(step), maxCatchUpSteps(maxCatchUpSteps), startTime(std::chrono::steady_clock::now())
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+}
+
+void SimulationThread::start()
+{
+    if (running.exchange(true))
+        return;
+    thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
+
+void SimulationThread::post(const std::function<void()>& command)
+{
+    std::lock_guard<std::mutex> lock(commandMutex);
+    commands.push_back(command);
+}
+
+double SimulationThread::now() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void SimulationThread::runCommands()
+{
+    //The commands are taken out of the list first, so the render thread can post new ones while these run
+    std::vector<std::function<void()>> waiting;
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        waiting.swap(commands);
+    }
+    for (const std::function<void()>& command : waiting)
+        command();
+}
+
+void SimulationThread::runUntil(double time)
+{
+    runCommands();
+    int catchUp = 0;
+    while (steppedTime + timeStep <= time && catchUp < maxCatchUpSteps)
+    {
+        steppedTime += timeStep;
+        step(steppedTime);
+        ++steps;
+        ++catchUp;
+    }
+    //The same as on the thread, the time that could not be caught up with is skipped
+    if (steppedTime + timeStep <= time)
+        steppedTime = time;
+}
+
+void SimulationThread::run()
+{
+    //nextTime is the time the state after the next step belongs to
+    double nextTime = now() + timeStep;
+    while (running)
+    {
+        runCommands();
+
+        int catchUp = 0;
+        while (now() >= nextTime && catchUp < maxCatchUpSteps)
+        {
+            step(nextTime);
+            ++steps;
+            nextTime += timeStep;
+            ++catchUp;
+        }
+        if (catchUp == maxCatchUpSteps && now() >= nextTime)
+            nextTime = now() + timeStep;
+
+        std::this_thread::sleep_until(startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(nextTime)));
+    }
+}
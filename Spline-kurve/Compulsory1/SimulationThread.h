@@ -0,0 +1,61 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+//Runs the simulation on its own thread with a fixed time step, in real time.
+//The step function is called once per time step with the time (seconds on the clock of now()) that the new state
+//belongs to, and it publishes the state for the render thread (for example through BallSnapshots).
+//Commands from the render thread, like dropping new balls, are posted and run on the simulation thread between two
+//steps, so the simulation state is only ever touched by one thread.
+//If the simulation falls behind (a step takes longer than the time step), at most maxCatchUpSteps are run back to back
+//and the rest of the time is skipped, so a slow moment does not make the simulation run faster afterwards.
+class SimulationThread
+{
+public:
+    SimulationThread(float timeStep, const std::function<void(double)>& step, int maxCatchUpSteps = 8);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    void start();
+    //Waits for the current step to finish and stops the thread
+    void stop();
+
+    //Runs the command on the simulation thread before the next step
+    void post(const std::function<void()>& command);
+
+    //Only when the thread is not started: runs the commands and the steps up to time on the calling thread. The time
+    //comes from the caller, so a run driven by a fixed clock (the benchmark) makes the same steps every time.
+    void runUntil(double time);
+
+    //Seconds since the simulation thread object was made, the same clock in both threads
+    double now() const;
+    float getTimeStep() const { return timeStep; }
+    unsigned long long stepCount() const { return steps.load(); }
+
+private:
+    void run();
+    void runCommands();
+
+    float timeStep;
+    std::function<void(double)> step;
+    int maxCatchUpSteps;
+    std::chrono::steady_clock::time_point startTime;
+    //The time of the last step made by runUntil
+    double steppedTime = 0.0;
+
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    std::atomic<unsigned long long> steps{ 0 };
+    std::mutex commandMutex;
+    std::vector<std::function<void()>> commands;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <vector>
+#include <cstddef>
+#include <glad/glad.h>
+
+//A ring buffer for data that changes every frame: instances, edited samples and texture tiles.
+//The buffer is split into segments, one for each frame in flight. A frame writes into its own segment with
+//glMapBufferRange and the unsynchronized and invalidate flags, so the driver neither waits for the GPU nor
+//makes a new copy of the buffer. After the draw calls of the frame a fence is placed, and a segment is only written
+//again when its fence says the GPU has finished reading it. With three segments the CPU can be two frames ahead.
+//OpenGL 3.3 has no persistent mapping (glBufferStorage is 4.4), so every write maps and unmaps its own range instead.
+//The offset that write returns must be used right away (a draw call, a copy or a texture upload), because the buffer
+//gets new storage if a frame needs more room than a segment has.
+class StreamBuffer
+{
+public:
+    StreamBuffer(size_t segmentSize, int segmentCount = 3);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    //Moves on to the next segment, and waits for the GPU if it still reads that segment
+    void beginFrame();
+    //Copies the data into the segment of this frame and returns the offset in the buffer
+    GLintptr write(const void* data, size_t bytes);
+    //Places the fence for the segment of this frame, after the draw calls that read it
+    void endFrame();
+
+    GLuint getBuffer() const { return buffer; }
+    //Bytes written in the last whole frame
+    size_t bytesLastFrame() const { return lastFrameBytes; }
+    //The number of frames that had to wait for the GPU, and the number of times the buffer grew
+    unsigned long long getWaits() const { return waits; }
+    unsigned long long getReallocations() const { return reallocations; }
+
+private:
+    void grow(size_t bytes);
+
+    GLuint buffer;
+    size_t segmentSize;
+    int segmentCount;
+    int segment;
+    //Bytes used in the segment of this frame
+    size_t used;
+    //Bytes written since beginFrame, used is reset when the buffer grows so it cannot count them
+    size_t frameBytes;
+    size_t lastFrameBytes;
+    std::vector<GLsync> fences;
+    unsigned long long waits;
+    unsigned long long reallocations;
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "SubdivisionTessellator.h"
+#include <algorithm>
+
+//The highest degree the midpoint split supports, the same as BSplineSurface
+static const int MAX_DEGREE = 7;
+
+//Splits one Bezier segment of degree + 1 points in the middle into two segments of 2 * degree + 1 points.
+//Each averaging round gives one new point of the left half and one of the right half, the last round gives
+//the point on the curve in the middle of the segment.
+static void splitSegment(const glm::vec4* in, int inStride, glm::vec4* out, int outStride, int degree)
+{
+    glm::vec4 work[MAX_DEGREE + 1];
+    for (int k = 0; k <= degree; ++k)
+        work[k] = in[k * inStride];
+
+    out[0] = work[0];
+    out[2 * degree * outStride] = work[degree];
+    for (int level = 1; level <= degree; ++level)
+    {
+        for (int k = 0; k <= degree - level; ++k)
+            work[k] = 0.5f * (work[k] + work[k + 1]);
+        out[level * outStride] = work[0];
+        out[(2 * degree - level) * outStride] = work[degree - level];
+    }
+}
+
+//Distance from the point to the line segment between a and b
+static float distanceToSegment(const glm::vec3& point, const glm::vec3& a, const glm::vec3& b)
+{
+    glm::vec3 ab = b - a;
+    float lengthSquared = glm::dot(ab, ab);
+    float t = lengthSquared > 0.0f ? glm::clamp(glm::dot(point - a, ab) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+    return glm::length(point - (a + t * ab));
+}
+
+SubdivisionTessellator::SubdivisionTessellator(const BSplineSurface& surface)
+    : bezier(surface.bezierForm()), netRows(0), netColumns(0), rows(0), columns(0)
+{
+}
+
+void SubdivisionTessellator::resetNet()
+{
+    net = bezier.homogeneousPoints;
+    netRows = bezier.height;
+    netColumns = bezier.width;
+}
+
+int SubdivisionTessellator::tessellate(float tolerance, int maxLevel)
+{
+    resetNet();
+    int level = 0;
+    while (level < maxLevel && flatness() > tolerance)
+    {
+        splitRows();
+        splitColumns();
+        ++level;
+    }
+    extractCorners();
+    return level;
+}
+
+void SubdivisionTessellator::tessellateLevel(int level)
+{
+    resetNet();
+    for (int l = 0; l < level; ++l)
+    {
+        splitRows();
+        splitColumns();
+    }
+    extractCorners();
+}
+
+void SubdivisionTessellator::splitRows()
+{
+    //Splits in the u direction, every column of the net is one line
+    int degree = bezier.degreeU;
+    int segments = (netRows - 1) / degree;
+    int newRows = 2 * segments * degree + 1;
+    scratch.resize(static_cast<size_t>(newRows) * netColumns);
+    //The columns are the inner loop, so the rows of the net are read and written in memory order
+    for (int s = 0; s < segments; ++s)
+    {
+        const glm::vec4* in = &net[static_cast<size_t>(s) * degree * netColumns];
+        glm::vec4* out = &scratch[static_cast<size_t>(2 * s) * degree * netColumns];
+        for (int c = 0; c < netColumns; ++c)
+            splitSegment(in + c, netColumns, out + c, netColumns, degree);
+    }
+    net.swap(scratch);
+    netRows = newRows;
+}
+
+void SubdivisionTessellator::splitColumns()
+{
+    //Splits in the v direction, every row of the net is one line
+    int degree = bezier.degreeV;
+    int segments = (netColumns - 1) / degree;
+    int newColumns = 2 * segments * degree + 1;
+    scratch.resize(static_cast<size_t>(netRows) * newColumns);
+    for (int r = 0; r < netRows; ++r)
+    {
+        for (int s = 0; s < segments; ++s)
+            splitSegment(&net[r * netColumns + s * degree], 1, &scratch[r * newColumns + 2 * s * degree], 1, degree);
+    }
+    net.swap(scratch);
+    netColumns = newColumns;
+}
+
+float SubdivisionTessellator::flatness() const
+{
+    //The surface lies inside the convex hull of the control points, so when the inner control points of every
+    //segment are close to the line between its end points, the mesh through the corners is close to the surface
+    float largest = 0.0f;
+    int degreeU = bezier.degreeU;
+    int degreeV = bezier.degreeV;
+    auto point = [&](int r, int c) { const glm::vec4& p = net[r * netColumns + c]; return glm::vec3(p) / p.w; };
+
+    for (int r = 0; r < netRows; ++r)
+    {
+        for (int c = 0; c + degreeV < netColumns; c += degreeV)
+        {
+            glm::vec3 a = point(r, c), b = point(r, c + degreeV);
+            for (int k = 1; k < degreeV; ++k)
+                largest = std::max(largest, distanceToSegment(point(r, c + k), a, b));
+        }
+    }
+    for (int c = 0; c < netColumns; ++c)
+    {
+        for (int r = 0; r + degreeU < netRows; r += degreeU)
+        {
+            glm::vec3 a = point(r, c), b = point(r + degreeU, c);
+            for (int k = 1; k < degreeU; ++k)
+                largest = std::max(largest, distanceToSegment(point(r + k, c), a, b));
+        }
+    }
+    return largest;
+}
+
+void SubdivisionTessellator::extractCorners()
+{
+    //Every degree-th point of the net is a patch corner on the surface
+    rows = (netRows - 1) / bezier.degreeU + 1;
+    columns = (netColumns - 1) / bezier.degreeV + 1;
+    points.resize(static_cast<size_t>(rows) * columns);
+    for (int i = 0; i < rows; ++i)
+    {
+        const glm::vec4* netRow = &net[static_cast<size_t>(i) * bezier.degreeU * netColumns];
+        for (int j = 0; j < columns; ++j)
+        {
+            const glm::vec4& corner = netRow[j * bezier.degreeV];
+            points[i * columns + j] = glm::vec3(corner) / corner.w;
+        }
+    }
+}
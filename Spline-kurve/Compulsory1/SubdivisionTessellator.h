@@ -0,0 +1,51 @@
+#ifndef SUBDIVISIONTESSELLATOR_H
+#define SUBDIVISIONTESSELLATOR_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "BSplineSurface.h"
+#include "SurfaceTessellator.h"
+
+//Tessellates a B-spline surface by refining the control net instead of evaluating the surface at every sample.
+//The surface is first split into Bezier patches with knot insertion. Each refinement step then splits every
+//patch in the middle in both directions with de Casteljau midpoint splitting (the Bezier splitting at 1/2),
+//which only needs additions and halving. The patch corners lie on the surface, so after L steps they are the
+//exact samples of a grid with 2^L samples per knot span. The net is refined until every patch is flat enough
+//or the highest level is reached.
+class SubdivisionTessellator
+{
+public:
+    SubdivisionTessellator(const BSplineSurface& surface);
+
+    //Refines until the control net is within the tolerance of the patch corners and returns the level that was used
+    int tessellate(float tolerance, int maxLevel = 8);
+    //Refines a fixed number of times, gives (spansU * 2^level + 1) x (spansV * 2^level + 1) samples
+    void tessellateLevel(int level);
+
+    //The samples as points[i * columns + j], the same layout as SurfaceTessellator
+    const std::vector<glm::vec3>& getPoints() const { return points; }
+    int getRows() const { return rows; }
+    int getColumns() const { return columns; }
+    //Line indices for every row and column of the sample grid
+    std::vector<unsigned int> wireframeIndices() const { return SurfaceTessellator::gridLines(rows, columns); }
+
+private:
+    void resetNet();
+    void splitRows();
+    void splitColumns();
+    float flatness() const;
+    void extractCorners();
+
+    BSplineSurface bezier;
+    //The refined Bezier control net in homogeneous coordinates, net[r * netColumns + c]
+    std::vector<glm::vec4> net;
+    std::vector<glm::vec4> scratch;
+    int netRows;
+    int netColumns;
+
+    std::vector<glm::vec3> points;
+    int rows;
+    int columns;
+};
+
+#endif
@@ -0,0 +1,217 @@
+#include "SurfaceBalls.h"
+#include <algorithm>
+#include <cmath>
+
+//Balls per block in the thread pool
+const size_t BALL_BLOCK = 256;
+//Newton iterations per step. The ball moves only a little between two steps, so the guess is already close.
+const int PROJECTION_ITERATIONS = 3;
+//Newton steps are limited to this length in parameter space, so a bad guess can not jump across the surface
+const float MAX_PARAMETER_STEP = 0.25f;
+//Samples in each direction when a new ball looks for its first guess
+const int GUESS_SAMPLES = 9;
+
+SurfaceBalls::SurfaceBalls(const BSplineSurface& surface, float radius, const glm::vec3& gravity, float timeStep)
+    : radius(radius), gravity(gravity), restitution(0.2f), rollingFriction(0.1f), timeStep(timeStep),
+    surface(surface), boxMin(0.0f), boxMax(0.0f)
+{
+}
+
+void SurfaceBalls::closestSample(const glm::vec3& point, float& u, float& v) const
+{
+    float bestDistance = INFINITY;
+    for (int i = 0; i < GUESS_SAMPLES; ++i)
+    {
+        for (int j = 0; j < GUESS_SAMPLES; ++j)
+        {
+            float sampleU = i / static_cast<float>(GUESS_SAMPLES - 1);
+            float sampleV = j / static_cast<float>(GUESS_SAMPLES - 1);
+            glm::vec3 difference = surface.evaluate(sampleU, sampleV) - point;
+            float distance = glm::dot(difference, difference);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                u = sampleU;
+                v = sampleV;
+            }
+        }
+    }
+}
+
+void SurfaceBalls::addBall(const glm::vec3& position, const glm::vec3& velocity)
+{
+    float u = 0.0f, v = 0.0f;
+    closestSample(position, u, v);
+    positionX.push_back(position.x);
+    positionY.push_back(position.y);
+    positionZ.push_back(position.z);
+    velocityX.push_back(velocity.x);
+    velocityY.push_back(velocity.y);
+    velocityZ.push_back(velocity.z);
+    parameterU.push_back(u);
+    parameterV.push_back(v);
+}
+
+void SurfaceBalls::clear()
+{
+    positionX.clear();
+    positionY.clear();
+    positionZ.clear();
+    velocityX.clear();
+    velocityY.clear();
+    velocityZ.clear();
+    parameterU.clear();
+    parameterV.clear();
+}
+
+glm::vec3 SurfaceBalls::project(const glm::vec3& point, float& u, float& v, glm::vec3& normal) const
+{
+    glm::vec3 surfacePoint, derivativeU, derivativeV;
+    for (int iteration = 0; iteration < PROJECTION_ITERATIONS; ++iteration)
+    {
+        //Gauss-Newton step for the smallest |S(u, v) - point|: solves the 2x2 normal equations J^T J d = -J^T r
+        surface.evaluate(u, v, surfacePoint, derivativeU, derivativeV);
+        glm::vec3 residual = surfacePoint - point;
+        float a = glm::dot(derivativeU, derivativeU);
+        float b = glm::dot(derivativeU, derivativeV);
+        float c = glm::dot(derivativeV, derivativeV);
+        float gradientU = glm::dot(derivativeU, residual);
+        float gradientV = glm::dot(derivativeV, residual);
+        float determinant = a * c - b * b;
+        if (determinant <= 1e-12f)
+            break;
+        float stepU = -(c * gradientU - b * gradientV) / determinant;
+        float stepV = -(a * gradientV - b * gradientU) / determinant;
+        float length = std::sqrt(stepU * stepU + stepV * stepV);
+        if (length > MAX_PARAMETER_STEP)
+        {
+            stepU *= MAX_PARAMETER_STEP / length;
+            stepV *= MAX_PARAMETER_STEP / length;
+        }
+        u = std::min(std::max(u + stepU, 0.0f), 1.0f);
+        v = std::min(std::max(v + stepV, 0.0f), 1.0f);
+        if (length < 1e-6f)
+            break;
+    }
+
+    surface.evaluate(u, v, surfacePoint, derivativeU, derivativeV);
+    normal = glm::cross(derivativeU, derivativeV);
+    float length = glm::length(normal);
+    normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    if (normal.z < 0.0f)
+        normal = -normal;
+    return surfacePoint;
+}
+
+void SurfaceBalls::step(ThreadPool& pool)
+{
+    //The surface is inside the box around its control points (convex hull property), so a ball outside the box
+    //grown by the radius can not touch it and is not projected
+    boxMin = boxMax = surface.controlPoints[0];
+    for (const glm::vec3& point : surface.controlPoints)
+    {
+        boxMin = glm::min(boxMin, point);
+        boxMax = glm::max(boxMax, point);
+    }
+    boxMin -= glm::vec3(radius);
+    boxMax += glm::vec3(radius);
+    pool.parallelFor(size(), BALL_BLOCK, [this](size_t begin, size_t end) { stepBalls(begin, end); });
+}
+
+void SurfaceBalls::stepBalls(size_t begin, size_t end)
+{
+    //The pool can give a range that is longer than one block (for example when it only has one thread),
+    //and the arrays of contact points are one block long
+    for (size_t first = begin; first < end; first += BALL_BLOCK)
+        stepBlock(first, std::min(end - first, BALL_BLOCK));
+}
+
+void SurfaceBalls::stepBlock(size_t begin, size_t count)
+{
+    const float dt = timeStep;
+    float* px = &positionX[begin];
+    float* py = &positionY[begin];
+    float* pz = &positionZ[begin];
+    float* vx = &velocityX[begin];
+    float* vy = &velocityY[begin];
+    float* vz = &velocityZ[begin];
+
+    //Semi-implicit Euler: the velocity is updated first and the new velocity moves the ball
+    for (size_t k = 0; k < count; ++k)
+    {
+        vx[k] += gravity.x * dt;
+        vy[k] += gravity.y * dt;
+        vz[k] += gravity.z * dt;
+        px[k] += vx[k] * dt;
+        py[k] += vy[k] * dt;
+        pz[k] += vz[k] * dt;
+    }
+
+    //The closest surface point and the normal there for every ball in the block
+    float footX[BALL_BLOCK], footY[BALL_BLOCK], footZ[BALL_BLOCK];
+    float normalX[BALL_BLOCK], normalY[BALL_BLOCK], normalZ[BALL_BLOCK];
+    for (size_t k = 0; k < count; ++k)
+    {
+        glm::vec3 position(px[k], py[k], pz[k]);
+        glm::vec3 normal(0.0f);
+        glm::vec3 foot(0.0f);
+        if (glm::all(glm::greaterThanEqual(position, boxMin)) && glm::all(glm::lessThanEqual(position, boxMax)))
+        {
+            float& u = parameterU[begin + k];
+            float& v = parameterV[begin + k];
+            foot = project(position, u, v, normal);
+            //When the closest point is not straight under the ball, the projection either ended in the wrong valley
+            //(the guess is from when the ball was high above the surface) or the ball is outside the edge of the surface.
+            //It starts again from the closest sample, and if that does not help either, the ball has no contact.
+            if (!underBall(position, foot, normal))
+            {
+                closestSample(position, u, v);
+                foot = project(position, u, v, normal);
+                if (!underBall(position, foot, normal))
+                    normal = glm::vec3(0.0f);
+            }
+        }
+        footX[k] = foot.x;
+        footY[k] = foot.y;
+        footZ[k] = foot.z;
+        normalX[k] = normal.x;
+        normalY[k] = normal.y;
+        normalZ[k] = normal.z;
+    }
+
+    //Contact: a ball closer to the surface than its radius is moved out along the normal, and the velocity into the
+    //surface is removed (or turned around for a small bounce). What is left of gravity is the part along the surface.
+    float friction = std::max(1.0f - rollingFriction * dt, 0.0f);
+    for (size_t k = 0; k < count; ++k)
+    {
+        float distance = (px[k] - footX[k]) * normalX[k] + (py[k] - footY[k]) * normalY[k] + (pz[k] - footZ[k]) * normalZ[k];
+        float normalSpeed = vx[k] * normalX[k] + vy[k] * normalY[k] + vz[k] * normalZ[k];
+        //A fast ball can go deeper than its radius in one step, but a ball that is further below the surface than it
+        //could have moved in this step has fallen past the edge and is left alone
+        float deepest = -radius + std::min(normalSpeed, 0.0f) * dt;
+        float contact = (normalZ[k] > 0.0f && distance < radius && distance > deepest) ? 1.0f : 0.0f;
+        float push = contact * (radius - distance);
+        px[k] += push * normalX[k];
+        py[k] += push * normalY[k];
+        pz[k] += push * normalZ[k];
+        float impulse = contact * std::min(normalSpeed, 0.0f) * (1.0f + restitution);
+        float scale = contact > 0.0f ? friction : 1.0f;
+        vx[k] = (vx[k] - impulse * normalX[k]) * scale;
+        vy[k] = (vy[k] - impulse * normalY[k]) * scale;
+        vz[k] = (vz[k] - impulse * normalZ[k]) * scale;
+    }
+}
+
+bool SurfaceBalls::underBall(const glm::vec3& position, const glm::vec3& foot, const glm::vec3& normal) const
+{
+    //The ball is less than half a radius away from the normal line through the surface point
+    glm::vec3 offset = position - foot;
+    glm::vec3 sideways = offset - glm::dot(offset, normal) * normal;
+    return glm::dot(sideways, sideways) <= 0.25f * radius * radius;
+}
+
+void SurfaceBalls::copyPositions(glm::vec3* out) const
+{
+    for (size_t i = 0; i < size(); ++i)
+        out[i] = glm::vec3(positionX[i], positionY[i], positionZ[i]);
+}
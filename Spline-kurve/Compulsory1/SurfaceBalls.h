@@ -0,0 +1,63 @@
+#ifndef SURFACEBALLS_H
+#define SURFACEBALLS_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "BSplineSurface.h"
+#include "ThreadPool.h"
+
+//Balls that roll directly on a B-spline surface, without a mesh. The contact point under a ball is found by projecting
+//the centre of the ball onto the surface with Newton's method, starting from the (u, v) the ball had in the previous
+//step, so a couple of iterations are enough. The height and the normal come from the exact surface and its
+//derivatives, so the contact does not depend on any tessellation.
+//The balls are stored as a structure of arrays like the balls on the terrain. Each block of balls is handled in passes:
+//moving all balls, projecting all balls and then the contact response for all balls. The first and the last pass are
+//plain loops over float arrays that the compiler can vectorize; the projection has to look up knot spans for each ball.
+//The surface is treated as a height field: the normal is turned so it points up (positive z).
+class SurfaceBalls
+{
+public:
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> velocityX, velocityY, velocityZ;
+    //The surface parameters of the contact point in the last step, the start of the next projection
+    std::vector<float> parameterU, parameterV;
+
+    float radius;
+    glm::vec3 gravity;
+    //How much of the velocity into the surface is kept after a bounce (0 gives no bounce)
+    float restitution;
+    //Rolling resistance, the part of the speed that is lost per second while the ball touches the surface
+    float rollingFriction;
+    //The length of one simulation step in seconds
+    float timeStep;
+
+    SurfaceBalls(const BSplineSurface& surface, float radius, const glm::vec3& gravity, float timeStep = 1.0f / 60.0f);
+
+    size_t size() const { return positionX.size(); }
+    //Adds a ball, the first (u, v) guess is the closest of a coarse grid of surface samples
+    void addBall(const glm::vec3& position, const glm::vec3& velocity = glm::vec3(0.0f));
+    void clear();
+
+    //Moves all balls one time step, the balls are shared between the threads in blocks
+    void step(ThreadPool& pool);
+
+    //Newton projection of a point onto the surface. u and v are the start guess and get the parameters of the
+    //closest point. Returns the surface point, and normal gets the upward unit normal there.
+    glm::vec3 project(const glm::vec3& point, float& u, float& v, glm::vec3& normal) const;
+
+    //Writes the ball centres as points, for drawing
+    void copyPositions(glm::vec3* out) const;
+
+private:
+    void stepBalls(size_t begin, size_t end);
+    void stepBlock(size_t begin, size_t count);
+    //The (u, v) of the closest point in a coarse grid of surface samples
+    void closestSample(const glm::vec3& point, float& u, float& v) const;
+    bool underBall(const glm::vec3& position, const glm::vec3& foot, const glm::vec3& normal) const;
+
+    const BSplineSurface& surface;
+    //The box around the control points, grown by the radius
+    glm::vec3 boxMin, boxMax;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include "SurfaceTessellator.h"
+#include <algorithm>
+
+SurfaceTessellator::SurfaceTessellator(const BSplineSurface& surface, int samplesU, int samplesV)
+    : surface(surface), samplesU(samplesU), samplesV(samplesV)
+{
+    int orderU = surface.degreeU + 1;
+    int orderV = surface.degreeV + 1;
+    spansU.resize(samplesU);
+    spansV.resize(samplesV);
+    basisU.resize(samplesU * orderU);
+    basisV.resize(samplesV * orderV);
+    blendedRow.resize(surface.width);
+
+    //Normalizes u and v to be in a range of 0 to 1, the same way as the sample loop in main did
+    for (int i = 0; i < samplesU; ++i)
+    {
+        float u = i / static_cast<float>(samplesU - 1);
+        spansU[i] = BSplineSurface::findSpan(surface.knotsU, surface.degreeU, surface.height, u);
+        BSplineSurface::basisFunctions(surface.knotsU, surface.degreeU, spansU[i], u, &basisU[i * orderU]);
+    }
+    for (int j = 0; j < samplesV; ++j)
+    {
+        float v = j / static_cast<float>(samplesV - 1);
+        spansV[j] = BSplineSurface::findSpan(surface.knotsV, surface.degreeV, surface.width, v);
+        BSplineSurface::basisFunctions(surface.knotsV, surface.degreeV, spansV[j], v, &basisV[j * orderV]);
+    }
+}
+
+void SurfaceTessellator::tessellate()
+{
+    //The samples are only stored by the functions that keep them, a grid that is written straight into a buffer
+    //never allocates them
+    points.resize(static_cast<size_t>(samplesU) * samplesV);
+    DirtyRegion all;
+    all.lastRow = samplesU - 1;
+    all.lastColumn = samplesV - 1;
+    evaluateRegion(all);
+}
+
+void SurfaceTessellator::tessellate(ThreadPool& pool, glm::vec3* out) const
+{
+    pool.parallelFor(samplesU, 16, [&](size_t begin, size_t end)
+    {
+        std::vector<glm::vec4> scratch(surface.width);
+        for (size_t i = begin; i < end; ++i)
+            evaluateRow(static_cast<int>(i), 0, samplesV - 1, scratch.data(), out + i * samplesV);
+    });
+}
+
+std::vector<unsigned int> SurfaceTessellator::gridLines(int rows, int columns)
+{
+    std::vector<unsigned int> indices(lineIndexCount(rows, columns));
+    for (int i = 0; i < rows; ++i)
+        writeLineRow(i, rows, columns, indices.data());
+    return indices;
+}
+
+size_t SurfaceTessellator::lineIndexCount(int rows, int columns)
+{
+    return static_cast<size_t>(2) * (static_cast<size_t>(rows) * (columns - 1) + static_cast<size_t>(rows - 1) * columns);
+}
+
+size_t SurfaceTessellator::triangleIndexCount(int rows, int columns)
+{
+    return static_cast<size_t>(6) * (rows - 1) * (columns - 1);
+}
+
+void SurfaceTessellator::writeLineRow(int i, int rows, int columns, unsigned int* out)
+{
+    //Every row before this one has columns - 1 lines along the row and columns lines down to the next row
+    unsigned int* write = out + static_cast<size_t>(i) * (2 * (columns - 1) + 2 * columns);
+    for (int j = 0; j < columns; ++j)
+    {
+        unsigned int point = i * columns + j;
+        if (j + 1 < columns)
+        {
+            *write++ = point;
+            *write++ = point + 1;
+        }
+        if (i + 1 < rows)
+        {
+            *write++ = point;
+            *write++ = point + columns;
+        }
+    }
+}
+
+void SurfaceTessellator::writeLineIndices(ThreadPool& pool, int rows, int columns, unsigned int* out)
+{
+    pool.parallelFor(rows, 64, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            writeLineRow(static_cast<int>(i), rows, columns, out);
+    });
+}
+
+void SurfaceTessellator::writeTriangleIndices(ThreadPool& pool, int rows, int columns, unsigned int* out)
+{
+    pool.parallelFor(rows - 1, 64, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            //Two triangles for every grid cell, six indices per cell
+            unsigned int* write = out + i * (columns - 1) * 6;
+            unsigned int rowStart = static_cast<unsigned int>(i * columns);
+            for (int j = 0; j + 1 < columns; ++j)
+            {
+                unsigned int point = rowStart + j;
+                write[0] = point;
+                write[1] = point + columns;
+                write[2] = point + 1;
+                write[3] = point + 1;
+                write[4] = point + columns;
+                write[5] = point + columns + 1;
+                write += 6;
+            }
+        }
+    });
+}
+
+DirtyRegion SurfaceTessellator::updateControlPoint(int index)
+{
+    int row = index / surface.width;
+    int column = index % surface.width;
+
+    //A sample in span s depends on the control points s - degree to s, so the control point only affects
+    //the samples whose span is between row and row + degree. The spans increase with the sample index,
+    //which means the affected samples are one continuous range that can be found with a binary search.
+    DirtyRegion region;
+    region.firstRow = static_cast<int>(std::lower_bound(spansU.begin(), spansU.end(), row) - spansU.begin());
+    region.lastRow = static_cast<int>(std::upper_bound(spansU.begin(), spansU.end(), row + surface.degreeU) - spansU.begin()) - 1;
+    region.firstColumn = static_cast<int>(std::lower_bound(spansV.begin(), spansV.end(), column) - spansV.begin());
+    region.lastColumn = static_cast<int>(std::upper_bound(spansV.begin(), spansV.end(), column + surface.degreeV) - spansV.begin()) - 1;
+
+    //Without stored samples there is nothing to update a part of, so the whole grid is evaluated and has changed
+    if (points.empty())
+    {
+        tessellate();
+        DirtyRegion all;
+        all.lastRow = samplesU - 1;
+        all.lastColumn = samplesV - 1;
+        return all;
+    }
+    if (!region.empty())
+        evaluateRegion(region);
+    return region;
+}
+
+void SurfaceTessellator::evaluateRegion(const DirtyRegion& region)
+{
+    for (int i = region.firstRow; i <= region.lastRow; ++i)
+        evaluateRow(i, region.firstColumn, region.lastColumn, blendedRow.data(), &points[static_cast<size_t>(i) * samplesV]);
+}
+
+void SurfaceTessellator::evaluateRow(int i, int firstColumn, int lastColumn, glm::vec4* scratch, glm::vec3* rowPoints) const
+{
+    int orderU = surface.degreeU + 1;
+    int orderV = surface.degreeV + 1;
+    int width = surface.width;
+    //The control point columns that the sample columns need
+    int firstControlColumn = spansV[firstColumn] - surface.degreeV;
+    int lastControlColumn = spansV[lastColumn];
+
+    //First blends the control point rows in the u direction. This is done once per sample row,
+    //so each sample afterwards only needs degreeV + 1 multiply-adds.
+    const float* nu = &basisU[i * orderU];
+    const glm::vec4* firstRow = &surface.homogeneousPoints[(spansU[i] - surface.degreeU) * width];
+    for (int c = firstControlColumn; c <= lastControlColumn; ++c)
+    {
+        glm::vec4 sum(0.0f);
+        for (int a = 0; a < orderU; ++a)
+            sum += nu[a] * firstRow[a * width + c];
+        scratch[c] = sum;
+    }
+
+    for (int j = firstColumn; j <= lastColumn; ++j)
+    {
+        const float* nv = &basisV[j * orderV];
+        const glm::vec4* blended = &scratch[spansV[j] - surface.degreeV];
+        glm::vec4 point(0.0f);
+        for (int b = 0; b < orderV; ++b)
+            point += nv[b] * blended[b];
+        rowPoints[j] = glm::vec3(point) / point.w;
+    }
+}
+
+void SurfaceTessellator::uploadRegion(StreamBuffer& stream, GLuint vbo, const DirtyRegion& region)
+{
+    if (region.empty())
+        return;
+
+    int columns = region.lastColumn - region.firstColumn + 1;
+    int rows = region.lastRow - region.firstRow + 1;
+    //Wide regions are sent as one block of whole rows. Narrow regions are packed into one write and copied row by row.
+    if (columns * 2 >= samplesV)
+    {
+        GLsizeiptr size = static_cast<GLsizeiptr>(rows) * samplesV * sizeof(glm::vec3);
+        GLintptr source = stream.write(&points[region.firstRow * samplesV], size);
+        glBindBuffer(GL_COPY_READ_BUFFER, stream.getBuffer());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source,
+            static_cast<GLintptr>(region.firstRow) * samplesV * sizeof(glm::vec3), size);
+    }
+    else
+    {
+        packedRegion.resize(static_cast<size_t>(rows) * columns);
+        for (int i = 0; i < rows; ++i)
+            std::copy_n(&points[(region.firstRow + i) * samplesV + region.firstColumn], columns, &packedRegion[i * columns]);
+        GLsizeiptr rowSize = static_cast<GLsizeiptr>(columns) * sizeof(glm::vec3);
+        GLintptr source = stream.write(packedRegion.data(), packedRegion.size() * sizeof(glm::vec3));
+        glBindBuffer(GL_COPY_READ_BUFFER, stream.getBuffer());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        for (int i = 0; i < rows; ++i)
+        {
+            int first = (region.firstRow + i) * samplesV + region.firstColumn;
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source + i * rowSize,
+                static_cast<GLintptr>(first) * sizeof(glm::vec3), rowSize);
+        }
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
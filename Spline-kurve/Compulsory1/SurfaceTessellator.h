@@ -0,0 +1,88 @@
+#ifndef SURFACETESSELLATOR_H
+#define SURFACETESSELLATOR_H
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "BSplineSurface.h"
+#include "ThreadPool.h"
+#include "StreamBuffer.h"
+
+//The part of the sample grid that has changed since the last upload. Rows follow u and columns follow v.
+struct DirtyRegion
+{
+    int firstRow = 0;
+    int lastRow = -1;
+    int firstColumn = 0;
+    int lastColumn = -1;
+
+    bool empty() const { return lastRow < firstRow || lastColumn < firstColumn; }
+};
+
+//Samples a B-spline surface on a uniform samplesU x samplesV grid. The points are stored as
+//points[i * samplesV + j], which is the same layout the wireframe indices in main use.
+//The knot span and the basis functions of every sample row and column are calculated once, so
+//re-evaluating a sample is only a weighted sum of the control points in its span. The sums are done with the
+//homogeneous control points and divided by w at the end, so NURBS surfaces cost the same as polynomial ones.
+//When a control point is moved only the samples inside its local support are re-evaluated and uploaded.
+class SurfaceTessellator
+{
+public:
+    SurfaceTessellator(const BSplineSurface& surface, int samplesU, int samplesV);
+
+    //Evaluates every sample of the grid
+    void tessellate();
+    //Evaluates every sample in blocks of rows on the thread pool and writes them to out (samplesU * samplesV points),
+    //for example a mapped vertex buffer. The samples kept by the tessellator are not changed.
+    void tessellate(ThreadPool& pool, glm::vec3* out) const;
+
+    //Line indices for every row and column of the sample grid
+    std::vector<unsigned int> wireframeIndices() const { return gridLines(samplesU, samplesV); }
+    //Line indices for any rows x columns grid stored row by row
+    static std::vector<unsigned int> gridLines(int rows, int columns);
+
+    //The exact number of indices for the lines and the triangles of a rows x columns grid
+    static size_t lineIndexCount(int rows, int columns);
+    static size_t triangleIndexCount(int rows, int columns);
+    //Writes the indices in blocks of rows on the thread pool. Every row has a fixed place in out, so the
+    //blocks never write to the same memory and out can be a mapped index buffer.
+    static void writeLineIndices(ThreadPool& pool, int rows, int columns, unsigned int* out);
+    static void writeTriangleIndices(ThreadPool& pool, int rows, int columns, unsigned int* out);
+
+    //Re-evaluates the samples that the control point influences and returns which part of the grid changed.
+    //If the grid has not been evaluated yet, all of it is.
+    DirtyRegion updateControlPoint(int index);
+
+    //Writes the changed samples into the stream buffer and copies them from there into the vertex buffer on the GPU,
+    //so the upload does not wait for draws that still read the vertex buffer. The buffer has to hold the whole grid.
+    void uploadRegion(StreamBuffer& stream, GLuint vbo, const DirtyRegion& region);
+
+    //Empty until tessellate() or updateControlPoint() has stored the samples
+    const std::vector<glm::vec3>& getPoints() const { return points; }
+    int getSamplesU() const { return samplesU; }
+    int getSamplesV() const { return samplesV; }
+
+private:
+    void evaluateRegion(const DirtyRegion& region);
+    //Evaluates the columns of one sample row, scratch has room for one blended row of control points
+    void evaluateRow(int i, int firstColumn, int lastColumn, glm::vec4* scratch, glm::vec3* rowPoints) const;
+    static void writeLineRow(int i, int rows, int columns, unsigned int* out);
+
+    const BSplineSurface& surface;
+    int samplesU;
+    int samplesV;
+
+    //Knot span and degree + 1 basis functions for each sample row (u) and sample column (v)
+    std::vector<int> spansU;
+    std::vector<int> spansV;
+    std::vector<float> basisU;
+    std::vector<float> basisV;
+
+    std::vector<glm::vec3> points;
+    //The rows of a narrow region packed next to each other for the stream buffer
+    std::vector<glm::vec3> packedRegion;
+    //Scratch row used when a region is evaluated, holds the u-blended homogeneous control points of one sample row
+    std::vector<glm::vec4> blendedRow;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+//Hands data from one writer thread to one reader thread without locks.
+//There are three slots: the writer fills its own slot, the reader reads its own slot, and the third slot is in the
+//middle. publish swaps the writer slot with the middle slot and marks the middle as new, and update swaps the reader
+//slot with the middle slot if there is something new. Both swaps are one atomic exchange, so the writer never waits
+//for the reader and the reader always gets the newest complete data. Data that the reader was too slow to see is skipped.
+template <typename T>
+class TripleBuffer
+{
+public:
+    //Writer thread: the slot to fill, and making it visible to the reader
+    T& writeBuffer() { return slots[writeIndex]; }
+    void publish()
+    {
+        int old = middle.exchange(writeIndex | NEW_DATA, std::memory_order_acq_rel);
+        writeIndex = old & INDEX_MASK;
+    }
+
+    //Reader thread: takes the newest published slot, returns false if nothing has been published since the last time
+    bool update()
+    {
+        if ((middle.load(std::memory_order_acquire) & NEW_DATA) == 0)
+            return false;
+        int old = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = old & INDEX_MASK;
+        return true;
+    }
+    const T& readBuffer() const { return slots[readIndex]; }
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int NEW_DATA = 4;
+
+    T slots[3];
+    int writeIndex = 0;
+    int readIndex = 1;
+    std::atomic<int> middle{ 2 };
+};
+
+#endif
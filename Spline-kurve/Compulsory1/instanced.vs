@@ -0,0 +1,21 @@
+#version 330 core
+// Draws many copies of one mesh with one instanced draw call. The mesh is shared, and the position, size and
+// colour of each copy come from per-instance attributes.
+layout (location = 0) in vec3 aPos;              // a point of the mesh around the origin, also used as the normal
+layout (location = 2) in vec4 instancePlace;     // the position in xyz and the size in w
+layout (location = 3) in vec4 instanceColor;
+
+out vec3 ourColor;
+layout (std140) uniform Camera  // shared by all programs, updated once per frame
+{
+    mat4 projection;
+    mat4 view;
+};
+
+const vec3 lightDirection = vec3(0.3, 0.2, 0.93);
+
+void main()
+{
+    gl_Position = projection * view * vec4(instancePlace.xyz + instancePlace.w * aPos, 1.0);
+    ourColor = instanceColor.rgb * (0.35 + 0.65 * max(dot(normalize(aPos), lightDirection), 0.0));
+}
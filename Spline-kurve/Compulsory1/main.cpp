@@ -6,9 +6,35 @@
 #include<glm/gtc/matrix_transform.hpp>
 #include<glm/gtc/type_ptr.hpp>
 #include<vector>
+#include<chrono>
+#include<cstring>
+#include<memory>
+#include<random>
 #include "Shader.h"
-#include "ShaderFileLoader.h"
+#include "ShaderManager.h"
+#include "ShaderPermutations.h"
 #include "Camera.h"
+#include "BSplineSurface.h"
+#include "SurfaceTessellator.h"
+#include "AdaptiveTessellator.h"
+#include "SubdivisionTessellator.h"
+#include "ForwardDifferenceTessellator.h"
+#include "BSplineCurve.h"
+#include "ArcLengthTable.h"
+#include "PatchBVH.h"
+#include "SurfaceBalls.h"
+#include "GpuSplineSurface.h"
+#include "MultiPatchSurface.h"
+#include "ThreadPool.h"
+#include "SimulationThread.h"
+#include "BallSnapshots.h"
+#include "InstancedRenderer.h"
+#include "StreamBuffer.h"
+#include "CameraUniforms.h"
+#include "Profiler.h"
+#include "ProfilerOverlay.h"
+#include "Flythrough.h"
+#include "Benchmark.h"
 
 using namespace std;
 
@@ -41,22 +67,102 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-glm::vec3 BSplineSurface(float u, float v, const vector<glm::vec3>& controlPoints, int width);
-
-
-std::string vfs = ShaderLoader::LoadShaderFromFile("vs.vs");
-std::string fs = ShaderLoader::LoadShaderFromFile("fs.fs");
-
-int main()
+glm::vec3 processControlPointInput(GLFWwindow* window);
+bool processSurfaceModeInput(GLFWwindow* window);
+bool keyPressedOnce(GLFWwindow* window, int key);
+void runTessellationBenchmark();
+void runLargeGridBenchmark(int samples);
+
+//The control point that is moved with the arrow keys. TAB selects the next control point. 
+int selectedControlPoint = 0;
+//How fast the selected control point moves, in units per second 
+const float controlPointSpeed = 1.0f;
+
+//M switches between the uniform grid, the adaptive tessellation, the surface evaluated in the vertex shader, 
+//a terrain made of many patches, a NURBS sphere and cylinder, the surface tessellated by subdividing the control net 
+//and a dense grid made with forward differencing. 
+//+ and - changes the tolerance of the adaptive and the subdivision tessellation, which is the largest distance allowed 
+//between the mesh and the surface. [ and ] halves and doubles the resolution of the surface evaluated on the GPU 
+enum SurfaceMode { UNIFORM_GRID, ADAPTIVE_MESH, GPU_EVALUATION, MULTI_PATCH, NURBS_SHAPES, SUBDIVISION_MESH, FORWARD_DIFFERENCE, SURFACE_MODE_COUNT };
+SurfaceMode surfaceMode = UNIFORM_GRID;
+float adaptiveTolerance = 0.01f;
+int gpuSamples = 10;
+//Samples in each direction of the forward differencing grid 
+const int forwardSamples = 128;
+//H switches the height colours of the surfaces on and off. HEIGHT_COLOR is the bit of the vs.vs variant with them 
+enum VertexFeature { HEIGHT_COLOR = 1 };
+bool heightColors = false;
+//The handles of the vs.vs uniforms. Every variant has its own locations, so each variant gets its handles once, 
+//the first time it is drawn 
+struct SurfaceUniforms
+{
+    bool found = false;
+    Uniform<glm::mat4> model;
+    Uniform<glm::vec2> heightRange;
+};
+//F1 shows and hides the profiler overlay (hidden at the start), F2 writes the last frames to profile.csv and profile.json (a Chrome trace) 
+bool showProfiler = false;
+//Threads in the pool of the ball simulation, the simulation thread included. 0 gives it every core other than the 
+//render thread. --ball-threads n sets it 
+int ballThreads = 0;
+//How fast the point on the curve moves, in units per second. The arc length table makes the speed the same 
+//on the whole curve, even where the control points are close together 
+const float pathSpeed = 1.5f;
+//B drops this many balls on the surface. They roll on the exact B-spline surface, without a mesh 
+const int surfaceBallCount = 2000;
+//The radius of the sphere markers and the side of the control point cubes 
+const float markerSize = 0.05f;
+const float controlPointSize = 0.08f;
+
+int main(int argc, char* argv[])
 {
-    std::cout << "vfs " << vfs.c_str() << std::endl;
-    std::cout << "fs " << fs.c_str() << std::endl;
+    //--benchmark-flythrough [frames] [keyframe file] draws the scene in a hidden window with the camera on a fixed 
+    //path, and writes the frame times to benchmark.json. Without a keyframe file the camera circles the surface 
+    int benchmarkFrames = 0;
+    std::string flythroughFile;
+    //--benchmark-tessellation compares the tessellation methods without opening a window 
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--benchmark-flythrough") == 0)
+        {
+            benchmarkFrames = 600;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+                benchmarkFrames = atoi(argv[++i]);
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                flythroughFile = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--ball-threads") == 0 && i + 1 < argc)
+        {
+            ballThreads = std::max(atoi(argv[++i]), 0);
+            continue;
+        }
+        if (strcmp(argv[i], "--benchmark-tessellation") == 0)
+        {
+            runTessellationBenchmark();
+            return 0;
+        }
+        //--benchmark-large-grid [samples] tessellates a 1000 x 1000 control grid on all cores, 8192 x 8192 samples by default 
+        if (strcmp(argv[i], "--benchmark-large-grid") == 0)
+        {
+            runLargeGridBenchmark(i + 1 < argc ? atoi(argv[i + 1]) : 8192);
+            return 0;
+        }
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
+    //glfwTerminate runs when main returns, after the objects made below have deleted their buffers, queries and 
+    //programs while the context still exists. Objects are destroyed in the opposite order they were made, so this 
+    //one, made first, goes last 
+    struct GlfwTerminator { ~GlfwTerminator() { glfwTerminate(); } } glfwTerminator;
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    //The benchmark draws into a framebuffer of its own, so the window is never shown 
+    if (benchmarkFrames > 0)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 
     // glfw window creation
@@ -83,42 +189,39 @@ int main()
 
     // build and compile our shader program
     // ------------------------------------
-    Shader ourShader("vs.vs", "fs.fs"); // you can name your shader files however you like
+    //The shader manager reads every file once and keeps the linked programs in shaders.cache, so the next start 
+    //does not have to compile them again 
+    ShaderManager shaders;
+    //vs.vs with and without the height colours. Both are started now, and a driver that compiles in parallel can 
+    //finish them while the meshes are built 
+    ShaderPermutations surfaceShaders(shaders, "vs.vs", "fs.fs", { "HEIGHT_COLOR" });
+    surfaceShaders.prepare(0);
+    surfaceShaders.prepare(HEIGHT_COLOR);
+    vector<SurfaceUniforms> surfaceUniforms(surfaceShaders.variantCount());
+    //Evaluates the B-spline surface in the vertex shader 
+    Shader& splineShader = shaders.get("spline.vs", "fs.fs");
+    //The projection and view matrices go to all the shaders through one uniform buffer, and the model matrices 
+    //are set through handles 
+    CameraUniforms cameraUniforms;
+    Uniform<glm::mat4> splineModel = splineShader.uniform<glm::mat4>("model");
 
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
 
+    //Biquadratic B-spline surface over all the control points. 
+    //The width of 4 is telling how many control points there are in each row 
+    BSplineSurface surface(controlPoints, 4, 2, 2);
+
     //Generating surface points for the B-spline surface 
-    vector<glm::vec3> surfacePoints;
     //The number of points on the surface in each direction. Here 100 points will be calculated 
     int pointsOnTheSurface = 10; 
-    for (int i = 0; i < pointsOnTheSurface; ++i) 
-    {
-        for (int j = 0; j < pointsOnTheSurface; ++j) 
-        {
-            //Normalizes u and v to be in a range of 0 to 1
-            float u = i / static_cast<float>(pointsOnTheSurface - 1);
-            float v = j / static_cast<float>(pointsOnTheSurface - 1);
-            //The width of 4 is telling how many control points there are in each row 
-            surfacePoints.push_back(BSplineSurface(u, v, controlPoints, 4));
-        }
-    }
+    SurfaceTessellator tessellator(surface, pointsOnTheSurface, pointsOnTheSurface);
+    tessellator.tessellate();
+    const vector<glm::vec3>& surfacePoints = tessellator.getPoints();
 
-   //Generates wireframe for the B-spline surface
-   //Connects the surface points in a grid with lines 
-    vector<unsigned int> indices;
-    for (int i = 0; i < pointsOnTheSurface - 1; ++i) 
-    {
-        for (int j = 0; j < pointsOnTheSurface - 1; ++j) 
-        {
-            //Connects a point (i,j) to a point directly under it at (i+1,j)
-            indices.push_back(i * pointsOnTheSurface + j);
-            indices.push_back((i + 1) * pointsOnTheSurface + j);
-            //Connects a point (i,j) to a point directly to its right at (i,j+1)
-            indices.push_back(i * pointsOnTheSurface + j);
-            indices.push_back(i * pointsOnTheSurface + (j + 1));
-        }
-    }
+   //The wireframe for the B-spline surface connects every surface point to the point to its right and the point under it.
+   //The number of indices is known before they are made, so they are written straight into the mapped index buffer 
+    size_t wireframeIndexCount = SurfaceTessellator::lineIndexCount(pointsOnTheSurface, pointsOnTheSurface);
 
     //For the wireframe 
     unsigned int VBO, VAO, EBO;
@@ -128,84 +231,540 @@ int main()
 
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, surfacePoints.size() * sizeof(glm::vec3), &surfacePoints[0], GL_STATIC_DRAW);
+    //The surface points change when a control point is moved. SurfaceTessellator::uploadRegion then writes the changed 
+    //rows through the stream buffer and copies them into this buffer with glCopyBufferSubData 
+    glBufferData(GL_ARRAY_BUFFER, surfacePoints.size() * sizeof(glm::vec3), &surfacePoints[0], GL_DYNAMIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, wireframeIndexCount * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    void* mappedIndices = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, wireframeIndexCount * sizeof(unsigned int),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    bool indicesWritten = false;
+    if (mappedIndices != nullptr)
+    {
+        SurfaceTessellator::writeLineIndices(ThreadPool::shared(), pointsOnTheSurface, pointsOnTheSurface, static_cast<unsigned int*>(mappedIndices));
+        indicesWritten = glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) == GL_TRUE;
+    }
+    //If the buffer could not be mapped, or its memory was lost while it was mapped, the indices are uploaded from memory 
+    if (!indicesWritten)
+    {
+        vector<unsigned int> wireframeIndices(wireframeIndexCount);
+        SurfaceTessellator::writeLineIndices(ThreadPool::shared(), pointsOnTheSurface, pointsOnTheSurface, wireframeIndices.data());
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, wireframeIndexCount * sizeof(unsigned int), wireframeIndices.data());
+    }
 
-    //Points on the surface
-    unsigned int surfaceVBO, surfaceVAO;
+    //Points on the surface. They use the same vertex buffer as the wireframe, so the points only have to be uploaded once 
+    unsigned int surfaceVAO;
     glGenVertexArrays(1, &surfaceVAO);
-    glGenBuffers(1, &surfaceVBO);
 
     glBindVertexArray(surfaceVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, surfaceVBO);
-    glBufferData(GL_ARRAY_BUFFER, surfacePoints.size() * sizeof(glm::vec3), &surfacePoints[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
-    //For the contol points 
-    unsigned int controlVBO, controlVAO;
-    glGenVertexArrays(1, &controlVAO);
-    glGenBuffers(1, &controlVBO);
+    //For the adaptive tessellation. The mesh is built again when the tolerance or a control point changes 
+    AdaptiveTessellator adaptiveTessellator(surface);
+    unsigned int adaptiveVBO, adaptiveVAO, adaptiveEBO;
+    glGenVertexArrays(1, &adaptiveVAO);
+    glGenBuffers(1, &adaptiveVBO);
+    glGenBuffers(1, &adaptiveEBO);
 
-    glBindVertexArray(controlVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, controlVBO);
-    glBufferData(GL_ARRAY_BUFFER, controlPoints.size() * sizeof(glm::vec3), &controlPoints[0], GL_STATIC_DRAW);
+    glBindVertexArray(adaptiveVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, adaptiveVBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, adaptiveEBO);
+
+    size_t adaptiveLineIndices = 0;
+    size_t adaptiveVertices = 0;
+    auto buildAdaptiveMesh = [&]()
+    {
+        adaptiveTessellator.tessellate(adaptiveTolerance);
+        const vector<glm::vec3>& vertices = adaptiveTessellator.getVertices();
+        vector<unsigned int> lines = adaptiveTessellator.getLines();
+        adaptiveVertices = vertices.size();
+        adaptiveLineIndices = lines.size();
+
+        glBindVertexArray(adaptiveVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, adaptiveVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_DYNAMIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, lines.size() * sizeof(unsigned int), lines.data(), GL_DYNAMIC_DRAW);
+        glBindVertexArray(0);
+        std::cout << "Adaptive tessellation: tolerance " << adaptiveTolerance << ", " << adaptiveVertices
+            << " vertices, " << adaptiveTessellator.getTriangles().size() / 3 << " triangles" << std::endl;
+    };
+    buildAdaptiveMesh();
+
+    //For the subdivision tessellation. The control net is refined until it is within the tolerance 
+    unsigned int subdivisionVBO, subdivisionVAO, subdivisionEBO;
+    glGenVertexArrays(1, &subdivisionVAO);
+    glGenBuffers(1, &subdivisionVBO);
+    glGenBuffers(1, &subdivisionEBO);
+
+    glBindVertexArray(subdivisionVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, subdivisionVBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, subdivisionEBO);
+    glBindVertexArray(0);
+
+    size_t subdivisionLineIndices = 0;
+    auto buildSubdivisionMesh = [&]()
+    {
+        //The Bezier form is made from the current control points, so a new tessellator is needed after a move 
+        SubdivisionTessellator subdivision(surface);
+        int level = subdivision.tessellate(adaptiveTolerance);
+        const vector<glm::vec3>& vertices = subdivision.getPoints();
+        vector<unsigned int> lines = subdivision.wireframeIndices();
+        subdivisionLineIndices = lines.size();
+
+        glBindVertexArray(subdivisionVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, subdivisionVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_DYNAMIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, lines.size() * sizeof(unsigned int), lines.data(), GL_DYNAMIC_DRAW);
+        glBindVertexArray(0);
+        std::cout << "Subdivision tessellation: tolerance " << adaptiveTolerance << ", level " << level << ", "
+            << subdivision.getRows() << " x " << subdivision.getColumns() << " samples" << std::endl;
+    };
+
+    //For the forward differencing. The rows are written straight into the mapped vertex buffer every time a 
+    //control point moves, so the buffer only gets its size here 
+    ForwardDifferenceTessellator forwardTessellator(surface, forwardSamples, forwardSamples);
+    vector<unsigned int> forwardIndices = SurfaceTessellator::gridLines(forwardSamples, forwardSamples);
+    unsigned int forwardVBO, forwardVAO, forwardEBO;
+    glGenVertexArrays(1, &forwardVAO);
+    glGenBuffers(1, &forwardVBO);
+    glGenBuffers(1, &forwardEBO);
+
+    glBindVertexArray(forwardVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, forwardVBO);
+    glBufferData(GL_ARRAY_BUFFER, forwardSamples * forwardSamples * sizeof(glm::vec3), NULL, GL_STREAM_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, forwardEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, forwardIndices.size() * sizeof(unsigned int), forwardIndices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    forwardTessellator.tessellateInto(forwardVBO);
+
+    //The control net and the knots in texture buffers for the GPU evaluation 
+    GpuSplineSurface gpuSurface(surface);
+
+    //A terrain made of 61 x 61 bicubic patches that share one 64 x 64 control lattice. All patches are 
+    //tessellated in parallel into one vertex and index buffer and drawn with one draw call 
+    MultiPatchSurface terrain = MultiPatchSurface::createGrid(64, 64, 0.1f, [](float x, float y)
+    {
+        return 0.5f * sin(x * 1.5f) * cos(y * 1.2f);
+    });
+    vector<glm::vec3> terrainVertices;
+    vector<unsigned int> terrainIndices;
+    terrain.tessellate(ThreadPool::shared(), 8, terrainVertices, terrainIndices);
+    std::cout << "Multi-patch terrain: " << terrain.patchCount() << " patches, " << terrainVertices.size() << " vertices" << std::endl;
+
+    unsigned int terrainVBO, terrainVAO, terrainEBO;
+    glGenVertexArrays(1, &terrainVAO);
+    glGenBuffers(1, &terrainVBO);
+    glGenBuffers(1, &terrainEBO);
+
+    glBindVertexArray(terrainVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, terrainVBO);
+    glBufferData(GL_ARRAY_BUFFER, terrainVertices.size() * sizeof(glm::vec3), terrainVertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, terrainIndices.size() * sizeof(unsigned int), terrainIndices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    //Exact NURBS shapes made by revolving a profile around the z axis. Both are sampled with the same 
+    //tessellator as the main surface and put in one vertex and index buffer 
+    BSplineSurface sphere = BSplineSurface::sphere(0.75f);
+    BSplineSurface cylinder = BSplineSurface::cylinder(0.5f, 1.5f);
+    vector<glm::vec3> shapeVertices;
+    vector<unsigned int> shapeIndices;
+    size_t sphereIndexCount = 0;
+    for (const BSplineSurface* shape : { &sphere, &cylinder })
+    {
+        SurfaceTessellator shapeTessellator(*shape, 24, 24);
+        shapeTessellator.tessellate();
+        unsigned int firstVertex = static_cast<unsigned int>(shapeVertices.size());
+        for (unsigned int index : shapeTessellator.wireframeIndices())
+            shapeIndices.push_back(firstVertex + index);
+        shapeVertices.insert(shapeVertices.end(), shapeTessellator.getPoints().begin(), shapeTessellator.getPoints().end());
+        if (shape == &sphere)
+            sphereIndexCount = shapeIndices.size();
+    }
 
+    unsigned int shapeVBO, shapeVAO, shapeEBO;
+    glGenVertexArrays(1, &shapeVAO);
+    glGenBuffers(1, &shapeVBO);
+    glGenBuffers(1, &shapeEBO);
+
+    glBindVertexArray(shapeVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, shapeVBO);
+    glBufferData(GL_ARRAY_BUFFER, shapeVertices.size() * sizeof(glm::vec3), shapeVertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shapeEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, shapeIndices.size() * sizeof(unsigned int), shapeIndices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    //A cubic B-spline curve over the surface. It is drawn with points that have the same distance between them, 
+    //and a point moves along it with constant speed 
+    BSplineCurve path({ glm::vec3(-0.5f, -0.5f, 1.0f), glm::vec3(1.0f, -0.2f, 2.5f), glm::vec3(1.2f, 0.5f, 2.6f),
+        glm::vec3(3.5f, 0.3f, 1.0f), glm::vec3(3.0f, 2.5f, 1.5f), glm::vec3(1.5f, 2.2f, 3.0f), glm::vec3(-0.5f, 2.5f, 1.0f) }, 3);
+    ArcLengthTable pathLengths(path);
+    vector<glm::vec3> pathPoints(200);
+    pathLengths.uniformSamples(pathPoints.size(), pathPoints.data());
+    std::cout << "Curve: length " << pathLengths.totalLength() << ", " << pathLengths.size() << " arc length table entries" << std::endl;
+
+    //The curve points, the moving point is drawn as a marker 
+    unsigned int pathVBO, pathVAO;
+    glGenVertexArrays(1, &pathVAO);
+    glGenBuffers(1, &pathVBO);
+
+    glBindVertexArray(pathVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, pathVBO);
+    glBufferData(GL_ARRAY_BUFFER, pathPoints.size() * sizeof(glm::vec3), pathPoints.data(), GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    //The patches of the surface in a bounding volume hierarchy. Every frame a ray from the camera picks a point on 
+    //the surface, and the point on the surface closest to the moving point on the curve is found. 
+    //The tree is built again when a control point moves 
+    PatchBVH surfaceBVH(surface);
+
+    //Balls that roll on the surface. The positions are copied into a vertex buffer and drawn as points. 
+    //The balls are moved on their own thread with fixed time steps and roll on their own copy of the surface, so moving a 
+    //control point here never changes the surface in the middle of a step. The moves and new balls are posted to the 
+    //simulation thread, and the render loop draws the published positions one step behind, blended between two steps 
+    BSplineSurface ballSurface = surface;
+    SurfaceBalls surfaceBalls(ballSurface, 0.05f, glm::vec3(0.0f, 0.0f, -9.81f));
+    BallSnapshots ballSnapshots;
+    vector<float> ballX, ballY, ballZ;
+    //The simulation has its own pool. The shared pool runs one loop at a time, so tessellating on the render thread 
+    //would otherwise wait for a whole step 
+    unsigned int spareCores = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    ThreadPool simulationPool(ballThreads > 0 ? static_cast<unsigned int>(ballThreads) : spareCores);
+    SimulationThread simulation(surfaceBalls.timeStep, [&](double time)
+        {
+            surfaceBalls.step(simulationPool);
+            ballSnapshots.publish(surfaceBalls.positionX, surfaceBalls.positionY, surfaceBalls.positionZ, time);
+        });
+    //The benchmark steps the simulation itself, with its own clock 
+    if (benchmarkFrames == 0)
+        simulation.start();
+    //Replaces the balls with new ones at random places a little above the surface. The seed picks the places 
+    auto dropSurfaceBalls = [&](unsigned int seed)
+        {
+            std::mt19937 random(seed);
+            std::uniform_real_distribution<float> parameter(0.05f, 0.95f);
+            vector<glm::vec3> drops(surfaceBallCount);
+            for (glm::vec3& drop : drops)
+                drop = surface.evaluate(parameter(random), parameter(random)) + glm::vec3(0.0f, 0.0f, 0.5f);
+            simulation.post([&surfaceBalls, drops]()
+                {
+                    surfaceBalls.clear();
+                    for (const glm::vec3& drop : drops)
+                        surfaceBalls.addBall(drop);
+                });
+        };
+
+    //The balls, the markers and the control points are drawn as instances of a sphere and a cube, 
+    //one instanced draw call for each mesh 
+    vector<glm::vec3> glyphVertices;
+    vector<unsigned int> glyphIndices;
+    InstancedRenderer::sphere(8, 12, glyphVertices, glyphIndices);
+    InstancedRenderer sphereRenderer(glyphVertices, glyphIndices);
+    InstancedRenderer::cube(glyphVertices, glyphIndices);
+    InstancedRenderer cubeRenderer(glyphVertices, glyphIndices);
+    Shader& instancedShader = shaders.get("instanced.vs", "fs.fs");
+
+    //Everything that changes every frame (the instances, the query line and the edited samples) is written into 
+    //a ring of three segments, so the uploads never wait for the GPU or make the driver allocate new memory 
+    StreamBuffer streamBuffer(1 << 20);
+    //The window title shows how many bytes were streamed in the last frame, updated once a second 
+    float lastTitleUpdate = 0.0f;
+
+    //The line from the point on the curve to its closest point on the surface, its vertices are in the stream buffer 
+    unsigned int queryVAO;
+    glGenVertexArrays(1, &queryVAO);
+    glBindVertexArray(queryVAO);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    //Measures the parts of every frame on the CPU and on the GPU 
+    //The benchmark keeps a sample of every frame, so the scopes in its report cover the whole run 
+    Profiler profiler(std::max(benchmarkFrames, 240));
+    ProfilerOverlay profilerOverlay;
+    Shader& overlayShader = shaders.get("overlay.vs", "fs.fs");
+
+    //In the benchmark the frames are not waiting for the screen, and the overlay is not drawn so it is not measured 
+    std::unique_ptr<Benchmark> benchmark;
+    if (benchmarkFrames > 0)
+    {
+        Flythrough flythrough = Flythrough::orbit(glm::vec3(1.5f, 1.0f, 0.5f), 4.0f, 3.0f);
+        if (!flythroughFile.empty() && !flythrough.load(flythroughFile))
+            std::cout << "Could not read the keyframes in " << flythroughFile << ", the camera circles the surface" << std::endl;
+        benchmark.reset(new Benchmark(flythrough, benchmarkFrames));
+        benchmark->createTarget(SCR_WIDTH, SCR_HEIGHT);
+        glfwSwapInterval(0);
+        showProfiler = false;
+        //The same balls are dropped in every run, so the steps in the report include the ball physics 
+        dropSurfaceBalls(1);
+    }
 
     while (!glfwWindowShouldClose(window))
     {
         // Time calculation for movement
         float currentFrame = static_cast<float>(glfwGetTime());
+        //The benchmark moves the camera itself and counts time in whole frames. The balls are stepped here up to 
+        //that time instead of on their thread, so every run draws the same 
+        double simulationTime = simulation.now();
+        if (benchmark)
+        {
+            if (!benchmark->nextFrame(camera, profiler))
+                break;
+            currentFrame = benchmark->time();
+            simulation.runUntil(currentFrame);
+            simulationTime = currentFrame;
+        }
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        profiler.beginFrame();
+        streamBuffer.beginFrame();
+        if (currentFrame - lastTitleUpdate >= 1.0f)
+        {
+            std::string title = "Spline-kurver - " + std::to_string(streamBuffer.bytesLastFrame() / 1024) + " KB streamed per frame";
+            glfwSetWindowTitle(window, title.c_str());
+            lastTitleUpdate = currentFrame;
+        }
 
+        profiler.beginCpu("update");
         processInput(window);
+        if (keyPressedOnce(window, GLFW_KEY_F1))
+            showProfiler = !showProfiler;
+        if (keyPressedOnce(window, GLFW_KEY_F2) && profiler.writeCsv("profile.csv") && profiler.writeChromeTrace("profile.json"))
+            std::cout << "The profile is written to profile.csv and profile.json" << std::endl;
+        //F3 adds the camera to flythrough.txt, a path for --benchmark-flythrough 
+        if (keyPressedOnce(window, GLFW_KEY_F3) && Flythrough::appendKeyframe("flythrough.txt", camera))
+            std::cout << "Keyframe added to flythrough.txt" << std::endl;
+
+        //Moves the selected control point. Only the samples inside the knot spans of the control point 
+        //are evaluated again, and only those parts of the vertex buffer are updated 
+        glm::vec3 movement = processControlPointInput(window);
+        if (movement != glm::vec3(0.0f))
+        {
+            glm::vec3 moved = surface.controlPoints[selectedControlPoint] + movement;
+            surface.setControlPoint(selectedControlPoint, moved);
+            int movedPoint = selectedControlPoint;
+            simulation.post([&ballSurface, movedPoint, moved]() { ballSurface.setControlPoint(movedPoint, moved); });
+            controlPoints[selectedControlPoint] = moved;
+            tessellator.uploadRegion(streamBuffer, VBO, tessellator.updateControlPoint(selectedControlPoint));
+
+            gpuSurface.updateControlPoint(selectedControlPoint);
+            forwardTessellator.tessellateInto(forwardVBO);
+            surfaceBVH = PatchBVH(surface);
+            if (surfaceMode == ADAPTIVE_MESH)
+                buildAdaptiveMesh();
+            else if (surfaceMode == SUBDIVISION_MESH)
+                buildSubdivisionMesh();
+        }
+
+        //B drops new balls at random places a little above the surface 
+        if (keyPressedOnce(window, GLFW_KEY_B))
+            dropSurfaceBalls(static_cast<unsigned int>(currentFrame * 1000.0f));
 
+        if (processSurfaceModeInput(window))
+        {
+            if (surfaceMode == ADAPTIVE_MESH)
+                buildAdaptiveMesh();
+            else if (surfaceMode == SUBDIVISION_MESH)
+                buildSubdivisionMesh();
+        }
+        profiler.endCpu();
+
+        profiler.beginCpu("surface");
+        profiler.beginGpu("surface");
         glClearColor(0.529f, 0.808f, 0.922f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        //The variant of vs.vs for the colour mode 
+        unsigned int surfaceFeatures = heightColors ? HEIGHT_COLOR : 0;
+        Shader& ourShader = surfaceShaders.get(surfaceFeatures);
+        SurfaceUniforms& ourUniforms = surfaceUniforms.at(surfaceFeatures);
+        if (!ourUniforms.found)
+        {
+            ourUniforms.model = ourShader.uniform<glm::mat4>("model");
+            ourUniforms.heightRange = ourShader.uniform<glm::vec2>("heightRange");
+            ourUniforms.found = true;
+        }
+        Uniform<glm::mat4> ourModel = ourUniforms.model;
         ourShader.use();
 
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        cameraUniforms.update(projection, view);
 
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
+        ourShader.set(ourModel, model);
+        if (heightColors)
+        {
+            float lowest = controlPoints[0].z;
+            float highest = controlPoints[0].z;
+            for (const glm::vec3& point : controlPoints)
+            {
+                lowest = std::min(lowest, point.z);
+                highest = std::max(highest, point.z);
+            }
+            ourShader.set(ourUniforms.heightRange, glm::vec2(lowest, std::max(highest, lowest + 0.001f)));
+        }
 
-        //Render wireframe
-        glBindVertexArray(VAO);
-        glDrawElements(GL_LINES, indices.size(), GL_UNSIGNED_INT, 0);
+        if (surfaceMode == ADAPTIVE_MESH)
+        {
+            //Render the adaptive mesh as a wireframe 
+            glBindVertexArray(adaptiveVAO);
+            glDrawElements(GL_LINES, static_cast<GLsizei>(adaptiveLineIndices), GL_UNSIGNED_INT, 0);
+            glPointSize(3.0f);
+            glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(adaptiveVertices));
+            glBindVertexArray(0);
+        }
+        else if (surfaceMode == UNIFORM_GRID)
+        {
+            //Render wireframe
+            glBindVertexArray(VAO);
+            glDrawElements(GL_LINES, wireframeIndexCount, GL_UNSIGNED_INT, 0);
+            glBindVertexArray(0);
+
+            // Render surface points
+            glBindVertexArray(surfaceVAO);
+            glPointSize(6.0f);
+            glDrawArrays(GL_POINTS, 0, surfacePoints.size());
+            glBindVertexArray(0);
+        }
+        else if (surfaceMode == GPU_EVALUATION)
+        {
+            splineShader.use();
+            splineShader.set(splineModel, model);
+            gpuSurface.draw(splineShader, gpuSamples, gpuSamples);
+            ourShader.use();
+        }
+        else if (surfaceMode == MULTI_PATCH)
+        {
+            //The triangles are drawn as lines, the same way as the other wireframes 
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            glBindVertexArray(terrainVAO);
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(terrainIndices.size()), GL_UNSIGNED_INT, 0);
+            glBindVertexArray(0);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        }
+        else if (surfaceMode == SUBDIVISION_MESH)
+        {
+            glBindVertexArray(subdivisionVAO);
+            glDrawElements(GL_LINES, static_cast<GLsizei>(subdivisionLineIndices), GL_UNSIGNED_INT, 0);
+            glBindVertexArray(0);
+        }
+        else if (surfaceMode == FORWARD_DIFFERENCE)
+        {
+            glBindVertexArray(forwardVAO);
+            glDrawElements(GL_LINES, static_cast<GLsizei>(forwardIndices.size()), GL_UNSIGNED_INT, 0);
+            glBindVertexArray(0);
+        }
+        else if (surfaceMode == NURBS_SHAPES)
+        {
+            //The sphere to the left and the cylinder to the right of the control points 
+            glBindVertexArray(shapeVAO);
+            ourShader.set(ourModel, glm::translate(glm::mat4(1.0f), glm::vec3(-1.0f, 1.0f, 0.0f)));
+            glDrawElements(GL_LINES, static_cast<GLsizei>(sphereIndexCount), GL_UNSIGNED_INT, 0);
+            ourShader.set(ourModel, glm::translate(glm::mat4(1.0f), glm::vec3(4.0f, 1.0f, 0.0f)));
+            glDrawElements(GL_LINES, static_cast<GLsizei>(shapeIndices.size() - sphereIndexCount), GL_UNSIGNED_INT,
+                (void*)(sphereIndexCount * sizeof(unsigned int)));
+            glBindVertexArray(0);
+            ourShader.set(ourModel, model);
+        }
+        profiler.endGpu();
+        profiler.endCpu();
+
+        //Render the curve and the point that moves along it 
+        profiler.beginCpu("curve");
+        profiler.beginGpu("curve");
+        float distance = fmod(currentFrame * pathSpeed, pathLengths.totalLength());
+        glm::vec3 pathPosition = path.evaluate(pathLengths.parameterAtLength(distance));
+        glBindVertexArray(pathVAO);
+        glVertexAttrib3f(1, 0.0f, 0.0f, 1.0f);
+        glDrawArrays(GL_LINE_STRIP, 0, static_cast<GLsizei>(pathPoints.size()));
+        glVertexAttrib3f(1, 0.0f, 0.0f, 0.0f);
         glBindVertexArray(0);
 
-        // Render surface points
-        glBindVertexArray(surfaceVAO);
-        glPointSize(6.0f);
-        glDrawArrays(GL_POINTS, 0, surfacePoints.size());
+        //Picking with a ray through the middle of the screen, and the closest point to the point on the curve 
+        SurfaceHit picked;
+        bool pickedSurface = surfaceBVH.intersect(camera.Position, camera.Front, picked);
+        SurfaceHit closest = surfaceBVH.closestPoint(pathPosition);
+        glm::vec3 queryLine[2] = { pathPosition, closest.point };
+        GLintptr queryOffset = streamBuffer.write(queryLine, sizeof(queryLine));
+        glBindVertexArray(queryVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, streamBuffer.getBuffer());
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)queryOffset);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glVertexAttrib3f(1, 0.0f, 0.6f, 0.0f);
+        glDrawArrays(GL_LINES, 0, 2);
+        glVertexAttrib3f(1, 0.0f, 0.0f, 0.0f);
         glBindVertexArray(0);
+        profiler.endGpu();
+        profiler.endCpu();
+
+        //The markers: the picked point in green and the point on the curve in blue 
+        profiler.beginCpu("glyphs");
+        profiler.beginGpu("glyphs");
+        sphereRenderer.instances.clear();
+        if (pickedSurface)
+            sphereRenderer.add(picked.point, markerSize, glm::vec3(0.0f, 0.6f, 0.0f));
+        sphereRenderer.add(pathPosition, markerSize, glm::vec3(0.0f, 0.0f, 1.0f));
+
+        //The balls on the surface in orange 
+        size_t drawnBalls = ballSnapshots.interpolate(simulationTime, simulation.getTimeStep(), ballX, ballY, ballZ);
+        for (size_t i = 0; i < drawnBalls; ++i)
+            sphereRenderer.add(glm::vec3(ballX[i], ballY[i], ballZ[i]), surfaceBalls.radius, glm::vec3(1.0f, 0.5f, 0.0f));
+
+        //The control points as cubes, the selected one in red 
+        cubeRenderer.instances.clear();
+        for (size_t i = 0; i < controlPoints.size(); ++i)
+        {
+            glm::vec3 color = static_cast<int>(i) == selectedControlPoint ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f);
+            cubeRenderer.add(controlPoints[i], controlPointSize, color);
+        }
 
-        // Render control points
-        glBindVertexArray(controlVAO);
-        glPointSize(10.0f);
-        glDrawArrays(GL_POINTS, 0, controlPoints.size());
-        glBindVertexArray(0);
+        instancedShader.use();
+        sphereRenderer.draw(streamBuffer);
+        cubeRenderer.draw(streamBuffer);
+        profiler.endGpu();
+        profiler.endCpu();
 
+        if (showProfiler)
+        {
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            profiler.beginCpu("overlay");
+            profilerOverlay.draw(profiler, overlayShader, streamBuffer, width, height);
+            profiler.endCpu();
+        }
+
+        streamBuffer.endFrame();
+        profiler.endFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
+    simulation.stop();
+    if (benchmark && benchmark->writeReport("benchmark.json", "Spline-kurve", profiler))
+        std::cout << "The benchmark is written to benchmark.json" << std::endl;
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
-    glfwTerminate();
+    //Done by glfwTerminator, after the destructors of the render loop objects 
     return 0;
 }
 
@@ -261,35 +820,189 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
-//Calculates the points on a biquadratic B-spline surface. 
-glm::vec3 BSplineSurface(float u, float v, const vector<glm::vec3>& controlPoints, int width)
+//Selects and moves the control points. TAB selects the next control point, the arrow keys move it in the 
+//x and y direction and PAGE UP/PAGE DOWN moves it in the z direction. Returns how far the point should move this frame 
+glm::vec3 processControlPointInput(GLFWwindow* window)
 {
-    //u and v are parameters between 0 and 1. u is horisontal direction and v i vertical direction. 
-    //The control points defines the shape of the surface. 
-    //witdh it hod many control points there are in the horisontal direction 
-    //(1.0f - u) * (1.0f - u) is the first basis function for quadratic B-spline.
-    // 2 * u * (1.0f - u) is the second basis function for quadratic B-spline.
-    //u * u is the third basis function for quadratic B-spline.
-    float n_u[3] = { (1.0f - u) * (1.0f - u), 2 * u * (1.0f - u), u * u };
-    float n_v[3] = { (1.0f - v) * (1.0f - v), 2 * v * (1.0f - v), v * v };
-
-    //The function only takes the grid of 3x3 of control points. So it is only accessing the 3 first points in both the horisontal and vertical 
-    //direction. If the function takes a grid of 4x3 we need to switch it to a cubic B-spline. 
-    //The nedted loop iterates in the vertical and horisontal direction 
-    //is the 3D position of the control point. 
-    glm::vec3 point(0.0f);
-    for (int i = 0; i < 3; ++i) {
-        for (int j = 0; j < 3; ++j) {
-            point += n_u[i] * n_v[j] * controlPoints[i * width + j];
-        }
-    }
-    return point;
+    if (keyPressedOnce(window, GLFW_KEY_TAB))
+        selectedControlPoint = (selectedControlPoint + 1) % static_cast<int>(controlPoints.size());
+
+    glm::vec3 direction(0.0f);
+    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+        direction.x += 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+        direction.x -= 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+        direction.y += 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+        direction.y -= 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_PAGE_UP) == GLFW_PRESS)
+        direction.z += 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS)
+        direction.z -= 1.0f;
+
+    return direction * controlPointSpeed * deltaTime;
 }
 
+//Switches between the surface modes and changes the tolerance and the resolution. Returns true when the adaptive mesh 
+//has to be built again 
+bool processSurfaceModeInput(GLFWwindow* window)
+{
+    bool rebuild = false;
+    if (keyPressedOnce(window, GLFW_KEY_H))
+        heightColors = !heightColors;
+    if (keyPressedOnce(window, GLFW_KEY_M))
+    {
+        surfaceMode = static_cast<SurfaceMode>((surfaceMode + 1) % SURFACE_MODE_COUNT);
+        rebuild = surfaceMode == ADAPTIVE_MESH || surfaceMode == SUBDIVISION_MESH;
+    }
+    //Both keys of a pair are read every frame, so the state of the second key is kept up to date even when the 
+    //first one was pressed 
+    bool plus = keyPressedOnce(window, GLFW_KEY_EQUAL);
+    bool keypadPlus = keyPressedOnce(window, GLFW_KEY_KP_ADD);
+    bool minus = keyPressedOnce(window, GLFW_KEY_MINUS);
+    bool keypadMinus = keyPressedOnce(window, GLFW_KEY_KP_SUBTRACT);
+    if (plus || keypadPlus)
+    {
+        adaptiveTolerance *= 0.5f;
+        rebuild = true;
+    }
+    if (minus || keypadMinus)
+    {
+        adaptiveTolerance *= 2.0f;
+        rebuild = true;
+    }
+    //The GPU surface has no vertex data, so the resolution is only limited by the draw call 
+    if (keyPressedOnce(window, GLFW_KEY_RIGHT_BRACKET) && gpuSamples < 4096)
+        gpuSamples *= 2;
+    if (keyPressedOnce(window, GLFW_KEY_LEFT_BRACKET) && gpuSamples > 2)
+        gpuSamples /= 2;
+    return rebuild;
+}
 
+//Returns true only in the frame the key goes down, not every frame it is held 
+bool keyPressedOnce(GLFWwindow* window, int key)
+{
+    static bool wasPressed[GLFW_KEY_LAST + 1] = {};
+    bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+    bool once = pressed && !wasPressed[key];
+    wasPressed[key] = pressed;
+    return once;
+}
 
+//Times the different ways of making a dense uniform grid of samples on the same surface: 
+//the direct loop that evaluates every sample (the way main used to do it), the tessellator with the cached basis 
+//functions, the subdivision of the Bezier control net and forward differencing. The number of samples is the same for all 
+void runTessellationBenchmark()
+{
+    //A bicubic surface with 16 x 16 control points and some height variation 
+    vector<glm::vec3> points;
+    for (int r = 0; r < 16; ++r)
+        for (int c = 0; c < 16; ++c)
+            points.push_back(glm::vec3(c, r, sin(c * 0.7f) * cos(r * 0.5f)));
+
+    struct BenchmarkSurface { const char* name; BSplineSurface surface; };
+    vector<BenchmarkSurface> surfaces = {
+        { "lecture surface (biquadratic)", BSplineSurface(controlPoints, 4, 2, 2) },
+        { "16 x 16 bicubic", BSplineSurface(points, 16, 3, 3) },
+        { "NURBS sphere", BSplineSurface::sphere(1.0f) } };
+
+    auto milliseconds = [](std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
 
+    for (const BenchmarkSurface& benchmark : surfaces)
+    {
+        const BSplineSurface& surface = benchmark.surface;
+        std::cout << benchmark.name << std::endl;
+        std::cout << "  samples        direct ms   cached ms   subdivision ms   forward differencing ms" << std::endl;
+        for (int level = 1; level <= 7; ++level)
+        {
+            //The subdivision gives 2^level samples per knot span, the other two use the same grid size 
+            auto start = std::chrono::steady_clock::now();
+            SubdivisionTessellator subdivision(surface);
+            subdivision.tessellateLevel(level);
+            double subdivisionTime = milliseconds(start);
+            int rows = subdivision.getRows();
+            int columns = subdivision.getColumns();
+
+            start = std::chrono::steady_clock::now();
+            vector<glm::vec3> direct(rows * columns);
+            for (int i = 0; i < rows; ++i)
+            {
+                for (int j = 0; j < columns; ++j)
+                {
+                    float u = i / static_cast<float>(rows - 1);
+                    float v = j / static_cast<float>(columns - 1);
+                    direct[i * columns + j] = surface.evaluate(u, v);
+                }
+            }
+            double directTime = milliseconds(start);
+
+            start = std::chrono::steady_clock::now();
+            SurfaceTessellator cached(surface, rows, columns);
+            cached.tessellate();
+            double cachedTime = milliseconds(start);
+
+            start = std::chrono::steady_clock::now();
+            ForwardDifferenceTessellator forward(surface, rows, columns);
+            forward.tessellate(direct.data());
+            double forwardTime = milliseconds(start);
+
+            std::cout << "  " << rows << " x " << columns << "\t" << directTime << "\t" << cachedTime << "\t"
+                << subdivisionTime << "\t" << forwardTime << std::endl;
+        }
+    }
+}
 
-
-
-
+//Tessellates a bicubic surface with 1000 x 1000 control points into a samples x samples grid of vertices and triangles.
+//The counts are known up front, so the vertices and the indices are written straight into arrays that are allocated once,
+//the same way they would be written into mapped buffers. Every block of rows is evaluated on the thread pool 
+void runLargeGridBenchmark(int samples)
+{
+    const int controlWidth = 1000;
+    vector<glm::vec3> points(controlWidth * controlWidth);
+    for (int r = 0; r < controlWidth; ++r)
+        for (int c = 0; c < controlWidth; ++c)
+            points[r * controlWidth + c] = glm::vec3(c, r, sin(c * 0.07f) * cos(r * 0.05f) * 10.0f);
+    BSplineSurface surface(points, controlWidth, 3, 3);
+
+    auto milliseconds = [](std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    ThreadPool& pool = ThreadPool::shared();
+    size_t vertexCount = static_cast<size_t>(samples) * samples;
+    size_t indexCount = SurfaceTessellator::triangleIndexCount(samples, samples);
+    std::cout << samples << " x " << samples << " samples, " << vertexCount << " vertices, " << indexCount / 3
+        << " triangles on " << pool.size() << " threads" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<glm::vec3[]> vertices(new glm::vec3[vertexCount]);
+    std::unique_ptr<unsigned int[]> indices(new unsigned int[indexCount]);
+    double allocationTime = milliseconds(start);
+
+    start = std::chrono::steady_clock::now();
+    SurfaceTessellator tessellator(surface, samples, samples);
+    double basisTime = milliseconds(start);
+
+    start = std::chrono::steady_clock::now();
+    tessellator.tessellate(pool, vertices.get());
+    double vertexTime = milliseconds(start);
+
+    start = std::chrono::steady_clock::now();
+    SurfaceTessellator::writeTriangleIndices(pool, samples, samples, indices.get());
+    double indexTime = milliseconds(start);
+
+    std::cout << "  allocation ms " << allocationTime << std::endl;
+    std::cout << "  basis functions ms " << basisTime << std::endl;
+    std::cout << "  vertices ms " << vertexTime << std::endl;
+    std::cout << "  triangle indices ms " << indexTime << std::endl;
+    double totalTime = allocationTime + basisTime + vertexTime + indexTime;
+    std::cout << "  total ms " << totalTime << std::endl;
+    //The goal is less than a second for the whole grid. The work is split evenly over the threads, so on one core 
+    //8192 x 8192 samples take several seconds and the goal needs many cores 
+    std::cout << "  goal of 1000 ms " << (totalTime < 1000.0 ? "met" : "not met") << " on " << pool.size() << " threads" << std::endl;
+}
@@ -0,0 +1,114 @@
+#version 330 core
+// Evaluates the B-spline surface on the GPU. There are no vertex attributes, the grid position of
+// each vertex is calculated from gl_VertexID, so changing the resolution needs no new vertex data.
+// The homogeneous control points (w * xyz, w) and the knot vectors (knotsU followed by knotsV) are stored in texture buffers.
+uniform samplerBuffer controlNet;
+uniform samplerBuffer knots;
+
+uniform int width;      // control points in the v direction
+uniform int height;     // control points in the u direction
+uniform int degreeU;
+uniform int degreeV;
+uniform int samplesU;
+uniform int samplesV;
+uniform int drawLines;  // 1: two vertices per grid line segment, 0: one vertex per sample
+uniform vec3 color;
+
+uniform mat4 model;
+layout (std140) uniform Camera  // shared by all programs, updated once per frame
+{
+    mat4 projection;
+    mat4 view;
+};
+
+out vec3 ourColor;
+
+const int MAX_DEGREE = 7;
+
+// Finds the knot span that contains t, the same binary search as BSplineSurface::findSpan
+int findSpan(int offset, int degree, int numPoints, float t)
+{
+    if (t >= texelFetch(knots, offset + numPoints).r)
+        return numPoints - 1;
+    if (t <= texelFetch(knots, offset + degree).r)
+        return degree;
+
+    int low = degree;
+    int high = numPoints;
+    int mid = (low + high) / 2;
+    while (t < texelFetch(knots, offset + mid).r || t >= texelFetch(knots, offset + mid + 1).r)
+    {
+        if (t < texelFetch(knots, offset + mid).r)
+            high = mid;
+        else
+            low = mid;
+        mid = (low + high) / 2;
+    }
+    return mid;
+}
+
+// Cox-de Boor recursion, the same as BSplineSurface::basisFunctions
+void basisFunctions(int offset, int degree, int span, float t, out float basis[MAX_DEGREE + 1])
+{
+    float left[MAX_DEGREE + 1];
+    float right[MAX_DEGREE + 1];
+    basis[0] = 1.0;
+    for (int j = 1; j <= degree; ++j)
+    {
+        left[j] = t - texelFetch(knots, offset + span + 1 - j).r;
+        right[j] = texelFetch(knots, offset + span + j).r - t;
+        float saved = 0.0;
+        for (int r = 0; r < j; ++r)
+        {
+            float temp = basis[r] / (right[r + 1] + left[j - r]);
+            basis[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        basis[j] = saved;
+    }
+}
+
+// Grid position (row i, column j) of this vertex
+ivec2 gridPosition()
+{
+    if (drawLines == 0)
+        return ivec2(gl_VertexID / samplesV, gl_VertexID % samplesV);
+
+    // Lines along the rows first, then lines along the columns
+    int line = gl_VertexID / 2;
+    int end = gl_VertexID % 2;
+    int rowLines = samplesU * (samplesV - 1);
+    if (line < rowLines)
+        return ivec2(line / (samplesV - 1), line % (samplesV - 1) + end);
+    line -= rowLines;
+    return ivec2(line / samplesV + end, line % samplesV);
+}
+
+void main()
+{
+    ivec2 grid = gridPosition();
+    float u = float(grid.x) / float(samplesU - 1);
+    float v = float(grid.y) / float(samplesV - 1);
+
+    int knotsVOffset = height + degreeU + 1;
+    int spanU = findSpan(0, degreeU, height, u);
+    int spanV = findSpan(knotsVOffset, degreeV, width, v);
+    float basisU[MAX_DEGREE + 1];
+    float basisV[MAX_DEGREE + 1];
+    basisFunctions(0, degreeU, spanU, u, basisU);
+    basisFunctions(knotsVOffset, degreeV, spanV, v, basisV);
+
+    // Blends in homogeneous coordinates and divides by w at the end (NURBS)
+    vec4 point = vec4(0.0);
+    for (int i = 0; i <= degreeU; ++i)
+    {
+        int row = (spanU - degreeU + i) * width + spanV - degreeV;
+        vec4 rowPoint = vec4(0.0);
+        for (int j = 0; j <= degreeV; ++j)
+            rowPoint += basisV[j] * texelFetch(controlNet, row + j);
+        point += basisU[i] * rowPoint;
+    }
+
+    gl_Position = projection * view * model * vec4(point.xyz / point.w, 1.0);
+    ourColor = color;
+}
@@ -0,0 +1,99 @@
+#include "BallSystem.h"
+#include <algorithm>
+
+//Balls per block in the thread pool
+const size_t BALL_BLOCK = 1024;
+
+BallSystem::BallSystem(const TriangleLocator& locator, float radius, const glm::vec3& gravity, float timeStep)
+    : radius(radius), gravity(gravity), restitution(0.2f), rollingFriction(0.1f), timeStep(timeStep),
+    ballCollisions(true), locator(locator)
+{
+}
+
+void BallSystem::addBall(const glm::vec3& position, const glm::vec3& velocity)
+{
+    positionX.push_back(position.x);
+    positionY.push_back(position.y);
+    positionZ.push_back(position.z);
+    velocityX.push_back(velocity.x);
+    velocityY.push_back(velocity.y);
+    velocityZ.push_back(velocity.z);
+    triangle.push_back(-1);
+}
+
+void BallSystem::clear()
+{
+    positionX.clear();
+    positionY.clear();
+    positionZ.clear();
+    velocityX.clear();
+    velocityY.clear();
+    velocityZ.clear();
+    triangle.clear();
+    pairs.clear();
+}
+
+void BallSystem::step(ThreadPool& pool)
+{
+    pool.parallelFor(size(), BALL_BLOCK, [this](size_t begin, size_t end) { stepBalls(begin, end); });
+    if (ballCollisions)
+    {
+        broadphase.findPairs(pool, positionX.data(), positionY.data(), positionZ.data(), size(), radius, pairs);
+        contactSolver.solve(pool, *this, pairs);
+    }
+    else
+    {
+        pairs.clear();
+    }
+}
+
+void BallSystem::stepBalls(size_t begin, size_t end)
+{
+    const float dt = timeStep;
+    const TerrainMesh& terrain = locator.getMesh();
+    for (size_t i = begin; i < end; ++i)
+    {
+        //Semi-implicit Euler: the velocity is updated first and the new velocity moves the ball
+        glm::vec3 velocity(velocityX[i], velocityY[i], velocityZ[i]);
+        velocity += gravity * dt;
+        glm::vec3 position = glm::vec3(positionX[i], positionY[i], positionZ[i]) + velocity * dt;
+
+        //The balls bounce back from the edges of the terrain
+        if (position.x < terrain.minCorner.x || position.x > terrain.maxCorner.x)
+        {
+            position.x = std::min(std::max(position.x, terrain.minCorner.x), terrain.maxCorner.x);
+            velocity.x = -velocity.x;
+        }
+        if (position.y < terrain.minCorner.y || position.y > terrain.maxCorner.y)
+        {
+            position.y = std::min(std::max(position.y, terrain.minCorner.y), terrain.maxCorner.y);
+            velocity.y = -velocity.y;
+        }
+
+        TriangleQuery ground;
+        locator.locate(position.x, position.y, ground, triangle[i]);
+        triangle[i] = ground.triangle;
+        if (ground.triangle >= 0)
+        {
+            if (position.z - radius <= ground.height)
+            {
+                //The ball touches the triangle. It is put back on the surface and the velocity into the surface is removed
+                //(or turned around for a small bounce). What is left of gravity is the part along the triangle,
+                //g - (g . n) n, which makes the ball roll down the slope.
+                const glm::vec3& normal = ground.normal;
+                position.z = ground.height + radius;
+                float normalSpeed = glm::dot(velocity, normal);
+                if (normalSpeed < 0.0f)
+                    velocity -= (1.0f + restitution) * normalSpeed * normal;
+                velocity *= std::max(1.0f - rollingFriction * dt, 0.0f);
+            }
+        }
+
+        positionX[i] = position.x;
+        positionY[i] = position.y;
+        positionZ[i] = position.z;
+        velocityX[i] = velocity.x;
+        velocityY[i] = velocity.y;
+        velocityZ[i] = velocity.z;
+    }
+}
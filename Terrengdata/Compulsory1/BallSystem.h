@@ -0,0 +1,56 @@
+#ifndef BALLSYSTEM_H
+#define BALLSYSTEM_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "TriangleLocator.h"
+#include "ThreadPool.h"
+#include "Broadphase.h"
+#include "ContactSolver.h"
+
+//Balls that roll on the terrain mesh. The balls are stored as a structure of arrays: one vector for each
+//coordinate, so a thread that moves a block of balls reads and writes long runs of floats, and the positions
+//can be uploaded to the GPU as they are, without copying them into vec3s first.
+//All balls have the same radius. The simulation uses a fixed time step, so the result does not depend on the frame rate.
+class BallSystem
+{
+public:
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> velocityX, velocityY, velocityZ;
+    //The triangle under each ball in the last step, or -1 outside the terrain. The next step walks from it.
+    std::vector<int> triangle;
+
+    float radius;
+    glm::vec3 gravity;
+    //How much of the velocity into the ground is kept after a bounce (0 gives no bounce)
+    float restitution;
+    //Rolling resistance, the part of the speed that is lost per second while the ball touches the ground
+    float rollingFriction;
+    //The length of one simulation step in seconds
+    float timeStep;
+    //Balls that touch each other are pushed apart after they have been moved. The broadphase finds the touching pairs.
+    bool ballCollisions;
+    Broadphase broadphase;
+    ContactSolver contactSolver;
+
+    BallSystem(const TriangleLocator& locator, float radius, const glm::vec3& gravity, float timeStep = 1.0f / 60.0f);
+
+    size_t size() const { return positionX.size(); }
+    void addBall(const glm::vec3& position, const glm::vec3& velocity = glm::vec3(0.0f));
+    void clear();
+
+    //Moves all balls one time step, the balls are shared between the threads in blocks.
+    //Then the collisions between the balls are solved.
+    void step(ThreadPool& pool);
+
+    //The touching pairs found in the last step
+    const std::vector<BallPair>& getPairs() const { return pairs; }
+
+private:
+    void stepBalls(size_t begin, size_t end);
+
+    const TriangleLocator& locator;
+    std::vector<BallPair> pairs;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "Benchmark.h"
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+//Animation time per frame
+const float FRAME_TIME = 1.0f / 60.0f;
+
+Benchmark::Benchmark(const Flythrough& path, int frames, int warmupFrames)
+    : path(path), frames(frames), warmupFrames(warmupFrames), frame(-1), framebuffer(0), colorBuffer(0), depthBuffer(0),
+    width(0), height(0)
+{
+}
+
+Benchmark::~Benchmark()
+{
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+}
+
+void Benchmark::createTarget(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::BENCHMARK::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+    glViewport(0, 0, width, height);
+}
+
+bool Benchmark::nextFrame(Camera& camera, Profiler& profiler)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (frame >= warmupFrames)
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(now - frameStart).count());
+    frameStart = now;
+    ++frame;
+    if (frame >= warmupFrames + frames)
+        return false;
+    if (frame == warmupFrames)
+        profiler.resetStatistics();
+    path.apply(camera, static_cast<float>(std::max(frame - warmupFrames, 0)) / frames);
+    return true;
+}
+
+float Benchmark::time() const
+{
+    return std::max(frame, 0) * FRAME_TIME;
+}
+
+bool Benchmark::writeReport(const std::string& reportPath, const std::string& program, const Profiler& profiler) const
+{
+    std::ofstream file(reportPath);
+    if (!file.is_open())
+        return false;
+
+    std::vector<double> sorted(frameTimes);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (double frameTime : sorted)
+        sum += frameTime;
+    //Nearest rank percentiles, the same as the profiler
+    auto percentile = [&sorted](double p) {
+        if (sorted.empty())
+            return 0.0;
+        size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+        return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+    };
+    const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+    file << "{\n";
+    file << "  \"program\": " << Profiler::jsonString(program) << ",\n";
+    file << "  \"renderer\": " << Profiler::jsonString(renderer ? renderer : "") << ",\n";
+    file << "  \"version\": " << Profiler::jsonString(version ? version : "") << ",\n";
+    file << "  \"width\": " << width << ",\n  \"height\": " << height << ",\n";
+    file << "  \"frames\": " << frameTimes.size() << ",\n  \"warmup_frames\": " << warmupFrames << ",\n";
+    file << "  \"frame_ms\": { \"mean\": " << (sorted.empty() ? 0.0 : sum / sorted.size())
+        << ", \"min\": " << (sorted.empty() ? 0.0 : sorted.front()) << ", \"p50\": " << percentile(0.50)
+        << ", \"p95\": " << percentile(0.95) << ", \"p99\": " << percentile(0.99)
+        << ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << " },\n";
+    file << "  \"scopes\": [";
+    std::vector<Profiler::Statistics> scopes = profiler.statistics();
+    for (size_t i = 0; i < scopes.size(); ++i)
+    {
+        const Profiler::Statistics& scope = scopes[i];
+        file << (i == 0 ? "\n" : ",\n") << "    { \"name\": " << Profiler::jsonString(scope.name) << ", \"type\": \"" << (scope.gpu ? "gpu" : "cpu")
+            << "\", \"samples\": " << scope.samples << ", \"mean\": " << scope.mean << ", \"p50\": " << scope.p50
+            << ", \"p95\": " << scope.p95 << ", \"p99\": " << scope.p99 << " }";
+    }
+    file << "\n  ],\n";
+    file << "  \"frame_times_ms\": [";
+    for (size_t i = 0; i < frameTimes.size(); ++i)
+        file << (i == 0 ? "" : ", ") << frameTimes[i];
+    file << "]\n}\n";
+    return true;
+}
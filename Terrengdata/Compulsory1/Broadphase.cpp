@@ -0,0 +1,210 @@
+#include "Broadphase.h"
+#include <algorithm>
+#include <cmath>
+
+//Balls per block when the threads work on the balls, and buckets per block when they work on the table
+const size_t BALL_BLOCK = 2048;
+const size_t BUCKET_BLOCK = 4096;
+
+Broadphase::Broadphase(Method method) : method(method), tableMask(0), tableRow(1)
+{
+}
+
+void Broadphase::findPairs(ThreadPool& pool, const float* x, const float* y, const float* z, size_t count, float radius,
+    std::vector<BallPair>& pairs)
+{
+    blockPairs.resize((count + BALL_BLOCK - 1) / BALL_BLOCK);
+    for (std::vector<BallPair>& block : blockPairs)
+        block.clear();
+
+    if (method == SPATIAL_HASH)
+    {
+        buildHash(pool, x, y, z, count, 2.0f * radius);
+        hashPairs(pool, x, y, z, count, radius);
+    }
+    else
+    {
+        sweepPairs(pool, x, y, z, count, radius);
+    }
+    gatherPairs(pairs);
+}
+
+unsigned int Broadphase::bucket(int cellX, int cellY, int cellZ) const
+{
+    //Cubes next to each other along x get buckets next to each other, and the rows along y are tableRow buckets apart,
+    //so the 27 cubes around a ball are in 9 short runs of the table and balls close to each other use the same part
+    //of the table. The layers along z are spread with a large prime. Cubes that wrap around to the same bucket are
+    //told apart by the cube of each ball.
+    std::uint32_t hash = static_cast<std::uint32_t>(cellX) + static_cast<std::uint32_t>(cellY) * tableRow
+        + static_cast<std::uint32_t>(cellZ) * 83492791u;
+    return hash & tableMask;
+}
+
+void Broadphase::buildHash(ThreadPool& pool, const float* x, const float* y, const float* z, size_t count, float cellSize)
+{
+    //At least twice as many buckets as balls, and a power of two so the hash can be masked
+    size_t tableSize = 1;
+    while (tableSize < 2 * count)
+        tableSize *= 2;
+    tableMask = static_cast<std::uint32_t>(tableSize - 1);
+    tableRow = 1;
+    while (static_cast<size_t>(tableRow) * tableRow < tableSize)
+        tableRow *= 2;
+    if (bucketCount.size() != tableSize)
+    {
+        bucketCount = std::vector<std::atomic<unsigned int>>(tableSize);
+        bucketStart.resize(tableSize + 1);
+    }
+    cellX.resize(count);
+    cellY.resize(count);
+    cellZ.resize(count);
+    ballBucket.resize(count);
+    sortedBalls.resize(count);
+
+    pool.parallelFor(tableSize, BUCKET_BLOCK, [&](size_t begin, size_t end)
+    {
+        for (size_t b = begin; b < end; ++b)
+            bucketCount[b].store(0, std::memory_order_relaxed);
+    });
+
+    //Counting
+    float inverseSize = 1.0f / cellSize;
+    pool.parallelFor(count, BALL_BLOCK, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            cellX[i] = static_cast<int>(std::floor(x[i] * inverseSize));
+            cellY[i] = static_cast<int>(std::floor(y[i] * inverseSize));
+            cellZ[i] = static_cast<int>(std::floor(z[i] * inverseSize));
+            ballBucket[i] = bucket(cellX[i], cellY[i], cellZ[i]);
+            bucketCount[ballBucket[i]].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    //Running sum in two passes: the sum of every block of buckets, then the start of every bucket
+    size_t blocks = (tableSize + BUCKET_BLOCK - 1) / BUCKET_BLOCK;
+    std::vector<unsigned int> blockStart(blocks + 1, 0);
+    pool.parallelFor(tableSize, BUCKET_BLOCK, [&](size_t begin, size_t end)
+    {
+        unsigned int sum = 0;
+        for (size_t b = begin; b < end; ++b)
+            sum += bucketCount[b].load(std::memory_order_relaxed);
+        blockStart[begin / BUCKET_BLOCK + 1] = sum;
+    });
+    for (size_t k = 1; k <= blocks; ++k)
+        blockStart[k] += blockStart[k - 1];
+    pool.parallelFor(tableSize, BUCKET_BLOCK, [&](size_t begin, size_t end)
+    {
+        unsigned int start = blockStart[begin / BUCKET_BLOCK];
+        for (size_t b = begin; b < end; ++b)
+        {
+            bucketStart[b] = start;
+            start += bucketCount[b].load(std::memory_order_relaxed);
+        }
+    });
+    bucketStart[tableSize] = static_cast<unsigned int>(count);
+
+    //Every ball takes the last free place in its bucket. The order inside a bucket depends on the threads,
+    //so the few balls of each bucket are sorted afterwards.
+    pool.parallelFor(count, BALL_BLOCK, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            unsigned int b = ballBucket[i];
+            unsigned int place = bucketStart[b] + bucketCount[b].fetch_sub(1, std::memory_order_relaxed) - 1;
+            sortedBalls[place] = static_cast<unsigned int>(i);
+        }
+    });
+    pool.parallelFor(tableSize, BUCKET_BLOCK, [&](size_t begin, size_t end)
+    {
+        for (size_t b = begin; b < end; ++b)
+        {
+            if (bucketStart[b + 1] - bucketStart[b] > 1)
+                std::sort(sortedBalls.begin() + bucketStart[b], sortedBalls.begin() + bucketStart[b + 1]);
+        }
+    });
+}
+
+void Broadphase::hashPairs(ThreadPool& pool, const float* x, const float* y, const float* z, size_t count, float radius)
+{
+    float touching = 4.0f * radius * radius;
+    pool.parallelFor(count, BALL_BLOCK, [&](size_t begin, size_t end)
+    {
+        std::vector<BallPair>& found = blockPairs[begin / BALL_BLOCK];
+        for (size_t s = begin; s < end; ++s)
+        {
+            //The balls are taken in the order of the table, so balls that are close to each other are handled one after
+            //the other and the buckets around them are still in the cache
+            unsigned int i = sortedBalls[s];
+            for (int dz = -1; dz <= 1; ++dz)
+            {
+                for (int dy = -1; dy <= 1; ++dy)
+                {
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        int nx = cellX[i] + dx;
+                        int ny = cellY[i] + dy;
+                        int nz = cellZ[i] + dz;
+                        unsigned int b = bucket(nx, ny, nz);
+                        for (unsigned int k = bucketStart[b]; k < bucketStart[b + 1]; ++k)
+                        {
+                            //Every pair is found once, from the ball with the smaller index. Other cubes can hash
+                            //to the same bucket, so the cube of the other ball is checked as well.
+                            unsigned int j = sortedBalls[k];
+                            if (j <= i || cellX[j] != nx || cellY[j] != ny || cellZ[j] != nz)
+                                continue;
+                            float ex = x[j] - x[i];
+                            float ey = y[j] - y[i];
+                            float ez = z[j] - z[i];
+                            if (ex * ex + ey * ey + ez * ez < touching)
+                                found.push_back({ i, j });
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+void Broadphase::sweepPairs(ThreadPool& pool, const float* x, const float* y, const float* z, size_t count, float radius)
+{
+    sortedBalls.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        sortedBalls[i] = static_cast<unsigned int>(i);
+    std::sort(sortedBalls.begin(), sortedBalls.end(), [x](unsigned int a, unsigned int b)
+    {
+        return x[a] < x[b] || (x[a] == x[b] && a < b);
+    });
+
+    float diameter = 2.0f * radius;
+    float touching = diameter * diameter;
+    pool.parallelFor(count, BALL_BLOCK, [&](size_t begin, size_t end)
+    {
+        std::vector<BallPair>& found = blockPairs[begin / BALL_BLOCK];
+        for (size_t s = begin; s < end; ++s)
+        {
+            unsigned int i = sortedBalls[s];
+            //Only the balls after this one in the sorted order that still overlap along x
+            for (size_t t = s + 1; t < count && x[sortedBalls[t]] - x[i] < diameter; ++t)
+            {
+                unsigned int j = sortedBalls[t];
+                float ex = x[j] - x[i];
+                float ey = y[j] - y[i];
+                float ez = z[j] - z[i];
+                if (ex * ex + ey * ey + ez * ez < touching)
+                    found.push_back({ std::min(i, j), std::max(i, j) });
+            }
+        }
+    });
+}
+
+void Broadphase::gatherPairs(std::vector<BallPair>& pairs)
+{
+    size_t total = 0;
+    for (const std::vector<BallPair>& block : blockPairs)
+        total += block.size();
+    pairs.clear();
+    pairs.reserve(total);
+    for (const std::vector<BallPair>& block : blockPairs)
+        pairs.insert(pairs.end(), block.begin(), block.end());
+}
@@ -0,0 +1,56 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include "ThreadPool.h"
+
+//Two balls that are closer than two radii. a is always smaller than b.
+struct BallPair
+{
+    unsigned int a;
+    unsigned int b;
+};
+
+//Finds the balls that touch each other without testing all pairs.
+//SPATIAL_HASH puts every ball in a cube of size 2 * radius and hashes the cube into a table that is rebuilt every
+//step with a counting sort: the threads count the balls of each bucket with atomic counters, a running sum gives where
+//every bucket starts, and the threads put the balls in their buckets. A ball can only touch balls in the 27 cubes
+//around it, so the cost grows linearly with the number of balls.
+//SWEEP_AND_PRUNE sorts the balls along x and only tests balls that overlap along x, which works well when the balls
+//are spread out along x.
+//All balls have the same radius. The pairs come out in the same order every time, so the simulation is repeatable.
+class Broadphase
+{
+public:
+    enum Method { SPATIAL_HASH, SWEEP_AND_PRUNE };
+    Method method;
+
+    explicit Broadphase(Method method = SPATIAL_HASH);
+
+    void findPairs(ThreadPool& pool, const float* x, const float* y, const float* z, size_t count, float radius,
+        std::vector<BallPair>& pairs);
+
+private:
+    void buildHash(ThreadPool& pool, const float* x, const float* y, const float* z, size_t count, float cellSize);
+    void hashPairs(ThreadPool& pool, const float* x, const float* y, const float* z, size_t count, float radius);
+    void sweepPairs(ThreadPool& pool, const float* x, const float* y, const float* z, size_t count, float radius);
+    unsigned int bucket(int cellX, int cellY, int cellZ) const;
+    void gatherPairs(std::vector<BallPair>& pairs);
+
+    //The cube of every ball
+    std::vector<int> cellX, cellY, cellZ;
+    std::vector<unsigned int> ballBucket;
+    //Balls per bucket while the table is built, the balls of bucket b are sortedBalls[bucketStart[b]] to sortedBalls[bucketStart[b + 1] - 1]
+    std::vector<std::atomic<unsigned int>> bucketCount;
+    std::vector<unsigned int> bucketStart;
+    std::vector<unsigned int> sortedBalls;
+    std::uint32_t tableMask;
+    std::uint32_t tableRow;
+
+    //The pairs found by each block of balls, joined in block order at the end
+    std::vector<std::vector<BallPair>> blockPairs;
+};
+
+#endif
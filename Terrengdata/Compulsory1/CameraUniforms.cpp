@@ -0,0 +1,23 @@
+#include "CameraUniforms.h"
+
+CameraUniforms::CameraUniforms()
+{
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, buffer);
+}
+
+CameraUniforms::~CameraUniforms()
+{
+    glDeleteBuffers(1, &buffer);
+}
+
+void CameraUniforms::update(const glm::mat4& projection, const glm::mat4& view)
+{
+    Block block = { projection, view };
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,35 @@
+#ifndef CAMERAUNIFORMS_H
+#define CAMERAUNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+//The projection and view matrices in one std140 uniform buffer, the Camera block of the vertex shaders.
+//The buffer is bound once to BINDING, and every Shader connects its Camera block to that binding when it is linked.
+//So a frame updates the matrices once for all programs instead of two glUniformMatrix4fv calls for each of them.
+class CameraUniforms
+{
+public:
+    static constexpr GLuint BINDING = 0;
+    static constexpr const char* BLOCK_NAME = "Camera";
+
+    CameraUniforms();
+    ~CameraUniforms();
+
+    CameraUniforms(const CameraUniforms&) = delete;
+    CameraUniforms& operator=(const CameraUniforms&) = delete;
+
+    void update(const glm::mat4& projection, const glm::mat4& view);
+
+private:
+    //The std140 layout of the block: a mat4 is four vec4 columns, so the C++ struct has the same layout
+    struct Block
+    {
+        glm::mat4 projection;
+        glm::mat4 view;
+    };
+
+    GLuint buffer;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "ContactSolver.h"
+#include "BallSystem.h"
+#include <cmath>
+
+//Islands per block in the thread pool, most islands are only a couple of balls
+const size_t ISLAND_BLOCK = 64;
+
+ContactSolver::ContactSolver(int iterations) : iterations(iterations)
+{
+}
+
+unsigned int ContactSolver::findRoot(unsigned int ball)
+{
+    //Path halving: every ball on the way is moved up to its grandparent, so the trees stay flat
+    while (parent[ball] != ball)
+    {
+        parent[ball] = parent[parent[ball]];
+        ball = parent[ball];
+    }
+    return ball;
+}
+
+void ContactSolver::buildIslands(size_t ballCount, const std::vector<BallPair>& pairs)
+{
+    parent.resize(ballCount);
+    for (size_t i = 0; i < ballCount; ++i)
+        parent[i] = static_cast<unsigned int>(i);
+    for (const BallPair& pair : pairs)
+    {
+        unsigned int a = findRoot(pair.a);
+        unsigned int b = findRoot(pair.b);
+        if (a != b)
+            parent[std::max(a, b)] = std::min(a, b);
+    }
+
+    //Numbers the islands in the order their first pair comes, and sorts the pairs by island (counting sort)
+    islandOfRoot.assign(ballCount, -1);
+    islandStart.assign(1, 0);
+    std::vector<int> pairIsland(pairs.size());
+    for (size_t p = 0; p < pairs.size(); ++p)
+    {
+        unsigned int root = findRoot(pairs[p].a);
+        if (islandOfRoot[root] < 0)
+        {
+            islandOfRoot[root] = static_cast<int>(islandStart.size() - 1);
+            islandStart.push_back(0);
+        }
+        pairIsland[p] = islandOfRoot[root];
+        ++islandStart[pairIsland[p] + 1];
+    }
+    for (size_t k = 1; k < islandStart.size(); ++k)
+        islandStart[k] += islandStart[k - 1];
+
+    islandPairs.resize(pairs.size());
+    std::vector<unsigned int> next(islandStart.begin(), islandStart.end() - 1);
+    for (size_t p = 0; p < pairs.size(); ++p)
+        islandPairs[next[pairIsland[p]]++] = static_cast<unsigned int>(p);
+}
+
+void ContactSolver::solve(ThreadPool& pool, BallSystem& balls, const std::vector<BallPair>& pairs)
+{
+    buildIslands(balls.size(), pairs);
+    pool.parallelFor(islandCount(), ISLAND_BLOCK, [&](size_t begin, size_t end)
+    {
+        for (size_t k = begin; k < end; ++k)
+        {
+            for (int iteration = 0; iteration < iterations; ++iteration)
+            {
+                for (unsigned int p = islandStart[k]; p < islandStart[k + 1]; ++p)
+                    solvePair(balls, pairs[islandPairs[p]]);
+            }
+        }
+    });
+}
+
+void ContactSolver::solvePair(BallSystem& balls, const BallPair& pair) const
+{
+    unsigned int a = pair.a;
+    unsigned int b = pair.b;
+    glm::vec3 delta(balls.positionX[b] - balls.positionX[a], balls.positionY[b] - balls.positionY[a],
+        balls.positionZ[b] - balls.positionZ[a]);
+    float distance = glm::length(delta);
+    float diameter = 2.0f * balls.radius;
+    if (distance >= diameter || distance == 0.0f)
+        return;
+
+    //The balls have the same mass, so each of them moves half of the overlap along the line between the centres
+    glm::vec3 normal = delta / distance;
+    glm::vec3 push = 0.5f * (diameter - distance) * normal;
+    balls.positionX[a] -= push.x;
+    balls.positionY[a] -= push.y;
+    balls.positionZ[a] -= push.z;
+    balls.positionX[b] += push.x;
+    balls.positionY[b] += push.y;
+    balls.positionZ[b] += push.z;
+
+    //If the balls move towards each other, the impulse turns the normal part of the relative velocity around
+    glm::vec3 relative(balls.velocityX[b] - balls.velocityX[a], balls.velocityY[b] - balls.velocityY[a],
+        balls.velocityZ[b] - balls.velocityZ[a]);
+    float normalSpeed = glm::dot(relative, normal);
+    if (normalSpeed >= 0.0f)
+        return;
+    glm::vec3 impulse = -0.5f * (1.0f + balls.restitution) * normalSpeed * normal;
+    balls.velocityX[a] -= impulse.x;
+    balls.velocityY[a] -= impulse.y;
+    balls.velocityZ[a] -= impulse.z;
+    balls.velocityX[b] += impulse.x;
+    balls.velocityY[b] += impulse.y;
+    balls.velocityZ[b] += impulse.z;
+}
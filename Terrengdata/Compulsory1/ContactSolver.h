@@ -0,0 +1,39 @@
+#ifndef CONTACTSOLVER_H
+#define CONTACTSOLVER_H
+
+#include <vector>
+#include "Broadphase.h"
+#include "ThreadPool.h"
+
+class BallSystem;
+
+//Pushes touching balls apart and gives them a bounce. The pairs are split into islands, groups of balls that touch
+//each other directly or through other balls, with union-find. Two islands never share a ball, so the threads solve
+//different islands at the same time without locks. Inside an island the pairs are solved one after the other a few
+//times, so a ball in a pile gets pushed by all its neighbours.
+class ContactSolver
+{
+public:
+    //How many times the pairs of each island are solved per step
+    int iterations;
+
+    explicit ContactSolver(int iterations = 4);
+
+    void solve(ThreadPool& pool, BallSystem& balls, const std::vector<BallPair>& pairs);
+
+    //Number of islands in the last step
+    size_t islandCount() const { return islandStart.empty() ? 0 : islandStart.size() - 1; }
+
+private:
+    unsigned int findRoot(unsigned int ball);
+    void buildIslands(size_t ballCount, const std::vector<BallPair>& pairs);
+    void solvePair(BallSystem& balls, const BallPair& pair) const;
+
+    std::vector<unsigned int> parent;
+    std::vector<int> islandOfRoot;
+    //The pairs of island k are islandPairs[islandStart[k]] to islandPairs[islandStart[k + 1] - 1]
+    std::vector<unsigned int> islandStart;
+    std::vector<unsigned int> islandPairs;
+};
+
+#endif
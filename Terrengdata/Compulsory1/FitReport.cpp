@@ -0,0 +1,53 @@
+#include "FitReport.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+void FitReport::measureError(const SplineLattice& lattice, const std::vector<glm::vec3>& points, ThreadPool& pool)
+{
+    const size_t blockSize = 1 << 16;
+    size_t blocks = (points.size() + blockSize - 1) / blockSize;
+    //One result per block, so the threads never write to the same value
+    std::vector<double> squaredSums(blocks, 0.0);
+    std::vector<double> absSums(blocks, 0.0);
+    std::vector<float> maxima(blocks, 0.0f);
+
+    pool.parallelFor(points.size(), blockSize, [&](size_t begin, size_t end)
+    {
+        size_t block = begin / blockSize;
+        for (size_t i = begin; i < end; ++i)
+        {
+            float error = std::fabs(lattice.evaluate(points[i].x, points[i].y) - points[i].z);
+            squaredSums[block] += static_cast<double>(error) * error;
+            absSums[block] += error;
+            maxima[block] = std::max(maxima[block], error);
+        }
+    });
+
+    double squaredSum = 0.0, absSum = 0.0;
+    maxError = 0.0f;
+    for (size_t block = 0; block < blocks; ++block)
+    {
+        squaredSum += squaredSums[block];
+        absSum += absSums[block];
+        maxError = std::max(maxError, maxima[block]);
+    }
+    pointCount = points.size();
+    controlPointCount = lattice.controlHeights.size();
+    rmsError = pointCount > 0 ? static_cast<float>(std::sqrt(squaredSum / pointCount)) : 0.0f;
+    meanAbsError = pointCount > 0 ? static_cast<float>(absSum / pointCount) : 0.0f;
+}
+
+void FitReport::print(const char* title) const
+{
+    //A point is three floats, a control point of the lattice is one float
+    double pointMegabytes = pointCount * sizeof(glm::vec3) / (1024.0 * 1024.0);
+    double latticeMegabytes = controlPointCount * sizeof(float) / (1024.0 * 1024.0);
+
+    std::cout << title << std::endl;
+    std::cout << "  Points: " << pointCount << " (" << pointMegabytes << " MB)" << std::endl;
+    std::cout << "  Control points: " << controlPointCount << " (" << latticeMegabytes << " MB)" << std::endl;
+    std::cout << "  Iterations: " << iterations << ", relative residual: " << relativeResidual << std::endl;
+    std::cout << "  Time: " << seconds << " s" << std::endl;
+    std::cout << "  Height error RMS: " << rmsError << ", mean: " << meanAbsError << ", max: " << maxError << std::endl;
+}
@@ -0,0 +1,29 @@
+#ifndef FITREPORT_H
+#define FITREPORT_H
+
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include "SplineLattice.h"
+#include "ThreadPool.h"
+
+//How well a spline surface fits the terrain points, and how much memory it uses compared to the points
+struct FitReport
+{
+    size_t pointCount = 0;
+    size_t controlPointCount = 0;
+    //Conjugate gradient iterations for the least-squares fit, levels for the multilevel approximation
+    int iterations = 0;
+    double relativeResidual = 0.0;
+    double seconds = 0.0;
+    float rmsError = 0.0f;
+    float maxError = 0.0f;
+    float meanAbsError = 0.0f;
+
+    //Calculates the height errors of the lattice at every point. The points are shared between the threads of the pool.
+    void measureError(const SplineLattice& lattice, const std::vector<glm::vec3>& points, ThreadPool& pool);
+
+    void print(const char* title) const;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "Flythrough.h"
+#include <fstream>
+#include <cmath>
+
+Flythrough Flythrough::orbit(const glm::vec3& center, float radius, float height, int keyframeCount)
+{
+    const float pi = 3.14159265f;
+    Flythrough path;
+    for (int i = 0; i < keyframeCount; ++i)
+    {
+        float angle = 2.0f * pi * i / keyframeCount;
+        glm::vec3 position = center + glm::vec3(radius * std::cos(angle), radius * std::sin(angle), height);
+        path.keyframes.push_back({ position, center });
+    }
+    return path;
+}
+
+bool Flythrough::load(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+    std::vector<Keyframe> loaded;
+    Keyframe keyframe;
+    while (file >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+        >> keyframe.target.x >> keyframe.target.y >> keyframe.target.z)
+        loaded.push_back(keyframe);
+    if (loaded.size() < 2)
+        return false;
+    keyframes = loaded;
+    return true;
+}
+
+bool Flythrough::appendKeyframe(const std::string& path, const Camera& camera)
+{
+    std::ofstream file(path, std::ios::app);
+    if (!file.is_open())
+        return false;
+    glm::vec3 target = camera.Position + camera.Front;
+    file << camera.Position.x << ' ' << camera.Position.y << ' ' << camera.Position.z << ' '
+        << target.x << ' ' << target.y << ' ' << target.z << '\n';
+    return true;
+}
+
+glm::vec3 Flythrough::catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+{
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+void Flythrough::apply(Camera& camera, float t) const
+{
+    if (keyframes.empty())
+        return;
+    int count = static_cast<int>(keyframes.size());
+    float along = (t - std::floor(t)) * count;
+    int segment = std::min(static_cast<int>(along), count - 1);
+    float local = along - segment;
+    const Keyframe& k0 = keyframes[(segment + count - 1) % count];
+    const Keyframe& k1 = keyframes[segment];
+    const Keyframe& k2 = keyframes[(segment + 1) % count];
+    const Keyframe& k3 = keyframes[(segment + 2) % count];
+    glm::vec3 position = catmullRom(k0.position, k1.position, k2.position, k3.position, local);
+    glm::vec3 target = catmullRom(k0.target, k1.target, k2.target, k3.target, local);
+
+    //The camera turns with yaw and pitch, so the direction is turned into those angles (the inverse of
+    //updateCameraVectors). A mouse movement of zero makes the camera update its vectors.
+    glm::vec3 direction = glm::normalize(target - position);
+    camera.Position = position;
+    camera.Pitch = glm::degrees(std::asin(glm::clamp(direction.y, -1.0f, 1.0f)));
+    camera.Yaw = glm::degrees(std::atan2(direction.z, direction.x));
+    camera.ProcessMouseMovement(0.0f, 0.0f);
+}
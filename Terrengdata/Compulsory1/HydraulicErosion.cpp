@@ -0,0 +1,480 @@
+#include "HydraulicErosion.h"
+#include <algorithm>
+#include <cmath>
+
+//SSE2 is there on every x64 processor, and on 32-bit x86 when the compiler is told to use it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EROSION_SSE2
+#include <emmintrin.h>
+#endif
+
+//Tiles per block in the thread pool
+const size_t TILE_BLOCK = 4;
+//The water depth (in cells) that is used for the speed in a cell with almost no water, so the speed does not blow up
+const float MIN_SPEED_DEPTH = 1e-3f;
+//A tile with more water than this (in cells) counts as wet and is published after every step
+const float WET_DEPTH = 1e-4f;
+
+HydraulicErosion::HydraulicErosion(const std::vector<float>& heights, int width, int height, float cellSize, float timeStep)
+    : gravity(9.81f), rainRate(0.02f), raining(false), evaporation(0.05f), sedimentCapacity(0.5f), dissolving(0.3f),
+    deposition(0.3f), minimumTilt(0.02f), erosionDepth(1.0f), timeStep(timeStep), width(width), height(height), tilesX(width / TILE),
+    tilesY(height / TILE), cellSize(cellSize)
+{
+    size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+    size_t values = tileCount * STRIDE * STRIDE;
+    for (std::vector<float>* field : { &terrain, &water, &sediment, &fluxLeft, &fluxRight, &fluxDown, &fluxUp,
+        &velocityX, &velocityY, &scratch })
+        field->assign(values, 0.0f);
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            terrain[cellIndex(x, y)] = heights[static_cast<size_t>(y) * width + x] / cellSize;
+    for (size_t tile = 0; tile < tileCount; ++tile)
+        exchangeTile(static_cast<int>(tile), terrain, CLAMP);
+
+    //The renderer starts from the same heights, so only the tiles that change from now on are published
+    tileWet.assign(tileCount, 0);
+    tileActive.assign(tileCount, 0);
+    tileChanged.assign(tileCount, 0);
+    publishedTiles.assign(tileCount * TILE * TILE * 2, 0.0f);
+    publishedChanged.assign(tileCount, 0);
+}
+
+size_t HydraulicErosion::cellIndex(int x, int y) const
+{
+    size_t tile = static_cast<size_t>(y / TILE) * tilesX + x / TILE;
+    return tile * STRIDE * STRIDE + static_cast<size_t>(y % TILE + 1) * STRIDE + x % TILE + 1;
+}
+
+void HydraulicErosion::step(ThreadPool& pool)
+{
+    updateActiveTiles(pool);
+    if (activeTiles.empty())
+        return;
+
+    //The water outside the grid is 0, so water that flows over the edge is gone
+    exchangeHalos(pool, { &terrain }, CLAMP);
+    exchangeHalos(pool, { &water }, ZERO);
+    pool.parallelFor(activeTiles.size(), TILE_BLOCK, [this](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                fluxPass(activeTiles[i]);
+        });
+    //The water pass needs the flow into each cell, which is the flow out of the neighbours
+    exchangeHalos(pool, { &fluxLeft, &fluxRight, &fluxDown, &fluxUp }, ZERO);
+    pool.parallelFor(activeTiles.size(), TILE_BLOCK, [this](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                waterPass(activeTiles[i]);
+        });
+    exchangeHalos(pool, { &sediment }, CLAMP);
+    pool.parallelFor(activeTiles.size(), TILE_BLOCK, [this](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                transportPass(activeTiles[i]);
+        });
+}
+
+void HydraulicErosion::updateActiveTiles(ThreadPool& pool)
+{
+    //A tile is simulated if it or one of its eight neighbours had water in the last step, or if it rains
+    std::vector<char> active(tileActive.size(), 0);
+    for (int tileY = 0; tileY < tilesY; ++tileY)
+    {
+        for (int tileX = 0; tileX < tilesX; ++tileX)
+        {
+            bool wet = raining;
+            for (int y = std::max(tileY - 1, 0); y <= std::min(tileY + 1, tilesY - 1) && !wet; ++y)
+                for (int x = std::max(tileX - 1, 0); x <= std::min(tileX + 1, tilesX - 1) && !wet; ++x)
+                    wet = tileWet[y * tilesX + x] != 0;
+            active[tileY * tilesX + tileX] = wet;
+        }
+    }
+
+    std::vector<int> settled;
+    activeTiles.clear();
+    for (size_t tile = 0; tile < active.size(); ++tile)
+    {
+        if (active[tile])
+            activeTiles.push_back(static_cast<int>(tile));
+        else if (tileActive[tile])
+            settled.push_back(static_cast<int>(tile));
+    }
+    tileActive.swap(active);
+
+    pool.parallelFor(settled.size(), TILE_BLOCK, [this, &settled](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                settleTile(settled[i]);
+        });
+}
+
+void HydraulicErosion::settleTile(int tile)
+{
+    size_t base = static_cast<size_t>(tile) * STRIDE * STRIDE;
+    for (size_t i = base; i < base + STRIDE * STRIDE; ++i)
+    {
+        terrain[i] += sediment[i];
+        sediment[i] = 0.0f;
+    }
+    for (std::vector<float>* field : { &fluxLeft, &fluxRight, &fluxDown, &fluxUp, &velocityX, &velocityY })
+        std::fill(field->begin() + base, field->begin() + base + STRIDE * STRIDE, 0.0f);
+    tileChanged[tile] = 1;
+}
+
+void HydraulicErosion::fluxPass(int tile)
+{
+    size_t base = static_cast<size_t>(tile) * STRIDE * STRIDE;
+    const float* b = terrain.data() + base;
+    const float* d = water.data() + base;
+    float* left = fluxLeft.data() + base;
+    float* right = fluxRight.data() + base;
+    float* down = fluxDown.data() + base;
+    float* up = fluxUp.data() + base;
+    float* tilt = scratch.data() + base;
+    const float dt = timeStep;
+    const float acceleration = gravity * dt;
+#ifdef EROSION_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 speedUp = _mm_set1_ps(acceleration);
+    const __m128 step = _mm_set1_ps(dt);
+    const __m128 tiny = _mm_set1_ps(1e-12f);
+    const __m128 flatTilt = _mm_set1_ps(minimumTilt);
+#endif
+
+    for (int j = 1; j <= TILE; ++j)
+    {
+        int first = j * STRIDE + 1;
+#ifdef EROSION_SSE2
+        //The same as the loop below, four cells at a time
+        for (int i = first; i < first + TILE; i += 4)
+        {
+            __m128 level = _mm_add_ps(_mm_loadu_ps(b + i), _mm_loadu_ps(d + i));
+            __m128 flowLeft = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(left + i), _mm_mul_ps(speedUp,
+                _mm_sub_ps(level, _mm_add_ps(_mm_loadu_ps(b + i - 1), _mm_loadu_ps(d + i - 1))))), zero);
+            __m128 flowRight = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(right + i), _mm_mul_ps(speedUp,
+                _mm_sub_ps(level, _mm_add_ps(_mm_loadu_ps(b + i + 1), _mm_loadu_ps(d + i + 1))))), zero);
+            __m128 flowDown = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(down + i), _mm_mul_ps(speedUp,
+                _mm_sub_ps(level, _mm_add_ps(_mm_loadu_ps(b + i - STRIDE), _mm_loadu_ps(d + i - STRIDE))))), zero);
+            __m128 flowUp = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(up + i), _mm_mul_ps(speedUp,
+                _mm_sub_ps(level, _mm_add_ps(_mm_loadu_ps(b + i + STRIDE), _mm_loadu_ps(d + i + STRIDE))))), zero);
+            __m128 outflow = _mm_mul_ps(_mm_add_ps(_mm_add_ps(flowLeft, flowRight), _mm_add_ps(flowDown, flowUp)), step);
+            __m128 scale = _mm_min_ps(_mm_div_ps(_mm_loadu_ps(d + i), _mm_max_ps(outflow, tiny)), one);
+            _mm_storeu_ps(left + i, _mm_mul_ps(flowLeft, scale));
+            _mm_storeu_ps(right + i, _mm_mul_ps(flowRight, scale));
+            _mm_storeu_ps(down + i, _mm_mul_ps(flowDown, scale));
+            _mm_storeu_ps(up + i, _mm_mul_ps(flowUp, scale));
+
+            __m128 slopeX = _mm_mul_ps(half, _mm_sub_ps(_mm_loadu_ps(b + i + 1), _mm_loadu_ps(b + i - 1)));
+            __m128 slopeY = _mm_mul_ps(half, _mm_sub_ps(_mm_loadu_ps(b + i + STRIDE), _mm_loadu_ps(b + i - STRIDE)));
+            __m128 slope = _mm_add_ps(_mm_mul_ps(slopeX, slopeX), _mm_mul_ps(slopeY, slopeY));
+            _mm_storeu_ps(tilt + i, _mm_max_ps(_mm_sqrt_ps(_mm_div_ps(slope, _mm_add_ps(one, slope))), flatTilt));
+        }
+#else
+        for (int i = first; i < first + TILE; ++i)
+        {
+            //The flow in each pipe is sped up by the difference in water level and can not go backwards
+            float level = b[i] + d[i];
+            float flowLeft = std::max(left[i] + acceleration * (level - (b[i - 1] + d[i - 1])), 0.0f);
+            float flowRight = std::max(right[i] + acceleration * (level - (b[i + 1] + d[i + 1])), 0.0f);
+            float flowDown = std::max(down[i] + acceleration * (level - (b[i - STRIDE] + d[i - STRIDE])), 0.0f);
+            float flowUp = std::max(up[i] + acceleration * (level - (b[i + STRIDE] + d[i + STRIDE])), 0.0f);
+            //The pipes can not take more water out in one step than the cell has
+            float outflow = (flowLeft + flowRight + flowDown + flowUp) * dt;
+            float scale = std::min(d[i] / std::max(outflow, 1e-12f), 1.0f);
+            left[i] = flowLeft * scale;
+            right[i] = flowRight * scale;
+            down[i] = flowDown * scale;
+            up[i] = flowUp * scale;
+
+            //The sine of the slope, for the sediment capacity in the water pass
+            float slopeX = 0.5f * (b[i + 1] - b[i - 1]);
+            float slopeY = 0.5f * (b[i + STRIDE] - b[i - STRIDE]);
+            float slope = slopeX * slopeX + slopeY * slopeY;
+            tilt[i] = std::max(std::sqrt(slope / (1.0f + slope)), minimumTilt);
+        }
+#endif
+    }
+}
+
+void HydraulicErosion::waterPass(int tile)
+{
+    size_t base = static_cast<size_t>(tile) * STRIDE * STRIDE;
+    float* b = terrain.data() + base;
+    float* d = water.data() + base;
+    float* s = sediment.data() + base;
+    const float* left = fluxLeft.data() + base;
+    const float* right = fluxRight.data() + base;
+    const float* down = fluxDown.data() + base;
+    const float* up = fluxUp.data() + base;
+    float* u = velocityX.data() + base;
+    float* v = velocityY.data() + base;
+    const float* tilt = scratch.data() + base;
+    const float dt = timeStep;
+    const float rain = raining ? rainRate * dt : 0.0f;
+    const float keep = std::max(1.0f - evaporation * dt, 0.0f);
+    const float dissolve = dissolving * dt;
+    const float deposit = deposition * dt;
+    const float shallow = 1.0f / erosionDepth;
+
+    float deepest = 0.0f;
+#ifdef EROSION_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 step = _mm_set1_ps(dt);
+    const __m128 minDepth = _mm_set1_ps(MIN_SPEED_DEPTH);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 capacityScale = _mm_set1_ps(sedimentCapacity);
+    const __m128 shallowScale = _mm_set1_ps(shallow);
+    const __m128 dissolveRate = _mm_set1_ps(dissolve);
+    const __m128 depositRate = _mm_set1_ps(deposit);
+    const __m128 rainDepth = _mm_set1_ps(rain);
+    const __m128 keepWater = _mm_set1_ps(keep);
+    __m128 deepestFour = zero;
+#endif
+    for (int j = 1; j <= TILE; ++j)
+    {
+        int first = j * STRIDE + 1;
+#ifdef EROSION_SSE2
+        //The same as the loop below, four cells at a time
+        for (int i = first; i < first + TILE; i += 4)
+        {
+            __m128 leftHere = _mm_loadu_ps(left + i);
+            __m128 rightHere = _mm_loadu_ps(right + i);
+            __m128 downHere = _mm_loadu_ps(down + i);
+            __m128 upHere = _mm_loadu_ps(up + i);
+            __m128 fromLeft = _mm_loadu_ps(right + i - 1);
+            __m128 fromRight = _mm_loadu_ps(left + i + 1);
+            __m128 fromBelow = _mm_loadu_ps(up + i - STRIDE);
+            __m128 fromAbove = _mm_loadu_ps(down + i + STRIDE);
+            __m128 inflow = _mm_add_ps(_mm_add_ps(fromLeft, fromRight), _mm_add_ps(fromBelow, fromAbove));
+            __m128 outflow = _mm_add_ps(_mm_add_ps(leftHere, rightHere), _mm_add_ps(downHere, upHere));
+            __m128 oldDepth = _mm_loadu_ps(d + i);
+            __m128 depth = _mm_max_ps(_mm_add_ps(oldDepth, _mm_mul_ps(step, _mm_sub_ps(inflow, outflow))), zero);
+
+            __m128 meanDepth = _mm_max_ps(_mm_mul_ps(half, _mm_add_ps(oldDepth, depth)), minDepth);
+            __m128 speedX = _mm_div_ps(_mm_mul_ps(half, _mm_add_ps(_mm_sub_ps(fromLeft, leftHere), _mm_sub_ps(rightHere, fromRight))), meanDepth);
+            __m128 speedY = _mm_div_ps(_mm_mul_ps(half, _mm_add_ps(_mm_sub_ps(fromBelow, downHere), _mm_sub_ps(upHere, fromAbove))), meanDepth);
+            _mm_storeu_ps(u + i, speedX);
+            _mm_storeu_ps(v + i, speedY);
+
+            __m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(speedX, speedX), _mm_mul_ps(speedY, speedY)));
+            __m128 capacity = _mm_mul_ps(_mm_mul_ps(capacityScale, _mm_loadu_ps(tilt + i)), speed);
+            capacity = _mm_mul_ps(capacity, _mm_min_ps(_mm_mul_ps(depth, shallowScale), one));
+            __m128 carried = _mm_loadu_ps(s + i);
+            __m128 missing = _mm_sub_ps(capacity, carried);
+            __m128 dissolving = _mm_cmpgt_ps(missing, zero);
+            __m128 rate = _mm_or_ps(_mm_and_ps(dissolving, dissolveRate), _mm_andnot_ps(dissolving, depositRate));
+            __m128 change = _mm_mul_ps(rate, missing);
+            _mm_storeu_ps(b + i, _mm_sub_ps(_mm_loadu_ps(b + i), change));
+            _mm_storeu_ps(s + i, _mm_add_ps(carried, change));
+
+            depth = _mm_mul_ps(_mm_add_ps(depth, rainDepth), keepWater);
+            _mm_storeu_ps(d + i, depth);
+            deepestFour = _mm_max_ps(deepestFour, depth);
+        }
+#else
+        for (int i = first; i < first + TILE; ++i)
+        {
+            float inflow = right[i - 1] + left[i + 1] + up[i - STRIDE] + down[i + STRIDE];
+            float outflow = left[i] + right[i] + down[i] + up[i];
+            float depth = std::max(d[i] + dt * (inflow - outflow), 0.0f);
+
+            //The speed is the water that passes through the cell divided by the mean depth
+            float meanDepth = std::max(0.5f * (d[i] + depth), MIN_SPEED_DEPTH);
+            float speedX = 0.5f * (right[i - 1] - left[i] + right[i] - left[i + 1]) / meanDepth;
+            float speedY = 0.5f * (up[i - STRIDE] - down[i] + up[i] - down[i + STRIDE]) / meanDepth;
+            u[i] = speedX;
+            v[i] = speedY;
+
+            //Dissolves terrain if the water can carry more sediment than it has, and deposits sediment if it has too much
+            float capacity = sedimentCapacity * tilt[i] * std::sqrt(speedX * speedX + speedY * speedY)
+                * std::min(depth * shallow, 1.0f);
+            float missing = capacity - s[i];
+            float change = (missing > 0.0f ? dissolve : deposit) * missing;
+            b[i] -= change;
+            s[i] += change;
+
+            depth = (depth + rain) * keep;
+            d[i] = depth;
+            deepest = std::max(deepest, depth);
+        }
+#endif
+    }
+#ifdef EROSION_SSE2
+    float fourDepths[4];
+    _mm_storeu_ps(fourDepths, deepestFour);
+    deepest = std::max(std::max(fourDepths[0], fourDepths[1]), std::max(fourDepths[2], fourDepths[3]));
+#endif
+
+    //A tile that was wet and is dry now is published once more, so the renderer sees that the water is gone
+    bool wet = deepest > WET_DEPTH;
+    if (wet || tileWet[tile])
+        tileChanged[tile] = 1;
+    tileWet[tile] = wet;
+}
+
+void HydraulicErosion::transportPass(int tile)
+{
+    size_t base = static_cast<size_t>(tile) * STRIDE * STRIDE;
+    const float* s = sediment.data() + base;
+    const float* u = velocityX.data() + base;
+    const float* v = velocityY.data() + base;
+    float* moved = scratch.data() + base;
+    float* carried = sediment.data() + base;
+    const float dt = timeStep;
+
+    for (int j = 1; j <= TILE; ++j)
+    {
+        for (int i = 1; i <= TILE; ++i)
+        {
+            //The sediment comes from where the water was one step ago. The step is at most one cell, so the
+            //four cells around that point are always in the tile or in its halo.
+            int cell = j * STRIDE + i;
+            float x = i - std::min(std::max(u[cell] * dt, -1.0f), 1.0f);
+            float y = j - std::min(std::max(v[cell] * dt, -1.0f), 1.0f);
+            int x0 = std::min(static_cast<int>(x), TILE);
+            int y0 = std::min(static_cast<int>(y), TILE);
+            float fx = x - x0;
+            float fy = y - y0;
+            int corner = y0 * STRIDE + x0;
+            float bottom = s[corner] + (s[corner + 1] - s[corner]) * fx;
+            float top = s[corner + STRIDE] + (s[corner + STRIDE + 1] - s[corner + STRIDE]) * fx;
+            moved[cell] = bottom + (top - bottom) * fy;
+        }
+    }
+
+    //The halo is a copy, so the tile can take the new sediment right away without changing what the neighbours read
+    for (int j = 1; j <= TILE; ++j)
+        std::copy(moved + j * STRIDE + 1, moved + j * STRIDE + 1 + TILE, carried + j * STRIDE + 1);
+}
+
+void HydraulicErosion::exchangeHalos(ThreadPool& pool, std::initializer_list<std::vector<float>*> fields, Border border)
+{
+    pool.parallelFor(activeTiles.size(), TILE_BLOCK, [this, fields, border](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                for (std::vector<float>* field : fields)
+                    exchangeTile(activeTiles[i], *field, border);
+        });
+}
+
+void HydraulicErosion::exchangeTile(int tile, std::vector<float>& field, Border border)
+{
+    int tileX = tile % tilesX;
+    int tileY = tile / tilesX;
+    float* own = field.data() + static_cast<size_t>(tile) * STRIDE * STRIDE;
+    //The halo has eight parts, one for each neighbour tile: four edges and four corners
+    for (int dy = -1; dy <= 1; ++dy)
+    {
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            if (dx == 0 && dy == 0)
+                continue;
+            int firstX = dx < 0 ? 0 : (dx == 0 ? 1 : TILE + 1);
+            int lastX = dx < 0 ? 0 : (dx == 0 ? TILE : TILE + 1);
+            int firstY = dy < 0 ? 0 : (dy == 0 ? 1 : TILE + 1);
+            int lastY = dy < 0 ? 0 : (dy == 0 ? TILE : TILE + 1);
+
+            //Inside the grid a halo cell is the cell TILE cells away in the neighbour tile. Outside the grid it is
+            //the edge cell of this tile (one cell back) for CLAMP, or 0 for ZERO.
+            bool outsideX = tileX + dx < 0 || tileX + dx >= tilesX;
+            bool outsideY = tileY + dy < 0 || tileY + dy >= tilesY;
+            if ((outsideX || outsideY) && border == ZERO)
+            {
+                for (int j = firstY; j <= lastY; ++j)
+                    std::fill(own + j * STRIDE + firstX, own + j * STRIDE + lastX + 1, 0.0f);
+                continue;
+            }
+            int sourceX = outsideX ? tileX : tileX + dx;
+            int sourceY = outsideY ? tileY : tileY + dy;
+            int shift = (outsideY ? -dy : -dy * TILE) * STRIDE + (outsideX ? -dx : -dx * TILE);
+            const float* source = field.data() + static_cast<size_t>(sourceY * tilesX + sourceX) * STRIDE * STRIDE + shift;
+            for (int j = firstY; j <= lastY; ++j)
+                std::copy(source + j * STRIDE + firstX, source + j * STRIDE + lastX + 1, own + j * STRIDE + firstX);
+        }
+    }
+}
+
+void HydraulicErosion::addWater(float x, float y, float radius, float depth)
+{
+    int minX = std::max(static_cast<int>(std::floor(x - radius)), 0);
+    int maxX = std::min(static_cast<int>(std::ceil(x + radius)), width - 1);
+    int minY = std::max(static_cast<int>(std::floor(y - radius)), 0);
+    int maxY = std::min(static_cast<int>(std::ceil(y + radius)), height - 1);
+    for (int cellY = minY; cellY <= maxY; ++cellY)
+    {
+        for (int cellX = minX; cellX <= maxX; ++cellX)
+        {
+            float dx = cellX - x;
+            float dy = cellY - y;
+            if (dx * dx + dy * dy <= radius * radius)
+            {
+                water[cellIndex(cellX, cellY)] += depth / cellSize;
+                tileWet[(cellY / TILE) * tilesX + cellX / TILE] = 1;
+            }
+        }
+    }
+}
+
+float HydraulicErosion::terrainHeight(int x, int y) const
+{
+    return terrain[cellIndex(x, y)] * cellSize;
+}
+
+float HydraulicErosion::waterDepth(int x, int y) const
+{
+    return water[cellIndex(x, y)] * cellSize;
+}
+
+double HydraulicErosion::totalWater() const
+{
+    double total = 0.0;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            total += water[cellIndex(x, y)];
+    return total * cellSize;
+}
+
+void HydraulicErosion::publishTiles(ThreadPool& pool)
+{
+    std::unique_lock<std::mutex> lock(publishMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+    size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+    pool.parallelFor(tileCount, TILE_BLOCK, [this](size_t begin, size_t end)
+        {
+            for (size_t tile = begin; tile < end; ++tile)
+            {
+                if (!tileChanged[tile])
+                    continue;
+                const float* b = terrain.data() + tile * STRIDE * STRIDE;
+                const float* d = water.data() + tile * STRIDE * STRIDE;
+                float* out = publishedTiles.data() + tile * TILE * TILE * 2;
+                for (int j = 1; j <= TILE; ++j)
+                {
+                    for (int i = 1; i <= TILE; ++i)
+                    {
+                        *out++ = b[j * STRIDE + i] * cellSize;
+                        *out++ = d[j * STRIDE + i] * cellSize;
+                    }
+                }
+                tileChanged[tile] = 0;
+                publishedChanged[tile] = 1;
+            }
+        });
+}
+
+void HydraulicErosion::takeChangedTiles(const std::function<void(int, int, const float*)>& upload)
+{
+    std::lock_guard<std::mutex> lock(publishMutex);
+    for (size_t tile = 0; tile < publishedChanged.size(); ++tile)
+    {
+        if (!publishedChanged[tile])
+            continue;
+        upload(static_cast<int>(tile % tilesX), static_cast<int>(tile / tilesX), publishedTiles.data() + tile * TILE * TILE * 2);
+        publishedChanged[tile] = 0;
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef HYDRAULICEROSION_H
+#define HYDRAULICEROSION_H
+
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <initializer_list>
+#include "ThreadPool.h"
+
+//Water that flows over a height grid (a DEM) and erodes it, with the virtual pipe model.
+//Every cell has four pipes to its neighbours. The flow in a pipe is sped up by the difference in water level and
+//scaled down if it would take more water than the cell has. The flows move the water, the water speed gives how much
+//sediment the water can carry, and the water dissolves terrain when it carries less than that and deposits sediment
+//when it carries more. The sediment is moved with the water (semi-Lagrangian, from where the water came from).
+//All heights are stored in cells (height / cellSize), so the pipes have length 1 and the parameters do not depend on the
+//scale of the terrain.
+//The grid is split into tiles of TILE x TILE cells. Every tile has its own arrays with a halo of one cell around it, so a
+//tile is one block of memory, and the passes over a tile only read their own arrays. After each pass the halos are
+//copied from the neighbour tiles (the halo exchange). The passes and the exchanges are shared between the threads tile by
+//tile. The inner loops of the flux and water passes work on four cells at a time with SSE2.
+//Only tiles with water in them or next to them are simulated. When a tile dries up, the little water that is left
+//stops moving and the sediment in it is put down. The tiles that change are the only ones handed to the renderer.
+class HydraulicErosion
+{
+public:
+    static constexpr int TILE = 64;
+    //Cells in a row of a tile, with the halo
+    static constexpr int STRIDE = TILE + 2;
+
+    //In cells per second squared
+    float gravity;
+    //Water added to every cell per second while it rains, in cells
+    float rainRate;
+    bool raining;
+    //Part of the water that evaporates per second
+    float evaporation;
+    //How much sediment the water can carry for a given speed and slope
+    float sedimentCapacity;
+    //The part of the missing or extra sediment that is dissolved or deposited per second
+    float dissolving;
+    float deposition;
+    //Flat ground still gets some erosion, otherwise the water would not erode flat river beds
+    float minimumTilt;
+    //The water depth (in cells) where the erosion has full strength. A thin film of rain water runs fast but carries
+    //almost nothing, so the capacity is scaled down in shallower water.
+    float erosionDepth;
+    //The length of one simulation step in seconds
+    float timeStep;
+
+    //heights[y * width + x] in world units, width and height must be multiples of TILE
+    HydraulicErosion(const std::vector<float>& heights, int width, int height, float cellSize, float timeStep = 1.0f / 30.0f);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getTilesX() const { return tilesX; }
+    int getTilesY() const { return tilesY; }
+    float getCellSize() const { return cellSize; }
+
+    //Runs one time step, every pass is shared between the threads of the pool
+    void step(ThreadPool& pool);
+
+    //Pours water into a circle around the cell (x, y), depth in world units
+    void addWater(float x, float y, float radius, float depth);
+
+    //In world units
+    float terrainHeight(int x, int y) const;
+    float waterDepth(int x, int y) const;
+    double totalWater() const;
+
+    //Simulation thread: copies the terrain and water heights of the tiles that changed into the copy for the renderer.
+    //If the renderer is reading the copy right now the tiles wait for the next step, so the simulation never waits.
+    void publishTiles(ThreadPool& pool);
+    //Render thread: calls upload(tileX, tileY, data) for every tile that changed since the last call. data is TILE x TILE
+    //pairs of (terrain height, water depth) in world units, row by row.
+    void takeChangedTiles(const std::function<void(int, int, const float*)>& upload);
+
+private:
+    //What the halo gets outside the grid: a copy of the nearest cell, or 0
+    enum Border { CLAMP, ZERO };
+
+    size_t cellIndex(int x, int y) const;
+    //Makes the list of tiles to simulate in this step
+    void updateActiveTiles(ThreadPool& pool);
+    //Stops the water in a tile that has dried up and deposits its sediment
+    void settleTile(int tile);
+    void fluxPass(int tile);
+    void waterPass(int tile);
+    void transportPass(int tile);
+    void exchangeHalos(ThreadPool& pool, std::initializer_list<std::vector<float>*> fields, Border border);
+    void exchangeTile(int tile, std::vector<float>& field, Border border);
+
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+    float cellSize;
+
+    //Every field has STRIDE x STRIDE values per tile, tile after tile
+    std::vector<float> terrain, water, sediment;
+    //The flow out of each cell through the pipe to the left (-x), right (+x), down (-y) and up (+y) neighbour
+    std::vector<float> fluxLeft, fluxRight, fluxDown, fluxUp;
+    std::vector<float> velocityX, velocityY;
+    //The slope from the flux pass for the water pass, and then the moved sediment from the transport pass
+    std::vector<float> scratch;
+
+    //If the tile had water in the last step, if it is simulated, and if it has changed since it was last published
+    std::vector<char> tileWet;
+    std::vector<char> tileActive;
+    std::vector<char> tileChanged;
+    std::vector<int> activeTiles;
+
+    std::mutex publishMutex;
+    //TILE x TILE (terrain, water) pairs per tile
+    std::vector<float> publishedTiles;
+    std::vector<char> publishedChanged;
+};
+
+#endif
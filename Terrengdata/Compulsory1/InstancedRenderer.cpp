@@ -0,0 +1,88 @@
+#include "InstancedRenderer.h"
+#include <cmath>
+#include <cstddef>
+
+InstancedRenderer::InstancedRenderer(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices)
+    : indexCount(static_cast<GLsizei>(indices.size()))
+{
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    //Position and size in attribute 2 and the colour in attribute 3, both move on once per instance. They point into
+    //the stream buffer, so they are set in draw.
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+InstancedRenderer::~InstancedRenderer()
+{
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+}
+
+void InstancedRenderer::draw(StreamBuffer& stream)
+{
+    if (instances.empty())
+        return;
+
+    //The instances go into this frame's part of the stream buffer, and the instance attributes point at them there
+    GLintptr offset = stream.write(instances.data(), instances.size() * sizeof(Instance));
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.getBuffer());
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, position)));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, color)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(instances.size()));
+    glBindVertexArray(0);
+}
+
+void InstancedRenderer::sphere(int rings, int segments, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices)
+{
+    const float pi = 3.14159265f;
+    vertices.clear();
+    indices.clear();
+    for (int r = 0; r <= rings; ++r)
+    {
+        float theta = pi * r / rings;
+        for (int s = 0; s <= segments; ++s)
+        {
+            float phi = 2.0f * pi * s / segments;
+            vertices.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta)));
+        }
+    }
+    for (int r = 0; r < rings; ++r)
+    {
+        for (int s = 0; s < segments; ++s)
+        {
+            unsigned int a = r * (segments + 1) + s;
+            unsigned int b = a + segments + 1;
+            indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+}
+
+void InstancedRenderer::cube(std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices)
+{
+    vertices.clear();
+    indices.clear();
+    for (int corner = 0; corner < 8; ++corner)
+        vertices.push_back(glm::vec3((corner & 1) - 0.5f, ((corner >> 1) & 1) - 0.5f, ((corner >> 2) & 1) - 0.5f));
+    //Two triangles for each of the six sides
+    indices = { 0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5 };
+}
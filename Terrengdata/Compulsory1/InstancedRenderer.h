@@ -0,0 +1,50 @@
+#ifndef INSTANCEDRENDERER_H
+#define INSTANCEDRENDERER_H
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "StreamBuffer.h"
+
+//Draws one mesh many times with a single glDrawElementsInstanced call (instanced.vs).
+//Every instance has a position, a size and a colour. The instances are filled in on the CPU each frame and written
+//into the stream buffer, where the attribute divisor makes the shader move on to the next instance once per copy of
+//the mesh instead of once per vertex. So 100 000 balls cost one draw call instead of 100 000.
+//The mesh is around the origin with size 1, and its points are also used as the normals for the light.
+class InstancedRenderer
+{
+public:
+    struct Instance
+    {
+        glm::vec3 position;
+        float scale;
+        glm::vec4 color;
+    };
+    //The instances that the next draw uploads, the caller clears and fills it
+    std::vector<Instance> instances;
+
+    InstancedRenderer(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices);
+    ~InstancedRenderer();
+
+    InstancedRenderer(const InstancedRenderer&) = delete;
+    InstancedRenderer& operator=(const InstancedRenderer&) = delete;
+
+    void add(const glm::vec3& position, float scale, const glm::vec3& color)
+    {
+        instances.push_back({ position, scale, glm::vec4(color, 1.0f) });
+    }
+
+    //Writes the instances into the stream buffer and draws all of them. The instanced shader must be in use.
+    void draw(StreamBuffer& stream);
+
+    //A unit sphere made from rings and segments
+    static void sphere(int rings, int segments, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices);
+    //A cube from -0.5 to 0.5
+    static void cube(std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices);
+
+private:
+    GLuint VAO, VBO, EBO;
+    GLsizei indexCount;
+};
+
+#endif
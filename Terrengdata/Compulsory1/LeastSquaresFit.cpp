@@ -0,0 +1,262 @@
+#include "LeastSquaresFit.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+LeastSquaresFit::LeastSquaresFit(ThreadPool& pool, int cellsX, int cellsY, float smoothing)
+    : pool(pool), cellsX(cellsX), cellsY(cellsY), smoothing(smoothing)
+{
+}
+
+SplineLattice LeastSquaresFit::fit(const std::vector<glm::vec3>& points, FitReport& report)
+{
+    //Without points there is nothing to fit, the lattice is empty and so is the report
+    if (points.empty())
+    {
+        report = FitReport();
+        return SplineLattice();
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    //The lattice covers the bounding rectangle of the points
+    glm::vec2 minCorner(points[0].x, points[0].y);
+    glm::vec2 maxCorner = minCorner;
+    double heightSum = 0.0;
+    for (const glm::vec3& point : points)
+    {
+        minCorner = glm::min(minCorner, glm::vec2(point.x, point.y));
+        maxCorner = glm::max(maxCorner, glm::vec2(point.x, point.y));
+        heightSum += point.z;
+    }
+    //The heights are fitted around their mean, which keeps the numbers in the solver small
+    float meanHeight = static_cast<float>(heightSum / points.size());
+
+    SplineLattice lattice(minCorner, maxCorner, cellsX, cellsY);
+    width = lattice.latticeWidth();
+    height = lattice.latticeHeight();
+    size_t unknowns = static_cast<size_t>(width) * height;
+    matrix.assign(unknowns * 49, 0.0);
+    rhs.assign(unknowns, 0.0);
+
+    assemble(lattice, points, meanHeight);
+    float pointsPerControlPoint = static_cast<float>(points.size()) / unknowns;
+    addSmoothing(smoothing * std::max(pointsPerControlPoint, 1.0f));
+
+    std::vector<double> solution(unknowns, 0.0);
+    double relativeResidual = 0.0;
+    int iterations = solve(solution, relativeResidual);
+
+    for (size_t i = 0; i < unknowns; ++i)
+        lattice.controlHeights[i] = static_cast<float>(solution[i]) + meanHeight;
+
+    report.iterations = iterations;
+    report.relativeResidual = relativeResidual;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.measureError(lattice, points, pool);
+    return lattice;
+}
+
+void LeastSquaresFit::assemble(const SplineLattice& lattice, const std::vector<glm::vec3>& points, float meanHeight)
+{
+    //Sorts the points by cell row, so the rows can be shared between the threads
+    std::vector<unsigned int> rowStart;
+    std::vector<unsigned int> order;
+    lattice.sortPointsByCellRow(points, rowStart, order);
+
+    //A cell row writes to 4 control point rows. Blocks of 4 cell rows therefore write to 7 control point rows,
+    //and blocks with an even number never overlap each other, and neither do the odd ones.
+    //The even blocks are done in parallel first, then the odd blocks.
+    const int rowsPerBlock = 4;
+    int blocks = (cellsY + rowsPerBlock - 1) / rowsPerBlock;
+    for (int phase = 0; phase < 2; ++phase)
+    {
+        int phaseBlocks = (blocks - phase + 1) / 2;
+        pool.parallelFor(phaseBlocks, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t b = begin; b < end; ++b)
+            {
+                int block = static_cast<int>(b) * 2 + phase;
+                int lastRow = std::min((block + 1) * rowsPerBlock, cellsY);
+                for (unsigned int k = rowStart[block * rowsPerBlock]; k < rowStart[lastRow]; ++k)
+                {
+                    const glm::vec3& point = points[order[k]];
+                    int cellX, cellY;
+                    float s, t;
+                    lattice.locate(point.x, point.y, cellX, cellY, s, t);
+                    float bx[4], by[4];
+                    SplineLattice::basis(s, bx);
+                    SplineLattice::basis(t, by);
+
+                    float weights[16];
+                    for (int a = 0; a < 4; ++a)
+                        for (int c = 0; c < 4; ++c)
+                            weights[a * 4 + c] = by[a] * bx[c];
+
+                    float z = point.z - meanHeight;
+                    for (int e = 0; e < 16; ++e)
+                    {
+                        int ea = e / 4, ec = e % 4;
+                        size_t row = static_cast<size_t>(cellY + ea) * width + cellX + ec;
+                        rhs[row] += static_cast<double>(weights[e]) * z;
+                        double* stencil = &matrix[row * 49];
+                        for (int f = 0; f < 16; ++f)
+                            stencil[stencilIndex(f / 4 - ea, f % 4 - ec)] += static_cast<double>(weights[e]) * weights[f];
+                    }
+                }
+            }
+        });
+    }
+}
+
+void LeastSquaresFit::addSmoothing(float weight)
+{
+    //Adds weight * (sum of w_k * c_k)^2 for a small set of control points to the normal equations
+    auto addTerm = [&](const int* rows, const int* columns, const float* w, int count, float termWeight)
+    {
+        for (int p = 0; p < count; ++p)
+        {
+            double* stencil = &matrix[(static_cast<size_t>(rows[p]) * width + columns[p]) * 49];
+            for (int q = 0; q < count; ++q)
+                stencil[stencilIndex(rows[q] - rows[p], columns[q] - columns[p])] += static_cast<double>(termWeight) * w[p] * w[q];
+        }
+    };
+
+    const float second[3] = { 1.0f, -2.0f, 1.0f };
+    const float cross[4] = { 1.0f, -1.0f, -1.0f, 1.0f };
+    for (int i = 0; i < height; ++i)
+    {
+        for (int j = 0; j < width; ++j)
+        {
+            //Second difference in x, in y, and the mixed difference (counted twice in the thin plate energy)
+            if (j > 0 && j < width - 1)
+            {
+                int rows[3] = { i, i, i };
+                int columns[3] = { j - 1, j, j + 1 };
+                addTerm(rows, columns, second, 3, weight);
+            }
+            if (i > 0 && i < height - 1)
+            {
+                int rows[3] = { i - 1, i, i + 1 };
+                int columns[3] = { j, j, j };
+                addTerm(rows, columns, second, 3, weight);
+            }
+            if (i < height - 1 && j < width - 1)
+            {
+                int rows[4] = { i, i, i + 1, i + 1 };
+                int columns[4] = { j, j + 1, j, j + 1 };
+                addTerm(rows, columns, cross, 4, 2.0f * weight);
+            }
+        }
+    }
+
+    //A very small ridge on the diagonal keeps the matrix positive definite when the smoothing is 0
+    double diagonalSum = 0.0;
+    size_t unknowns = static_cast<size_t>(width) * height;
+    for (size_t i = 0; i < unknowns; ++i)
+        diagonalSum += matrix[i * 49 + stencilIndex(0, 0)];
+    double ridge = 1e-6 * std::max(diagonalSum / unknowns, 1e-12);
+    for (size_t i = 0; i < unknowns; ++i)
+        matrix[i * 49 + stencilIndex(0, 0)] += ridge;
+}
+
+void LeastSquaresFit::multiply(const std::vector<double>& x, std::vector<double>& result)
+{
+    pool.parallelFor(height, 8, [&](size_t begin, size_t end)
+    {
+        for (int i = static_cast<int>(begin); i < static_cast<int>(end); ++i)
+        {
+            int firstDy = std::max(-3, -i);
+            int lastDy = std::min(3, height - 1 - i);
+            for (int j = 0; j < width; ++j)
+            {
+                int firstDx = std::max(-3, -j);
+                int lastDx = std::min(3, width - 1 - j);
+                size_t row = static_cast<size_t>(i) * width + j;
+                const double* stencil = &matrix[row * 49];
+                double sum = 0.0;
+                for (int dy = firstDy; dy <= lastDy; ++dy)
+                {
+                    const double* neighbours = &x[row + static_cast<ptrdiff_t>(dy) * width];
+                    for (int dx = firstDx; dx <= lastDx; ++dx)
+                        sum += stencil[stencilIndex(dy, dx)] * neighbours[dx];
+                }
+                result[row] = sum;
+            }
+        }
+    });
+}
+
+double LeastSquaresFit::dot(const std::vector<double>& a, const std::vector<double>& b)
+{
+    const size_t blockSize = 1 << 14;
+    std::vector<double> partial((a.size() + blockSize - 1) / blockSize, 0.0);
+    pool.parallelFor(a.size(), blockSize, [&](size_t begin, size_t end)
+    {
+        double sum = 0.0;
+        for (size_t i = begin; i < end; ++i)
+            sum += a[i] * b[i];
+        partial[begin / blockSize] = sum;
+    });
+    double sum = 0.0;
+    for (double value : partial)
+        sum += value;
+    return sum;
+}
+
+int LeastSquaresFit::solve(std::vector<double>& x, double& relativeResidual)
+{
+    //Preconditioned conjugate gradient, starting from x = 0 so the first residual is the right hand side
+    size_t unknowns = x.size();
+    std::vector<double> inverseDiagonal(unknowns);
+    for (size_t i = 0; i < unknowns; ++i)
+        inverseDiagonal[i] = 1.0 / matrix[i * 49 + stencilIndex(0, 0)];
+
+    std::vector<double> r(rhs);
+    std::vector<double> z(unknowns);
+    std::vector<double> p(unknowns);
+    std::vector<double> q(unknowns);
+    for (size_t i = 0; i < unknowns; ++i)
+        z[i] = inverseDiagonal[i] * r[i];
+    p = z;
+
+    double rhsNorm = std::sqrt(dot(rhs, rhs));
+    if (rhsNorm == 0.0)
+    {
+        relativeResidual = 0.0;
+        return 0;
+    }
+    double rz = dot(r, z);
+    const size_t blockSize = 1 << 14;
+
+    int iteration = 0;
+    relativeResidual = 1.0;
+    while (iteration < maxIterations)
+    {
+        multiply(p, q);
+        double alpha = rz / dot(p, q);
+        pool.parallelFor(unknowns, blockSize, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                x[i] += alpha * p[i];
+                r[i] -= alpha * q[i];
+                z[i] = inverseDiagonal[i] * r[i];
+            }
+        });
+        ++iteration;
+
+        relativeResidual = std::sqrt(dot(r, r)) / rhsNorm;
+        if (relativeResidual < tolerance)
+            break;
+
+        double rzNext = dot(r, z);
+        double beta = rzNext / rz;
+        rz = rzNext;
+        pool.parallelFor(unknowns, blockSize, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                p[i] = z[i] + beta * p[i];
+        });
+    }
+    return iteration;
+}
@@ -0,0 +1,54 @@
+#ifndef LEASTSQUARESFIT_H
+#define LEASTSQUARESFIT_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "SplineLattice.h"
+#include "FitReport.h"
+#include "ThreadPool.h"
+
+//Fits a bicubic B-spline height field to the terrain points with least squares.
+//Minimizes the sum of (surface(x, y) - z)^2 over all points plus a smoothing term, the squared second
+//differences of the control heights (a discrete thin plate energy). The smoothing also gives a value to
+//control points that have no points under them.
+//Every point only touches 4x4 control points, so the normal equations are banded: each row has at most
+//7x7 non-zero values, which are stored as a stencil per control point. The system is solved with the
+//conjugate gradient method and a Jacobi (diagonal) preconditioner, and both the assembly and the solver
+//are shared between the threads of the pool.
+class LeastSquaresFit
+{
+public:
+    //smoothing is relative to the average number of points per control point, so the same value
+    //works for small and large point sets
+    LeastSquaresFit(ThreadPool& pool, int cellsX, int cellsY, float smoothing);
+
+    SplineLattice fit(const std::vector<glm::vec3>& points, FitReport& report);
+
+    int maxIterations = 1000;
+    //The solver stops when |b - Ax| / |b| is below this value
+    double tolerance = 1e-6;
+
+private:
+    //Index of the (dy, dx) neighbour in the 7x7 stencil of a control point, dy and dx from -3 to 3
+    static int stencilIndex(int dy, int dx) { return (dy + 3) * 7 + dx + 3; }
+
+    void assemble(const SplineLattice& lattice, const std::vector<glm::vec3>& points, float meanHeight);
+    void addSmoothing(float weight);
+    void multiply(const std::vector<double>& x, std::vector<double>& result);
+    double dot(const std::vector<double>& a, const std::vector<double>& b);
+    int solve(std::vector<double>& x, double& relativeResidual);
+
+    ThreadPool& pool;
+    int cellsX;
+    int cellsY;
+    float smoothing;
+
+    int width = 0;
+    int height = 0;
+    //49 values per control point, the rows of the normal matrix. Millions of small products are added into each
+    //diagonal value, so they are summed in double to not lose the small ones.
+    std::vector<double> matrix;
+    std::vector<double> rhs;
+};
+
+#endif
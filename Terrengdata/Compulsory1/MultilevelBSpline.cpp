@@ -0,0 +1,170 @@
+#include "MultilevelBSpline.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+MultilevelBSpline::MultilevelBSpline(ThreadPool& pool, int startCellsX, int startCellsY, int levels)
+    : pool(pool), startCellsX(startCellsX), startCellsY(startCellsY), levels(levels)
+{
+}
+
+SplineLattice MultilevelBSpline::approximate(const std::vector<glm::vec3>& points, FitReport& report, const LevelCallback& onLevel)
+{
+    //Without points there is nothing to fit, the lattice is empty and so is the report
+    if (points.empty())
+    {
+        report = FitReport();
+        return SplineLattice();
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    glm::vec2 minCorner(points[0].x, points[0].y);
+    glm::vec2 maxCorner = minCorner;
+    for (const glm::vec3& point : points)
+    {
+        minCorner = glm::min(minCorner, glm::vec2(point.x, point.y));
+        maxCorner = glm::max(maxCorner, glm::vec2(point.x, point.y));
+    }
+
+    //The part of each height that the levels so far have not explained
+    std::vector<float> residual(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        residual[i] = points[i].z;
+
+    const size_t blockSize = 1 << 16;
+    size_t blocks = (points.size() + blockSize - 1) / blockSize;
+    std::vector<double> squaredSums(blocks);
+    std::vector<double> absSums(blocks);
+    std::vector<float> maxima(blocks);
+
+    SplineLattice merged;
+    int cellsX = startCellsX;
+    int cellsY = startCellsY;
+    for (int level = 0; level < levels; ++level)
+    {
+        SplineLattice levelLattice = approximateLevel(points, residual, minCorner, maxCorner, cellsX, cellsY);
+
+        //Removes this level from the residual. Every point is independent, so the points are shared between the threads,
+        //and the error of the merged surface is measured at the same time.
+        pool.parallelFor(points.size(), blockSize, [&](size_t begin, size_t end)
+        {
+            size_t block = begin / blockSize;
+            double squaredSum = 0.0, absSum = 0.0;
+            float maximum = 0.0f;
+            for (size_t i = begin; i < end; ++i)
+            {
+                residual[i] -= levelLattice.evaluate(points[i].x, points[i].y);
+                float error = std::fabs(residual[i]);
+                squaredSum += static_cast<double>(error) * error;
+                absSum += error;
+                maximum = std::max(maximum, error);
+            }
+            squaredSums[block] = squaredSum;
+            absSums[block] = absSum;
+            maxima[block] = maximum;
+        });
+
+        //The sum of the levels so far, on the lattice of this level
+        if (level == 0)
+        {
+            merged = levelLattice;
+        }
+        else
+        {
+            merged = merged.refined();
+            for (size_t i = 0; i < merged.controlHeights.size(); ++i)
+                merged.controlHeights[i] += levelLattice.controlHeights[i];
+        }
+
+        double squaredSum = 0.0, absSum = 0.0;
+        report.maxError = 0.0f;
+        for (size_t block = 0; block < blocks; ++block)
+        {
+            squaredSum += squaredSums[block];
+            absSum += absSums[block];
+            report.maxError = std::max(report.maxError, maxima[block]);
+        }
+        report.pointCount = points.size();
+        report.controlPointCount = merged.controlHeights.size();
+        report.iterations = level + 1;
+        report.relativeResidual = 0.0;
+        report.rmsError = static_cast<float>(std::sqrt(squaredSum / points.size()));
+        report.meanAbsError = static_cast<float>(absSum / points.size());
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (onLevel && !onLevel(level, merged, report))
+            break;
+
+        cellsX *= 2;
+        cellsY *= 2;
+    }
+    return merged;
+}
+
+SplineLattice MultilevelBSpline::approximateLevel(const std::vector<glm::vec3>& points, const std::vector<float>& residual,
+    const glm::vec2& minCorner, const glm::vec2& maxCorner, int cellsX, int cellsY)
+{
+    SplineLattice lattice(minCorner, maxCorner, cellsX, cellsY);
+    int width = lattice.latticeWidth();
+    size_t controlPoints = lattice.controlHeights.size();
+    //delta is the weighted sum of the values each point wants for a control point, omega is the sum of the weights
+    std::vector<float> delta(controlPoints, 0.0f);
+    std::vector<float> omega(controlPoints, 0.0f);
+
+    std::vector<unsigned int> rowStart;
+    std::vector<unsigned int> order;
+    lattice.sortPointsByCellRow(points, rowStart, order);
+
+    //Blocks of 4 cell rows write to 7 control point rows, so the even blocks and the odd blocks never overlap
+    const int rowsPerBlock = 4;
+    int blocks = (cellsY + rowsPerBlock - 1) / rowsPerBlock;
+    for (int phase = 0; phase < 2; ++phase)
+    {
+        int phaseBlocks = (blocks - phase + 1) / 2;
+        pool.parallelFor(phaseBlocks, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t b = begin; b < end; ++b)
+            {
+                int block = static_cast<int>(b) * 2 + phase;
+                int lastRow = std::min((block + 1) * rowsPerBlock, cellsY);
+                for (unsigned int k = rowStart[block * rowsPerBlock]; k < rowStart[lastRow]; ++k)
+                {
+                    unsigned int p = order[k];
+                    int cellX, cellY;
+                    float s, t;
+                    lattice.locate(points[p].x, points[p].y, cellX, cellY, s, t);
+                    float bx[4], by[4];
+                    SplineLattice::basis(s, bx);
+                    SplineLattice::basis(t, by);
+
+                    float weights[16];
+                    float weightSum = 0.0f;
+                    for (int a = 0; a < 4; ++a)
+                    {
+                        for (int c = 0; c < 4; ++c)
+                        {
+                            weights[a * 4 + c] = by[a] * bx[c];
+                            weightSum += weights[a * 4 + c] * weights[a * 4 + c];
+                        }
+                    }
+
+                    //The control values that reproduce this point alone with the smallest change (phi = w * z / sum w^2),
+                    //each added with the weight w^2
+                    for (int e = 0; e < 16; ++e)
+                    {
+                        size_t index = static_cast<size_t>(cellY + e / 4) * width + cellX + e % 4;
+                        float w = weights[e];
+                        float phi = w * residual[p] / weightSum;
+                        delta[index] += w * w * phi;
+                        omega[index] += w * w;
+                    }
+                }
+            }
+        });
+    }
+
+    //Control points without any points near them stay at 0, which means no change to the levels before
+    for (size_t i = 0; i < controlPoints; ++i)
+        lattice.controlHeights[i] = omega[i] > 0.0f ? delta[i] / omega[i] : 0.0f;
+    return lattice;
+}
@@ -0,0 +1,39 @@
+#ifndef MULTILEVELBSPLINE_H
+#define MULTILEVELBSPLINE_H
+
+#include <vector>
+#include <functional>
+#include <glm/glm.hpp>
+#include "SplineLattice.h"
+#include "FitReport.h"
+#include "ThreadPool.h"
+
+//Multilevel B-spline approximation (Lee, Wolberg and Shin 1997) of scattered terrain points.
+//The first level is a coarse bicubic lattice that follows the points loosely. Every next level has twice as
+//many cells in each direction and is fitted to what is left (the residual) after the levels before it.
+//Each level is a direct weighted average over the points in each cell, no equation system is solved,
+//so a level costs O(points + control points). The levels are merged into one lattice by refining the
+//sum of the coarse levels and adding the next level, so the result is a single SplineLattice.
+class MultilevelBSpline
+{
+public:
+    MultilevelBSpline(ThreadPool& pool, int startCellsX, int startCellsY, int levels);
+
+    //Called after each level with the level number and the merged lattice so far. Return false to stop
+    //at this level, which gives a quick preview with fewer details.
+    using LevelCallback = std::function<bool(int level, const SplineLattice& lattice, const FitReport& report)>;
+
+    SplineLattice approximate(const std::vector<glm::vec3>& points, FitReport& report, const LevelCallback& onLevel = LevelCallback());
+
+private:
+    //One level of B-spline approximation of the residual heights
+    SplineLattice approximateLevel(const std::vector<glm::vec3>& points, const std::vector<float>& residual,
+        const glm::vec2& minCorner, const glm::vec2& maxCorner, int cellsX, int cellsY);
+
+    ThreadPool& pool;
+    int startCellsX;
+    int startCellsY;
+    int levels;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "ProfilerOverlay.h"
+#include <cstdio>
+#include <cctype>
+#include <vector>
+
+//The 5 x 7 font, one byte per row from the top, the highest of the five bits is the left pixel
+struct Glyph
+{
+    char character;
+    unsigned char rows[7];
+};
+static const Glyph FONT[] = {
+    { ' ', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+    { '%', { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 } },
+    { '(', { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 } },
+    { ')', { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 } },
+    { ',', { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 } },
+    { '-', { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 } },
+    { '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C } },
+    { '/', { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 } },
+    { '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+    { '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+    { '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+    { '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+    { '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+    { '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+    { '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+    { '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+    { '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+    { '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+    { ':', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 } },
+    { '=', { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 } },
+    { 'A', { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+    { 'B', { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E } },
+    { 'C', { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E } },
+    { 'D', { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C } },
+    { 'E', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F } },
+    { 'F', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 } },
+    { 'G', { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F } },
+    { 'H', { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+    { 'I', { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+    { 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C } },
+    { 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } },
+    { 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F } },
+    { 'M', { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+    { 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+    { 'O', { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+    { 'P', { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 } },
+    { 'Q', { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D } },
+    { 'R', { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 } },
+    { 'S', { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E } },
+    { 'T', { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+    { 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+    { 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 } },
+    { 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A } },
+    { 'X', { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 } },
+    { 'Y', { 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04 } },
+    { 'Z', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F } },
+    { '_', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F } },
+};
+
+static const unsigned char* findGlyph(char character)
+{
+    char upper = static_cast<char>(std::toupper(static_cast<unsigned char>(character)));
+    for (const Glyph& glyph : FONT)
+        if (glyph.character == upper)
+            return glyph.rows;
+    return nullptr;
+}
+
+ProfilerOverlay::ProfilerOverlay(float pixelSize) : pixelSize(pixelSize)
+{
+    //The cube is drawn flat, its front is the square
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+    InstancedRenderer::cube(vertices, indices);
+    squares.reset(new InstancedRenderer(vertices, indices));
+}
+
+void ProfilerOverlay::addText(const std::string& text, float x, float y, const glm::vec3& color)
+{
+    for (char character : text)
+    {
+        const unsigned char* rows = findGlyph(character);
+        if (rows != nullptr)
+            for (int row = 0; row < 7; ++row)
+                for (int column = 0; column < 5; ++column)
+                    if (rows[row] & (0x10 >> column))
+                        squares->add(glm::vec3(x + column * pixelSize, y + row * pixelSize, 0.0f), pixelSize, color);
+        x += 6.0f * pixelSize;
+    }
+}
+
+void ProfilerOverlay::draw(const Profiler& profiler, Shader& shader, StreamBuffer& stream, int width, int height)
+{
+    squares->instances.clear();
+    std::vector<std::string> lines;
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-16s %7s %7s %7s", "MS", "P50", "P95", "P99");
+    lines.push_back(line);
+    for (const Profiler::Statistics& statistics : profiler.statistics())
+    {
+        std::string name = (statistics.gpu ? "GPU " : "") + statistics.name;
+        std::snprintf(line, sizeof(line), "%-16.16s %7.2f %7.2f %7.2f", name.c_str(), statistics.p50, statistics.p95, statistics.p99);
+        lines.push_back(line);
+    }
+
+    //Every line is drawn with a dark shadow, so it can be read on a light background
+    float lineHeight = 9.0f * pixelSize;
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        float y = 10.0f + i * lineHeight;
+        addText(lines[i], 10.0f + pixelSize, y + pixelSize, glm::vec3(0.0f));
+        addText(lines[i], 10.0f, y, i == 0 ? glm::vec3(1.0f, 1.0f, 1.0f) : glm::vec3(1.0f, 0.9f, 0.2f));
+    }
+
+    glDisable(GL_DEPTH_TEST);
+    shader.use();
+    shader.setVec2("screenSize", glm::vec2(static_cast<float>(width), static_cast<float>(height)));
+    squares->draw(stream);
+    glEnable(GL_DEPTH_TEST);
+}
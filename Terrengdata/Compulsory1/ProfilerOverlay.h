@@ -0,0 +1,33 @@
+#ifndef PROFILEROVERLAY_H
+#define PROFILEROVERLAY_H
+
+#include <string>
+#include <memory>
+#include <glm/glm.hpp>
+#include "Profiler.h"
+#include "InstancedRenderer.h"
+#include "StreamBuffer.h"
+#include "Shader.h"
+
+//Shows the percentiles of the profiler in the top left corner of the window.
+//The letters come from a 5 x 7 pixel font, and every lit pixel is an instance of a square, so the whole overlay is
+//one instanced draw call with overlay.vs. The letters are upper case, lower case is shown as upper case.
+class ProfilerOverlay
+{
+public:
+    //The size of a font pixel on the screen, in pixels
+    float pixelSize;
+
+    ProfilerOverlay(float pixelSize = 2.0f);
+
+    //Draws the table for the profiler. The shader must be made from overlay.vs and fs.fs.
+    void draw(const Profiler& profiler, Shader& shader, StreamBuffer& stream, int width, int height);
+
+private:
+    //Adds the squares of a line of text, x and y is the top left corner in pixels
+    void addText(const std::string& text, float x, float y, const glm::vec3& color);
+
+    std::unique_ptr<InstancedRenderer> squares;
+};
+
+#endif
@@ -6,11 +6,21 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 
 //Libraries added myself
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+
+//The location of a uniform, looked up once. The type decides which glUniform call Shader::set makes, so a
+//Uniform<glm::mat4> can only be given a matrix.
+template<typename T>
+struct Uniform
+{
+    GLint location = -1;
+};
+
 class Shader
 {
 public:
@@ -20,8 +30,44 @@ public:
 
     // constructor reads and builds the shader
     Shader(const char* vertexPath, const char* fragmentPath);
+    //Takes over a program that is already linked, for programs made by the ShaderManager
+    explicit Shader(GLuint program);
+    //Compiles the two sources and links them into a program, and prints the errors if any. beforeLink can set
+    //program parameters that must be set before the link.
+    static GLuint compileProgram(const std::string& vertexCode, const std::string& fragmentCode,
+        void (*beforeLink)(GLuint) = nullptr);
+    //The same in two halves. beginProgram only hands the work to the driver, and finishProgram waits for it, prints
+    //the errors and deletes the shader objects. Programs started together can then compile on the driver's threads.
+    static GLuint beginProgram(const std::string& vertexCode, const std::string& fragmentCode,
+        void (*beforeLink)(GLuint) = nullptr);
+    static bool finishProgram(GLuint program);
     // use/activate the shader
     void use();
+    //The location of a uniform from the table that is made when the program is linked, -1 if the program does not
+    //have it (glUniform ignores -1, the same as with glGetUniformLocation)
+    GLint location(const std::string& name) const
+    {
+        auto found = uniformLocations.find(name);
+        return found == uniformLocations.end() ? -1 : found->second;
+    }
+    //A typed handle for a uniform. Handles are meant to be made once, and setting them each frame does no lookup at all.
+    template<typename T>
+    Uniform<T> uniform(const std::string& name) const
+    {
+        Uniform<T> handle;
+        handle.location = location(name);
+        return handle;
+    }
+    //Set a uniform through its handle, the shader must be in use
+    void set(Uniform<bool> uniform, bool value) const { glUniform1i(uniform.location, (int)value); }
+    void set(Uniform<int> uniform, int value) const { glUniform1i(uniform.location, value); }
+    void set(Uniform<float> uniform, float value) const { glUniform1f(uniform.location, value); }
+    void set(Uniform<glm::vec2> uniform, const glm::vec2& value) const { glUniform2fv(uniform.location, 1, &value[0]); }
+    void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const { glUniform3fv(uniform.location, 1, &value[0]); }
+    void set(Uniform<glm::vec4> uniform, const glm::vec4& value) const { glUniform4fv(uniform.location, 1, &value[0]); }
+    void set(Uniform<glm::mat3> uniform, const glm::mat3& mat) const { glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+    void set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const { glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+
     // utility uniform functions
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
@@ -32,44 +78,50 @@ public:
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(location(name), 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(location(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(location(name), 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(location(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(location(name), 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(location(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
+
+private:
+    //Finds the locations of all active uniforms, and connects the Camera block to the camera uniform buffer
+    void linkUniforms();
+
+    std::unordered_map<std::string, GLint> uniformLocations;
 };
 #endif
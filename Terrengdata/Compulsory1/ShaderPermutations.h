@@ -0,0 +1,40 @@
+#ifndef SHADERPERMUTATIONS_H
+#define SHADERPERMUTATIONS_H
+
+#include <string>
+#include <vector>
+#include "ShaderManager.h"
+
+//One pair of shader files with features that can be turned on and off. Every feature is a bit in a mask and a
+//#define in the sources, and every mask gets its own program. The shaders test the features with #ifdef, so each
+//draw runs a shader without branches for the modes it does not use.
+//The variants are made by the ShaderManager the first time they are asked for, or before that with prepare.
+class ShaderPermutations
+{
+public:
+    //featureDefines[i] is the name that is defined when bit i of the mask is set
+    ShaderPermutations(ShaderManager& shaders, const std::string& vertexPath, const std::string& fragmentPath,
+        const std::vector<std::string>& featureDefines);
+
+    //The variant for the features, it waits for the compiler if the variant is not ready.
+    //A mask with bits above the last feature throws std::out_of_range, here and in prepare and ready.
+    Shader& get(unsigned int features);
+    //Starts compiling the variant in the background, when the driver can compile in parallel
+    void prepare(unsigned int features);
+    bool ready(unsigned int features);
+
+    //The #define lines for the features
+    std::string defines(unsigned int features) const;
+    //The number of masks, one more than the highest mask
+    size_t variantCount() const { return variants.size(); }
+
+private:
+    ShaderManager& shaders;
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> featureDefines;
+    //The variants that have been asked for, found without going through the names in the manager
+    std::vector<Shader*> variants;
+};
+
+#endif
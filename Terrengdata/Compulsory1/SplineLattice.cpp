@@ -0,0 +1,139 @@
+#include "SplineLattice.h"
+#include <algorithm>
+#include <cmath>
+
+SplineLattice::SplineLattice() : origin(0.0f), cellSize(1.0f), cellsX(0), cellsY(0)
+{
+}
+
+SplineLattice::SplineLattice(const glm::vec2& minCorner, const glm::vec2& maxCorner, int cellsX, int cellsY)
+    : origin(minCorner), cellsX(cellsX), cellsY(cellsY)
+{
+    //Points on a line or in one spot have no size in one direction, and the cells would have no size to divide by
+    glm::vec2 extent = glm::max(maxCorner - minCorner, glm::vec2(1e-6f));
+    cellSize = glm::vec2(extent.x / cellsX, extent.y / cellsY);
+    controlHeights.assign(latticeWidth() * latticeHeight(), 0.0f);
+}
+
+void SplineLattice::locate(float x, float y, int& cellX, int& cellY, float& s, float& t) const
+{
+    float gx = (x - origin.x) / cellSize.x;
+    float gy = (y - origin.y) / cellSize.y;
+    cellX = std::min(std::max(static_cast<int>(std::floor(gx)), 0), cellsX - 1);
+    cellY = std::min(std::max(static_cast<int>(std::floor(gy)), 0), cellsY - 1);
+    s = std::min(std::max(gx - cellX, 0.0f), 1.0f);
+    t = std::min(std::max(gy - cellY, 0.0f), 1.0f);
+}
+
+void SplineLattice::basis(float t, float* weights)
+{
+    float s = 1.0f - t;
+    weights[0] = s * s * s / 6.0f;
+    weights[1] = (3.0f * t * t * t - 6.0f * t * t + 4.0f) / 6.0f;
+    weights[2] = (-3.0f * t * t * t + 3.0f * t * t + 3.0f * t + 1.0f) / 6.0f;
+    weights[3] = t * t * t / 6.0f;
+}
+
+float SplineLattice::evaluate(float x, float y) const
+{
+    int cellX, cellY;
+    float s, t;
+    locate(x, y, cellX, cellY, s, t);
+    float bx[4], by[4];
+    basis(s, bx);
+    basis(t, by);
+
+    int width = latticeWidth();
+    float height = 0.0f;
+    for (int a = 0; a < 4; ++a)
+    {
+        const float* row = &controlHeights[(cellY + a) * width + cellX];
+        height += by[a] * (bx[0] * row[0] + bx[1] * row[1] + bx[2] * row[2] + bx[3] * row[3]);
+    }
+    return height;
+}
+
+void SplineLattice::sortPointsByCellRow(const std::vector<glm::vec3>& points, std::vector<unsigned int>& rowStart, std::vector<unsigned int>& order) const
+{
+    rowStart.assign(cellsY + 1, 0);
+    std::vector<int> pointRow(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        int cellX, cellY;
+        float s, t;
+        locate(points[i].x, points[i].y, cellX, cellY, s, t);
+        pointRow[i] = cellY;
+        ++rowStart[cellY + 1];
+    }
+    for (int row = 0; row < cellsY; ++row)
+        rowStart[row + 1] += rowStart[row];
+
+    order.resize(points.size());
+    std::vector<unsigned int> fill(rowStart.begin(), rowStart.end() - 1);
+    for (size_t i = 0; i < points.size(); ++i)
+        order[fill[pointRow[i]]++] = static_cast<unsigned int>(i);
+}
+
+//One dimensional cubic B-spline subdivision. Fine control point f is made from the coarse control points
+//around it: (c[i-1] + 6c[i] + c[i+1]) / 8 when f is odd (i = (f + 1) / 2), (c[i] + c[i+1]) / 2 when f is even (i = f / 2)
+static float subdivide(const float* coarse, int stride, int fine)
+{
+    if (fine % 2 == 1)
+    {
+        int i = (fine + 1) / 2;
+        return (coarse[(i - 1) * stride] + 6.0f * coarse[i * stride] + coarse[(i + 1) * stride]) / 8.0f;
+    }
+    int i = fine / 2;
+    return (coarse[i * stride] + coarse[(i + 1) * stride]) / 2.0f;
+}
+
+SplineLattice SplineLattice::refined() const
+{
+    SplineLattice fine;
+    fine.origin = origin;
+    fine.cellSize = cellSize * 0.5f;
+    fine.cellsX = cellsX * 2;
+    fine.cellsY = cellsY * 2;
+
+    //Subdivides the rows first and then the columns, the tensor product of the 1D rule
+    int width = latticeWidth();
+    int fineWidth = fine.latticeWidth();
+    std::vector<float> rows(static_cast<size_t>(latticeHeight()) * fineWidth);
+    for (int i = 0; i < latticeHeight(); ++i)
+        for (int j = 0; j < fineWidth; ++j)
+            rows[i * fineWidth + j] = subdivide(&controlHeights[i * width], 1, j);
+
+    fine.controlHeights.resize(static_cast<size_t>(fine.latticeHeight()) * fineWidth);
+    for (int i = 0; i < fine.latticeHeight(); ++i)
+        for (int j = 0; j < fineWidth; ++j)
+            fine.controlHeights[i * fineWidth + j] = subdivide(&rows[j], fineWidth, i);
+    return fine;
+}
+
+void SplineLattice::tessellate(int samplesPerCell, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices) const
+{
+    int columns = cellsX * samplesPerCell + 1;
+    int rows = cellsY * samplesPerCell + 1;
+    vertices.resize(static_cast<size_t>(columns) * rows);
+    indices.clear();
+    indices.reserve(static_cast<size_t>(columns - 1) * (rows - 1) * 6);
+
+    for (int i = 0; i < rows; ++i)
+    {
+        float y = origin.y + cellSize.y * i / samplesPerCell;
+        for (int j = 0; j < columns; ++j)
+        {
+            float x = origin.x + cellSize.x * j / samplesPerCell;
+            vertices[i * columns + j] = glm::vec3(x, y, evaluate(x, y));
+        }
+    }
+
+    for (int i = 0; i < rows - 1; ++i)
+    {
+        for (int j = 0; j < columns - 1; ++j)
+        {
+            unsigned int corner = i * columns + j;
+            indices.insert(indices.end(), { corner, corner + columns, corner + 1, corner + 1, corner + columns, corner + columns + 1 });
+        }
+    }
+}
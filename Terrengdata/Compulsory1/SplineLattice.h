@@ -0,0 +1,48 @@
+#ifndef SPLINELATTICE_H
+#define SPLINELATTICE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+//A height field made of uniform bicubic B-splines over a rectangle in the xy plane.
+//The rectangle is split into cellsX x cellsY cells, and there are (cellsX + 3) x (cellsY + 3) control heights,
+//so every cell is one bicubic patch that uses the 4x4 control heights starting at the cell index.
+//Used both by the least-squares fitting and by the multilevel approximation of the terrain points.
+class SplineLattice
+{
+public:
+    glm::vec2 origin;
+    glm::vec2 cellSize;
+    int cellsX;
+    int cellsY;
+    //Control heights, controlHeights[row * latticeWidth() + column]
+    std::vector<float> controlHeights;
+
+    SplineLattice();
+    SplineLattice(const glm::vec2& minCorner, const glm::vec2& maxCorner, int cellsX, int cellsY);
+
+    int latticeWidth() const { return cellsX + 3; }
+    int latticeHeight() const { return cellsY + 3; }
+
+    //Finds the cell that contains (x, y) and the local coordinates (0 to 1) inside it.
+    //Points outside the rectangle are moved to the nearest cell.
+    void locate(float x, float y, int& cellX, int& cellY, float& s, float& t) const;
+
+    //The height of the surface at (x, y)
+    float evaluate(float x, float y) const;
+
+    //The four uniform cubic B-spline basis functions for t in [0, 1]
+    static void basis(float t, float* weights);
+
+    //Sorts the points by the cell row they are in (counting sort). The points of cell row r are
+    //order[rowStart[r]] to order[rowStart[r + 1] - 1]. Used to share the rows between threads.
+    void sortPointsByCellRow(const std::vector<glm::vec3>& points, std::vector<unsigned int>& rowStart, std::vector<unsigned int>& order) const;
+
+    //The same surface on a lattice with twice as many cells in each direction (B-spline subdivision)
+    SplineLattice refined() const;
+
+    //Samples the surface with samplesPerCell x samplesPerCell quads in each cell and makes a triangle mesh
+    void tessellate(int samplesPerCell, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& indices) const;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include "StreamBuffer.h"
+#include <cstring>
+#include <algorithm>
+
+//Every write starts at a multiple of this, which is enough for vertex attributes and pixel uploads
+const size_t WRITE_ALIGNMENT = 16;
+//How long one wait for a fence can take before it tries again, in nanoseconds
+const GLuint64 FENCE_TIMEOUT = 1000000;
+
+StreamBuffer::StreamBuffer(size_t segmentSize, int segmentCount)
+    : segmentSize(segmentSize), segmentCount(segmentCount), segment(0), used(0), frameBytes(0), lastFrameBytes(0),
+    fences(segmentCount, nullptr), waits(0), reallocations(0)
+{
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, segmentSize * segmentCount, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (GLsync fence : fences)
+        if (fence != nullptr)
+            glDeleteSync(fence);
+    glDeleteBuffers(1, &buffer);
+}
+
+void StreamBuffer::beginFrame()
+{
+    lastFrameBytes = frameBytes;
+    frameBytes = 0;
+    used = 0;
+    segment = (segment + 1) % segmentCount;
+    GLsync fence = fences[segment];
+    if (fence == nullptr)
+        return;
+
+    //The first check does not wait. If the GPU is not done, the commands are flushed and the thread waits.
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        ++waits;
+        do
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+        while (result == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fences[segment] = nullptr;
+}
+
+GLintptr StreamBuffer::write(const void* data, size_t bytes)
+{
+    size_t start = (used + WRITE_ALIGNMENT - 1) / WRITE_ALIGNMENT * WRITE_ALIGNMENT;
+    if (start + bytes > segmentSize)
+    {
+        grow(start + bytes);
+        start = 0;
+    }
+    GLintptr offset = static_cast<GLintptr>(segment * segmentSize + start);
+    used = start + bytes;
+    frameBytes += bytes;
+    if (bytes == 0)
+        return offset;
+
+    //glUnmapBuffer returns false if the memory was lost while it was mapped, then the data is written again once.
+    //If that fails too, or the range cannot be mapped, the data is copied in with glBufferSubData.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    bool written = false;
+    for (int attempt = 0; attempt < 2 && !written; ++attempt)
+    {
+        void* mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, bytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (mapped == nullptr)
+            break;
+        std::memcpy(mapped, data, bytes);
+        written = glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE;
+    }
+    if (!written)
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return offset;
+}
+
+void StreamBuffer::endFrame()
+{
+    if (fences[segment] != nullptr)
+        glDeleteSync(fences[segment]);
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::grow(size_t bytes)
+{
+    //New storage for the whole buffer. The driver keeps the old storage until the GPU is done with it, so the
+    //old fences are not needed any more.
+    segmentSize = std::max(bytes, 2 * segmentSize);
+    ++reallocations;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, segmentSize * segmentCount, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    for (GLsync& fence : fences)
+    {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
@@ -0,0 +1,58 @@
+#include "TerrainMesh.h"
+#include <algorithm>
+#include <cmath>
+
+//Points this close to an edge (in barycentric units) count as inside, so a point on a shared edge is never lost
+//between two triangles because of rounding
+const float EDGE_TOLERANCE = 1e-5f;
+
+TerrainMesh::TerrainMesh(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices)
+    : vertices(vertices), indices(indices), minCorner(0.0f), maxCorner(0.0f)
+{
+    if (!vertices.empty())
+    {
+        minCorner = maxCorner = glm::vec2(vertices[0]);
+        for (const glm::vec3& vertex : vertices)
+        {
+            minCorner = glm::min(minCorner, glm::vec2(vertex));
+            maxCorner = glm::max(maxCorner, glm::vec2(vertex));
+        }
+    }
+
+    triangleNormals.resize(triangleCount());
+    for (int t = 0; t < triangleCount(); ++t)
+    {
+        const glm::vec3& a = vertices[indices[3 * t]];
+        const glm::vec3& b = vertices[indices[3 * t + 1]];
+        const glm::vec3& c = vertices[indices[3 * t + 2]];
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        //The winding of the triangles does not matter, the normal always points up
+        triangleNormals[t] = normal.z < 0.0f ? -normal : normal;
+    }
+}
+
+bool TerrainMesh::barycentricCoordinates(int triangle, float x, float y, glm::vec3& barycentric) const
+{
+    const glm::vec3& a = vertices[indices[3 * triangle]];
+    const glm::vec3& b = vertices[indices[3 * triangle + 1]];
+    const glm::vec3& c = vertices[indices[3 * triangle + 2]];
+    //Twice the signed area of the triangle and of the two sub-triangles opposite b and c
+    float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+    if (area == 0.0f)
+    {
+        barycentric = glm::vec3(0.0f);
+        return false;
+    }
+    float beta = ((x - a.x) * (c.y - a.y) - (c.x - a.x) * (y - a.y)) / area;
+    float gamma = ((b.x - a.x) * (y - a.y) - (x - a.x) * (b.y - a.y)) / area;
+    barycentric = glm::vec3(1.0f - beta - gamma, beta, gamma);
+    return barycentric.x >= -EDGE_TOLERANCE && barycentric.y >= -EDGE_TOLERANCE && barycentric.z >= -EDGE_TOLERANCE;
+}
+
+float TerrainMesh::height(int triangle, const glm::vec3& barycentric) const
+{
+    return barycentric.x * vertices[indices[3 * triangle]].z + barycentric.y * vertices[indices[3 * triangle + 1]].z
+        + barycentric.z * vertices[indices[3 * triangle + 2]].z;
+}
@@ -0,0 +1,31 @@
+#ifndef TERRAINMESH_H
+#define TERRAINMESH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+//A triangle mesh of the terrain (a height field over the xy plane) with the upward normal of every triangle.
+//TriangleLocator finds the triangle under a point.
+class TerrainMesh
+{
+public:
+    std::vector<glm::vec3> vertices;
+    //Three indices per triangle
+    std::vector<unsigned int> indices;
+    //The upward unit normal of every triangle
+    std::vector<glm::vec3> triangleNormals;
+    glm::vec2 minCorner;
+    glm::vec2 maxCorner;
+
+    TerrainMesh(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices);
+
+    int triangleCount() const { return static_cast<int>(indices.size() / 3); }
+
+    //The height of the triangle at the barycentric coordinates
+    float height(int triangle, const glm::vec3& barycentric) const;
+
+    //Calculates the barycentric coordinates of (x, y) in the triangle and returns true if the point is inside it
+    bool barycentricCoordinates(int triangle, float x, float y, glm::vec3& barycentric) const;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+    //hardware_concurrency can return 0 when the number of cores is unknown
+    unsigned int workerCount = threadCount > 1 ? threadCount - 1 : 0;
+    for (unsigned int i = 0; i < workerCount; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::parallelFor(size_t count, size_t blockSize, const std::function<void(size_t, size_t)>& body)
+{
+    if (count == 0)
+        return;
+    blockSize = std::max<size_t>(blockSize, 1);
+
+    //Small loops and single threaded pools are not worth waking the workers for
+    if (workers.empty() || count <= blockSize)
+    {
+        body(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> loopLock(loopMutex);
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->body = &body;
+    job->count = count;
+    job->blockSize = blockSize;
+    job->blockCount = (count + blockSize - 1) / blockSize;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentJob = job;
+        ++generation;
+    }
+    wake.notify_all();
+
+    //The calling thread works on the loop as well instead of only waiting
+    runBlocks(*job);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&]() { return job->finishedBlocks.load() == job->blockCount; });
+    currentJob.reset();
+}
+
+void ThreadPool::workerLoop()
+{
+    size_t seenGeneration = 0;
+    while (true)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+            if (stopping)
+                return;
+            seenGeneration = generation;
+            job = currentJob;
+        }
+        if (job)
+            runBlocks(*job);
+    }
+}
+
+void ThreadPool::runBlocks(Job& job)
+{
+    while (true)
+    {
+        size_t block = job.nextBlock.fetch_add(1);
+        if (block >= job.blockCount)
+            return;
+        size_t begin = block * job.blockSize;
+        size_t end = std::min(begin + job.blockSize, job.count);
+        (*job.body)(begin, end);
+
+        if (job.finishedBlocks.fetch_add(1) + 1 == job.blockCount)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.notify_all();
+        }
+    }
+}
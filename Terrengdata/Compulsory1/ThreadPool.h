@@ -0,0 +1,58 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+//A fixed set of worker threads that share loops between them.
+//parallelFor splits the range [0, count) into blocks, and the workers and the calling thread take blocks
+//until all of them are done. Only one loop runs at a time, and body must not call parallelFor itself.
+class ThreadPool
+{
+public:
+    //threadCount includes the calling thread, so a pool of 1 runs everything on the calling thread
+    explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //Calls body(begin, end) for blocks of at most blockSize indices and returns when every block is finished
+    void parallelFor(size_t count, size_t blockSize, const std::function<void(size_t, size_t)>& body);
+
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    //The pool that is shared by the whole program
+    static ThreadPool& shared();
+
+private:
+    //Every loop gets its own job, so a worker that is late from the previous loop can never take a block of the next one
+    struct Job
+    {
+        const std::function<void(size_t, size_t)>* body = nullptr;
+        size_t count = 0;
+        size_t blockSize = 1;
+        size_t blockCount = 0;
+        std::atomic<size_t> nextBlock{ 0 };
+        std::atomic<size_t> finishedBlocks{ 0 };
+    };
+
+    void workerLoop();
+    void runBlocks(Job& job);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::mutex loopMutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::shared_ptr<Job> currentJob;
+    size_t generation = 0;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "TriangleLocator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+//Longest walk before the grid is used. A ball moves much less than one triangle per step, so this is only
+//reached when the start triangle is far away from the point.
+const int MAX_WALK_STEPS = 16;
+//Points per block in locateBatch
+const size_t QUERY_BLOCK = 1024;
+
+TriangleLocator::TriangleLocator(const TerrainMesh& mesh) : mesh(mesh), gridCellSize(1.0f), gridX(1), gridY(1)
+{
+    buildGrid();
+    buildNeighbours();
+}
+
+void TriangleLocator::buildGrid()
+{
+    const std::vector<glm::vec3>& vertices = mesh.vertices;
+    const std::vector<unsigned int>& indices = mesh.indices;
+    int triangleCount = mesh.triangleCount();
+
+    //About two triangles per cell, with square cells
+    glm::vec2 size = glm::max(mesh.maxCorner - mesh.minCorner, glm::vec2(1e-6f));
+    float cellArea = size.x * size.y * 2.0f / std::max(triangleCount, 1);
+    float cellWidth = std::sqrt(cellArea);
+    gridX = std::max(1, static_cast<int>(std::ceil(size.x / cellWidth)));
+    gridY = std::max(1, static_cast<int>(std::ceil(size.y / cellWidth)));
+    gridCellSize = glm::vec2(size.x / gridX, size.y / gridY);
+
+    //The cells that the bounding box of a triangle overlaps
+    auto cellRange = [&](int t, int& x0, int& y0, int& x1, int& y1)
+    {
+        glm::vec2 low(vertices[indices[3 * t]]);
+        glm::vec2 high = low;
+        for (int k = 1; k < 3; ++k)
+        {
+            low = glm::min(low, glm::vec2(vertices[indices[3 * t + k]]));
+            high = glm::max(high, glm::vec2(vertices[indices[3 * t + k]]));
+        }
+        x0 = std::min(std::max(static_cast<int>(std::floor((low.x - mesh.minCorner.x) / gridCellSize.x)), 0), gridX - 1);
+        y0 = std::min(std::max(static_cast<int>(std::floor((low.y - mesh.minCorner.y) / gridCellSize.y)), 0), gridY - 1);
+        x1 = std::min(std::max(static_cast<int>(std::floor((high.x - mesh.minCorner.x) / gridCellSize.x)), 0), gridX - 1);
+        y1 = std::min(std::max(static_cast<int>(std::floor((high.y - mesh.minCorner.y) / gridCellSize.y)), 0), gridY - 1);
+    };
+
+    //Counting sort: first counts the triangles of every cell, then the running sum gives where each cell starts
+    cellStart.assign(static_cast<size_t>(gridX) * gridY + 1, 0);
+    for (int t = 0; t < triangleCount; ++t)
+    {
+        int x0, y0, x1, y1;
+        cellRange(t, x0, y0, x1, y1);
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x)
+                ++cellStart[y * gridX + x + 1];
+    }
+    for (size_t c = 1; c < cellStart.size(); ++c)
+        cellStart[c] += cellStart[c - 1];
+
+    cellTriangles.resize(cellStart.back());
+    std::vector<unsigned int> next(cellStart.begin(), cellStart.end() - 1);
+    for (int t = 0; t < triangleCount; ++t)
+    {
+        int x0, y0, x1, y1;
+        cellRange(t, x0, y0, x1, y1);
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x)
+                cellTriangles[next[y * gridX + x]++] = t;
+    }
+}
+
+void TriangleLocator::buildNeighbours()
+{
+    //Every edge gets a key made of its two vertex indices (the smallest first). After sorting the keys,
+    //the two triangles that share an edge are next to each other.
+    const std::vector<unsigned int>& indices = mesh.indices;
+    size_t edgeCount = indices.size();
+    std::vector<std::pair<std::uint64_t, unsigned int>> edges(edgeCount);
+    for (size_t e = 0; e < edgeCount; ++e)
+    {
+        //Edge k of a triangle is opposite vertex k, so it goes between the two other vertices
+        size_t triangle = e / 3;
+        int k = static_cast<int>(e % 3);
+        std::uint64_t a = indices[3 * triangle + (k + 1) % 3];
+        std::uint64_t b = indices[3 * triangle + (k + 2) % 3];
+        edges[e] = { (std::min(a, b) << 32) | std::max(a, b), static_cast<unsigned int>(e) };
+    }
+    std::sort(edges.begin(), edges.end());
+
+    neighbours.assign(edgeCount, -1);
+    for (size_t e = 0; e + 1 < edgeCount; ++e)
+    {
+        if (edges[e].first == edges[e + 1].first)
+        {
+            neighbours[edges[e].second] = static_cast<int>(edges[e + 1].second / 3);
+            neighbours[edges[e + 1].second] = static_cast<int>(edges[e].second / 3);
+            ++e;
+        }
+    }
+}
+
+int TriangleLocator::findByGrid(float x, float y, glm::vec3& barycentric) const
+{
+    if (x < mesh.minCorner.x || y < mesh.minCorner.y || x > mesh.maxCorner.x || y > mesh.maxCorner.y)
+        return -1;
+    int cellX = std::min(static_cast<int>((x - mesh.minCorner.x) / gridCellSize.x), gridX - 1);
+    int cellY = std::min(static_cast<int>((y - mesh.minCorner.y) / gridCellSize.y), gridY - 1);
+    int cell = cellY * gridX + cellX;
+    for (unsigned int k = cellStart[cell]; k < cellStart[cell + 1]; ++k)
+    {
+        if (mesh.barycentricCoordinates(cellTriangles[k], x, y, barycentric))
+            return cellTriangles[k];
+    }
+    return -1;
+}
+
+int TriangleLocator::findByWalk(int start, float x, float y, glm::vec3& barycentric) const
+{
+    int triangle = start;
+    for (int step = 0; step < MAX_WALK_STEPS; ++step)
+    {
+        if (mesh.barycentricCoordinates(triangle, x, y, barycentric))
+            return triangle;
+        //A negative barycentric coordinate means the point is on the other side of the edge opposite that vertex.
+        //The walk crosses the edge with the most negative coordinate.
+        int k = 0;
+        if (barycentric[1] < barycentric[k])
+            k = 1;
+        if (barycentric[2] < barycentric[k])
+            k = 2;
+        if (barycentric[k] >= 0.0f)
+            return -1;
+        triangle = neighbour(triangle, k);
+        if (triangle < 0)
+            return -1;
+    }
+    return -1;
+}
+
+bool TriangleLocator::locate(float x, float y, TriangleQuery& result, int start) const
+{
+    int triangle = -1;
+    if (start >= 0 && start < mesh.triangleCount())
+        triangle = findByWalk(start, x, y, result.barycentric);
+    if (triangle < 0)
+        triangle = findByGrid(x, y, result.barycentric);
+
+    result.triangle = triangle;
+    if (triangle < 0)
+    {
+        result.barycentric = glm::vec3(0.0f);
+        result.height = 0.0f;
+        result.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+        return false;
+    }
+    result.height = mesh.height(triangle, result.barycentric);
+    result.normal = mesh.triangleNormals[triangle];
+    return true;
+}
+
+void TriangleLocator::locateBatch(ThreadPool& pool, size_t count, const float* x, const float* y, int* start, TriangleQuery* results) const
+{
+    pool.parallelFor(count, QUERY_BLOCK, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            locate(x[i], y[i], results[i], start ? start[i] : -1);
+            if (start)
+                start[i] = results[i].triangle;
+        }
+    });
+}
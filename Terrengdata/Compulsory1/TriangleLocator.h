@@ -0,0 +1,62 @@
+#ifndef TRIANGLELOCATOR_H
+#define TRIANGLELOCATOR_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "TerrainMesh.h"
+#include "ThreadPool.h"
+
+//The result of a query: the triangle under the point (-1 outside the terrain), the barycentric coordinates
+//of the point in it, the height of the terrain there and the upward normal of the triangle
+struct TriangleQuery
+{
+    int triangle;
+    glm::vec3 barycentric;
+    float height;
+    glm::vec3 normal;
+};
+
+//Finds the terrain triangle under a point in the xy plane.
+//A cold query uses a uniform grid over the triangles. Every grid cell has a list of the triangles whose bounding box
+//overlaps the cell, stored the same way as the rows in SplineLattice::sortPointsByCellRow: the triangles of cell c are
+//cellTriangles[cellStart[c]] to cellTriangles[cellStart[c + 1] - 1], about two triangles per cell.
+//A warm query starts in the triangle of the previous query (for example the triangle of a ball in the last step)
+//and walks over the edge towards the point until it is inside, so a point that moves a little only needs a
+//few barycentric tests. The walk gives up after MAX_WALK_STEPS and uses the grid instead.
+class TriangleLocator
+{
+public:
+    explicit TriangleLocator(const TerrainMesh& mesh);
+
+    const TerrainMesh& getMesh() const { return mesh; }
+
+    //Finds the triangle under (x, y). start is the triangle to walk from, or -1 to use the grid.
+    //Returns false when the point is outside the terrain.
+    bool locate(float x, float y, TriangleQuery& result, int start = -1) const;
+
+    //The same query for count points on the thread pool. start can be nullptr, otherwise it has the triangle to start from
+    //for every point and gets the triangle that was found, so it can be passed to the next batch of the same points.
+    void locateBatch(ThreadPool& pool, size_t count, const float* x, const float* y, int* start, TriangleQuery* results) const;
+
+    //The triangle on the other side of the edge opposite vertex k of the triangle, or -1 at the border of the mesh
+    int neighbour(int triangle, int k) const { return neighbours[3 * triangle + k]; }
+
+private:
+    //Both return the triangle that contains (x, y), or -1. The walk also returns -1 when it reaches the border
+    //of the mesh or runs out of steps, and the grid is used after that.
+    int findByGrid(float x, float y, glm::vec3& barycentric) const;
+    int findByWalk(int start, float x, float y, glm::vec3& barycentric) const;
+    void buildGrid();
+    void buildNeighbours();
+
+    const TerrainMesh& mesh;
+    std::vector<int> neighbours;
+
+    glm::vec2 gridCellSize;
+    int gridX;
+    int gridY;
+    std::vector<unsigned int> cellStart;
+    std::vector<unsigned int> cellTriangles;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#version 330 core
+// Draws the DEM of the water and erosion simulation. There are no vertex attributes: the vertex number gives the
+// place in the grid, and the heights come from a texture with the terrain height in red and the water depth in green.
+// The mesh can be coarser than the DEM, then every vertex reads the DEM cell it lands on.
+
+out vec3 ourColor;
+uniform sampler2D heights;
+uniform int meshWidth;
+uniform int meshHeight;
+uniform vec2 origin;
+uniform float cellSize;
+layout (std140) uniform Camera  // shared by all programs, updated once per frame
+{
+    mat4 projection;
+    mat4 view;
+};
+
+const vec3 lightDirection = vec3(0.3, 0.2, 0.93);
+const vec3 groundColor = vec3(0.55, 0.5, 0.35);
+const vec3 waterColor = vec3(0.1, 0.35, 0.8);
+
+void main()
+{
+    ivec2 gridSize = textureSize(heights, 0);
+    ivec2 meshSize = ivec2(meshWidth, meshHeight);
+    ivec2 vertex = ivec2(gl_VertexID % meshWidth, gl_VertexID / meshWidth);
+    ivec2 cell = vertex * (gridSize - 1) / (meshSize - 1);
+    vec2 here = texelFetch(heights, cell, 0).rg;
+
+    // The normal of the terrain from the next cells, for the light
+    float right = texelFetch(heights, min(cell + ivec2(1, 0), gridSize - 1), 0).r;
+    float up = texelFetch(heights, min(cell + ivec2(0, 1), gridSize - 1), 0).r;
+    vec3 normal = normalize(vec3(here.r - right, here.r - up, cellSize));
+    float light = 0.35 + 0.65 * max(dot(normal, lightDirection), 0.0);
+
+    // The water is drawn on top of the terrain, deeper water is bluer
+    float water = here.g;
+    gl_Position = projection * view * vec4(origin + vec2(cell) * cellSize, here.r + water, 1.0);
+    ourColor = mix(groundColor * light, waterColor, clamp(water / (4.0 * cellSize), 0.0, 1.0));
+}
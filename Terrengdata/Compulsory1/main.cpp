@@ -2,6 +2,10 @@
 #include <fstream>
 #include <filesystem>
 #include<vector>
+#include<random>
+#include<cmath>
+#include<cstring>
+#include<memory>
 
 #include "glm/mat4x3.hpp"
 #include<glad/glad.h>
@@ -11,8 +15,27 @@
 #include<glm/gtc/type_ptr.hpp>
 
 #include "Shader.h"
-#include "ShaderFileLoader.h"
+#include "ShaderManager.h"
+#include "ShaderPermutations.h"
 #include "Camera.h"
+#include "ThreadPool.h"
+#include "SplineLattice.h"
+#include "LeastSquaresFit.h"
+#include "MultilevelBSpline.h"
+#include "FitReport.h"
+#include "TerrainMesh.h"
+#include "TriangleLocator.h"
+#include "BallSystem.h"
+#include "SimulationThread.h"
+#include "BallSnapshots.h"
+#include "HydraulicErosion.h"
+#include "InstancedRenderer.h"
+#include "StreamBuffer.h"
+#include "CameraUniforms.h"
+#include "Profiler.h"
+#include "ProfilerOverlay.h"
+#include "Flythrough.h"
+#include "Benchmark.h"
 
 #include <pdal/pdal.hpp>
 #include <pdal/PointTable.hpp>
@@ -52,21 +75,119 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void convertLazFilesToTextFiles(const string& inputFilename, const string& outputFilename);
 vector<glm::vec3> loadPointsFromTextFile(const string& filename);
 std::vector<glm::vec3> loadPointsFromMultipleTextFiles(const std::vector<std::string>& textFiles);
+bool keyPressedOnce(GLFWwindow* window, int key);
 
-string vfs = ShaderLoader::LoadShaderFromFile("vs.vs");
-string fs = ShaderLoader::LoadShaderFromFile("fs.fs");
-
-int main()
+//A tessellated spline surface on the GPU
+struct LatticeMesh
+{
+    GLuint VAO, VBO, EBO;
+    GLsizei indexCount;
+};
+LatticeMesh createLatticeMesh(const SplineLattice& lattice, int samplesPerCell);
+LatticeMesh createMesh(const vector<glm::vec3>& vertices, const vector<unsigned int>& indices);
+void deleteLatticeMesh(LatticeMesh& mesh);
+
+void dropBalls(BallSystem& balls, const TriangleLocator& locator, int count);
+
+//The DEM of the water and erosion simulation on the GPU. The terrain heights and water depths are in a texture that 
+//is updated one tile at a time, and the mesh is a grid of vertices that read the texture 
+struct DemMesh
+{
+    GLuint VAO, EBO, texture;
+    GLsizei indexCount;
+    int meshWidth, meshHeight;
+};
+vector<float> sampleDem(const SplineLattice& lattice, const glm::vec2& origin, float cellSize, int width, int height);
+DemMesh createDemMesh(const vector<float>& heights, int width, int height, int maxMeshSize);
+void uploadDemTile(const DemMesh& mesh, StreamBuffer& stream, int tileX, int tileY, const float* data);
+void deleteDemMesh(DemMesh& mesh);
+bool pickTerrain(const SplineLattice& lattice, const glm::vec3& origin, const glm::vec3& direction, glm::vec2& hit);
+
+//The B-spline surface that is fitted to the points. The control lattice has (cells + 3) x (cells + 3) control points, 
+//and the smoothing term makes the surface stiffer 
+const int fitCellsX = 256;
+const int fitCellsY = 256;
+const float fitSmoothing = 0.01f;
+//The multilevel approximation starts with one cell and doubles the cells for each level, 
+//9 levels ends with the same 256 x 256 cells as the least-squares fit 
+const int multilevelLevels = 9;
+
+//B drops this many balls over the terrain. C turns the collisions between the balls on and off, and P switches between 
+//the spatial hash and sweep and prune for finding the balls that touch. The terrain is scaled down so much that real gravity would make 
+//the balls move too slowly to see, so the gravity is given in scene units 
+const int ballCount = 100000;
+const glm::vec3 ballGravity(0.0f, 0.0f, -0.05f);
+
+//The water and erosion simulation runs on a DEM with this many cells along the longest side of the terrain, sampled 
+//from the least-squares surface. The mesh that draws it has at most demMeshSize vertices in each direction. 
+//R turns the rain on and off, and E pours water where the camera looks 
+const int demResolution = 2048;
+const int demMeshSize = 512;
+
+//F switches between the points, the least-squares surface, the multilevel surface and the water on the DEM 
+enum TerrainView { SHOW_POINTS, SHOW_LEAST_SQUARES, SHOW_MULTILEVEL, SHOW_WATER, TERRAIN_VIEW_COUNT };
+TerrainView terrainView = SHOW_POINTS;
+
+//The features of vs.vs. Each one is a bit of the mask that picks the shader variant and a #define in the shader. 
+//H switches the height colours on and off. The points are always drawn with quantized positions 
+enum VertexFeature { HEIGHT_COLOR = 1, QUANTIZED_POSITIONS = 2 };
+bool heightColors = false;
+//The handles of the vs.vs uniforms. Every variant has its own locations, so each variant gets its handles once, 
+//the first time it is drawn. The uniforms that never change are set at the same time 
+struct SurfaceUniforms
 {
-    std::cout << "vfs " << vfs.c_str() << std::endl;
-    std::cout << "fs " << fs.c_str() << std::endl;
+    bool found = false;
+    Uniform<glm::mat4> model;
+};
+//F1 shows and hides the profiler overlay (hidden at the start), F2 writes the last frames to profile.csv and profile.json (a Chrome trace) 
+bool showProfiler = false;
+//Threads in the pools of the ball and the erosion simulation, the simulation thread included. 0 shares the cores 
+//other than the render thread evenly between the two. --ball-threads n and --erosion-threads n set them 
+int ballThreads = 0;
+int erosionThreads = 0;
+
+int main(int argc, char* argv[])
+{
+    //--benchmark-flythrough [frames] [keyframe file] draws the terrain in a hidden window with the camera on a fixed 
+    //path, and writes the frame times to benchmark.json. Without a keyframe file the camera circles the points. 
+    //--benchmark-water shows the water during the benchmark, so the erosion is stepped and measured as well 
+    int benchmarkFrames = 0;
+    bool benchmarkWater = false;
+    string flythroughFile;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--benchmark-flythrough") == 0)
+        {
+            benchmarkFrames = 600;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+                benchmarkFrames = atoi(argv[++i]);
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                flythroughFile = argv[++i];
+        }
+        if (strcmp(argv[i], "--benchmark-water") == 0)
+            benchmarkWater = true;
+        if (strcmp(argv[i], "--ball-threads") == 0 && i + 1 < argc)
+            ballThreads = std::max(atoi(argv[++i]), 0);
+        if (strcmp(argv[i], "--erosion-threads") == 0 && i + 1 < argc)
+            erosionThreads = std::max(atoi(argv[++i]), 0);
+    }
+    //The render thread keeps one core, the simulations share the rest 
+    unsigned int spareCores = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    unsigned int sharedSimulationThreads = std::max(1u, spareCores / 2);
 
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
+    //glfwTerminate runs when main returns, after the objects made below have deleted their buffers, queries and 
+    //programs while the context still exists. Objects are destroyed in the opposite order they were made, so this 
+    //one, made first, goes last 
+    struct GlfwTerminator { ~GlfwTerminator() { glfwTerminate(); } } glfwTerminator;
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    //The benchmark draws into a framebuffer of its own, so the window is never shown 
+    if (benchmarkFrames > 0)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     // glfw window creation
     // --------------------
@@ -92,7 +213,16 @@ int main()
 
     // build and compile our shader program
     // ------------------------------------
-    Shader ourShader("vs.vs", "fs.fs"); // you can name your shader files however you like
+    //The shader manager reads every file once and keeps the linked programs in shaders.cache, so the next start 
+    //does not have to compile them again 
+    ShaderManager shaders;
+    //vs.vs is compiled once for every combination of its features. All of them are started here, so a driver that 
+    //compiles in parallel can do it while the points are loaded and the surfaces are fitted 
+    ShaderPermutations surfaceShaders(shaders, "vs.vs", "fs.fs", { "HEIGHT_COLOR", "QUANTIZED_POSITIONS" });
+    for (unsigned int features = 0; features <= (HEIGHT_COLOR | QUANTIZED_POSITIONS); ++features)
+        surfaceShaders.prepare(features);
+    //The projection and view matrices go to all the shaders through one uniform buffer 
+    CameraUniforms cameraUniforms;
 
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
@@ -129,58 +259,354 @@ int main()
         return -1;
     }
 
+    //The points are stored as 16-bit fractions of their bounding box, 8 bytes per point instead of 12. The shader 
+    //variant with QUANTIZED_POSITIONS turns them back into positions 
+    glm::vec3 pointsMin = points[0];
+    glm::vec3 pointsMax = points[0];
+    for (const glm::vec3& point : points)
+    {
+        pointsMin = glm::min(pointsMin, point);
+        pointsMax = glm::max(pointsMax, point);
+    }
+    glm::vec3 pointsScale = glm::max(pointsMax - pointsMin, glm::vec3(1e-6f));
+    vector<uint16_t> quantizedPoints(4 * points.size(), 0);
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        glm::vec3 fraction = (points[i] - pointsMin) / pointsScale;
+        for (int axis = 0; axis < 3; ++axis)
+            quantizedPoints[4 * i + axis] = static_cast<uint16_t>(std::lround(fraction[axis] * 65535.0f));
+    }
+
     GLuint VAO, VBO;
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
 
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(glm::vec3), points.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, quantizedPoints.size() * sizeof(uint16_t), quantizedPoints.data(), GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 4 * sizeof(uint16_t), (void*)0);
     glEnableVertexAttribArray(0);
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
+    //Fits a B-spline surface to all the points with least squares. The control points can be used instead of the 
+    //points, and the report tells how large the error is 
+    LeastSquaresFit leastSquaresFit(ThreadPool::shared(), fitCellsX, fitCellsY, fitSmoothing);
+    FitReport fitReport;
+    SplineLattice fittedSurface = leastSquaresFit.fit(points, fitReport);
+    fitReport.print("Least-squares B-spline fit");
+    //Mesh of the fitted surface, two quads per cell in each direction. The same triangles are used for the balls 
+    vector<glm::vec3> terrainVertices;
+    vector<unsigned int> terrainIndices;
+    fittedSurface.tessellate(2, terrainVertices, terrainIndices);
+    LatticeMesh fittedMesh = createMesh(terrainVertices, terrainIndices);
+    TerrainMesh terrain(terrainVertices, terrainIndices);
+    TriangleLocator terrainLocator(terrain);
+
+    //The multilevel B-spline approximation is much faster and is used as a quick preview. It prints the error 
+    //after each level, and the callback could return false to stop at a coarser level 
+    MultilevelBSpline multilevel(ThreadPool::shared(), 1, 1, multilevelLevels);
+    FitReport multilevelReport;
+    SplineLattice multilevelSurface = multilevel.approximate(points, multilevelReport,
+        [](int level, const SplineLattice& lattice, const FitReport& report)
+        {
+            cout << "Multilevel B-spline level " << level << " (" << lattice.cellsX << " x " << lattice.cellsY
+                << " cells): RMS error " << report.rmsError << ", " << report.seconds << " s" << endl;
+            return true;
+        });
+    multilevelReport.print("Multilevel B-spline approximation");
+    LatticeMesh multilevelMesh = createLatticeMesh(multilevelSurface, 2);
+
+    //The balls that roll on the terrain, the radius is a small part of the size of the terrain 
+    glm::vec2 terrainSize = terrain.maxCorner - terrain.minCorner;
+    BallSystem balls(terrainLocator, 0.002f * std::max(terrainSize.x, terrainSize.y), ballGravity);
+    //All the balls are drawn with one instanced draw call of a sphere mesh 
+    vector<glm::vec3> sphereVertices;
+    vector<unsigned int> sphereIndices;
+    InstancedRenderer::sphere(8, 12, sphereVertices, sphereIndices);
+    InstancedRenderer ballRenderer(sphereVertices, sphereIndices);
+    Shader& instancedShader = shaders.get("instanced.vs", "fs.fs");
+
+    //The ball instances and the changed DEM tiles are written into a ring of three segments each frame, so the 
+    //uploads never wait for the GPU or make the driver allocate new memory 
+    StreamBuffer streamBuffer(4 << 20);
+    //The window title shows how many bytes were streamed in the last frame, updated once a second 
+    float lastTitleUpdate = 0.0f;
+
+    //The balls are moved on their own thread with fixed time steps. After every step the positions are published, and 
+    //the render loop draws them one step behind, blended between the two newest steps. Key presses that change the 
+    //balls are posted to the simulation thread, so only that thread touches the BallSystem 
+    BallSnapshots ballSnapshots;
+    vector<float> ballX, ballY, ballZ;
+    //The simulation has its own pool. The shared pool runs one loop at a time, so sampling the DEM on the render 
+    //thread would otherwise wait for a whole step 
+    ThreadPool simulationPool(ballThreads > 0 ? static_cast<unsigned int>(ballThreads) : sharedSimulationThreads);
+    SimulationThread simulation(balls.timeStep, [&](double time)
+        {
+            balls.step(simulationPool);
+            ballSnapshots.publish(balls.positionX, balls.positionY, balls.positionZ, time);
+        });
+    //The benchmark steps the simulations itself, with its own clock 
+    if (benchmarkFrames == 0)
+        simulation.start();
+
+    //The water and erosion simulation on a DEM over the same rectangle as the terrain. The width and height are 
+    //rounded up to whole tiles. It runs on its own thread while the water is shown, and the tiles it changes are 
+    //copied into the texture of the DEM before drawing 
+    float demCellSize = std::max(terrainSize.x, terrainSize.y) / demResolution;
+    int demWidth = (static_cast<int>(std::ceil(terrainSize.x / demCellSize)) + HydraulicErosion::TILE - 1) / HydraulicErosion::TILE * HydraulicErosion::TILE;
+    int demHeight = (static_cast<int>(std::ceil(terrainSize.y / demCellSize)) + HydraulicErosion::TILE - 1) / HydraulicErosion::TILE * HydraulicErosion::TILE;
+    //The texture starts with the sampled heights, uploaded once when it is made. The stream buffer only carries the 
+    //tiles that change afterwards, so it never has to grow to the size of the whole DEM 
+    vector<float> demHeights = sampleDem(fittedSurface, terrain.minCorner, demCellSize, demWidth, demHeight);
+    HydraulicErosion erosion(demHeights, demWidth, demHeight, demCellSize);
+    DemMesh demMesh = createDemMesh(demHeights, demWidth, demHeight, demMeshSize);
+    demHeights = vector<float>();
+    Shader& demShader = shaders.get("dem.vs", "fs.fs");
+    //The uniforms of the DEM shader do not change, so they are set once 
+    demShader.use();
+    demShader.setInt("heights", 0);
+    demShader.setInt("meshWidth", demMesh.meshWidth);
+    demShader.setInt("meshHeight", demMesh.meshHeight);
+    demShader.setVec2("origin", terrain.minCorner);
+    demShader.setFloat("cellSize", demCellSize);
+    //The erosion has its own pool as well, so it does not queue behind the balls or the render thread. One step of a 
+    //2048 x 2048 DEM took 68 ms on one thread, and a step is 33 ms, so that size needs three or more 
+    //erosion threads to keep up with real time 
+    ThreadPool erosionPool(erosionThreads > 0 ? static_cast<unsigned int>(erosionThreads) : sharedSimulationThreads);
+    SimulationThread erosionThread(erosion.timeStep, [&](double)
+        {
+            erosion.step(erosionPool);
+            erosion.publishTiles(erosionPool);
+        });
+
+    //Uses the variant of vs.vs for the features. The first time a variant is used its handles are looked up and the 
+    //height range and the quantization are set, a variant without those uniforms ignores them. The height range is 
+    //never empty, so flat points do not divide by zero in the colour ramp 
+    vector<SurfaceUniforms> surfaceUniforms(surfaceShaders.variantCount());
+    glm::vec2 heightRange(pointsMin.z, std::max(pointsMax.z, pointsMin.z + 0.001f));
+    auto useSurfaceShader = [&](unsigned int features) -> Shader&
+        {
+            Shader& shader = surfaceShaders.get(features);
+            shader.use();
+            SurfaceUniforms& uniforms = surfaceUniforms.at(features);
+            if (!uniforms.found)
+            {
+                uniforms.model = shader.uniform<glm::mat4>("model");
+                shader.set(shader.uniform<glm::vec2>("heightRange"), heightRange);
+                shader.set(shader.uniform<glm::vec3>("positionOffset"), pointsMin);
+                shader.set(shader.uniform<glm::vec3>("positionScale"), pointsScale);
+                uniforms.found = true;
+            }
+            return shader;
+        };
+
+    //Measures the parts of every frame on the CPU and on the GPU 
+    //The benchmark keeps a sample of every frame, so the scopes in its report cover the whole run 
+    Profiler profiler(std::max(benchmarkFrames, 240));
+    ProfilerOverlay profilerOverlay;
+    Shader& overlayShader = shaders.get("overlay.vs", "fs.fs");
+
+    //In the benchmark the frames are not waiting for the screen, and the overlay is not drawn so it is not measured 
+    std::unique_ptr<Benchmark> benchmark;
+    if (benchmarkFrames > 0)
+    {
+        glm::vec3 extent = pointsMax - pointsMin;
+        Flythrough flythrough = Flythrough::orbit((pointsMin + pointsMax) * 0.5f, 0.75f * glm::max(extent.x, extent.y),
+            glm::max(extent.z, 0.25f * glm::max(extent.x, extent.y)));
+        if (!flythroughFile.empty() && !flythrough.load(flythroughFile))
+            cout << "Could not read the keyframes in " << flythroughFile << ", the camera circles the points" << endl;
+        benchmark.reset(new Benchmark(flythrough, benchmarkFrames));
+        benchmark->createTarget(SCR_WIDTH, SCR_HEIGHT);
+        glfwSwapInterval(0);
+        showProfiler = false;
+        //The same balls are dropped in every run, so the steps in the report include the ball physics 
+        simulation.post([&]() { dropBalls(balls, terrainLocator, ballCount); });
+        if (benchmarkWater)
+            terrainView = SHOW_WATER;
+    }
 
     while (!glfwWindowShouldClose(window))
     {
         // Time calculation for movement
         float currentFrame = static_cast<float>(glfwGetTime());
+        //The benchmark moves the camera itself and counts time in whole frames. The balls and the water are stepped 
+        //here up to that time instead of on their threads, so every run draws the same 
+        double simulationTime = simulation.now();
+        if (benchmark)
+        {
+            if (!benchmark->nextFrame(camera, profiler))
+                break;
+            currentFrame = benchmark->time();
+            simulation.runUntil(currentFrame);
+            if (terrainView == SHOW_WATER)
+                erosionThread.runUntil(currentFrame);
+            simulationTime = currentFrame;
+        }
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        profiler.beginFrame();
+        streamBuffer.beginFrame();
+        if (currentFrame - lastTitleUpdate >= 1.0f)
+        {
+            std::string title = "Terreng - " + std::to_string(streamBuffer.bytesLastFrame() / 1024) + " KB streamed per frame";
+            glfwSetWindowTitle(window, title.c_str());
+            lastTitleUpdate = currentFrame;
+        }
 
+        profiler.beginCpu("update");
         processInput(window);
+        if (keyPressedOnce(window, GLFW_KEY_F1))
+            showProfiler = !showProfiler;
+        if (keyPressedOnce(window, GLFW_KEY_F2) && profiler.writeCsv("profile.csv") && profiler.writeChromeTrace("profile.json"))
+            cout << "The profile is written to profile.csv and profile.json" << endl;
+        //F3 adds the camera to flythrough.txt, a path for --benchmark-flythrough 
+        if (keyPressedOnce(window, GLFW_KEY_F3) && Flythrough::appendKeyframe("flythrough.txt", camera))
+            cout << "Keyframe added to flythrough.txt" << endl;
+        if (keyPressedOnce(window, GLFW_KEY_H))
+            heightColors = !heightColors;
+        if (keyPressedOnce(window, GLFW_KEY_F))
+        {
+            terrainView = static_cast<TerrainView>((terrainView + 1) % TERRAIN_VIEW_COUNT);
+            if (terrainView == SHOW_WATER && !benchmark)
+                erosionThread.start();
+            else
+                erosionThread.stop();
+        }
+        if (keyPressedOnce(window, GLFW_KEY_R))
+        {
+            erosionThread.post([&]()
+                {
+                    erosion.raining = !erosion.raining;
+                    cout << "Rain " << (erosion.raining ? "on" : "off") << endl;
+                });
+        }
+        glm::vec2 pouringPoint;
+        if (keyPressedOnce(window, GLFW_KEY_E) && pickTerrain(fittedSurface, camera.Position, camera.Front, pouringPoint))
+        {
+            glm::vec2 cell = (pouringPoint - terrain.minCorner) / demCellSize;
+            erosionThread.post([&erosion, cell, demCellSize]() { erosion.addWater(cell.x, cell.y, 24.0f, 8.0f * demCellSize); });
+        }
+        if (keyPressedOnce(window, GLFW_KEY_B))
+            simulation.post([&]() { dropBalls(balls, terrainLocator, ballCount); });
+        if (keyPressedOnce(window, GLFW_KEY_C))
+        {
+            simulation.post([&]()
+                {
+                    balls.ballCollisions = !balls.ballCollisions;
+                    cout << "Ball collisions " << (balls.ballCollisions ? "on" : "off") << endl;
+                });
+        }
+        if (keyPressedOnce(window, GLFW_KEY_P))
+        {
+            simulation.post([&]()
+                {
+                    bool hash = balls.broadphase.method == Broadphase::SPATIAL_HASH;
+                    balls.broadphase.method = hash ? Broadphase::SWEEP_AND_PRUNE : Broadphase::SPATIAL_HASH;
+                    cout << "Broadphase: " << (hash ? "sweep and prune" : "spatial hash") << endl;
+                });
+        }
+
+        //The newest ball positions from the simulation thread are blended and made into instances for drawing 
+        size_t drawnBalls = ballSnapshots.interpolate(simulationTime, simulation.getTimeStep(), ballX, ballY, ballZ);
+        ballRenderer.instances.resize(drawnBalls);
+        for (size_t i = 0; i < drawnBalls; ++i)
+            ballRenderer.instances[i] = { glm::vec3(ballX[i], ballY[i], ballZ[i]), balls.radius, glm::vec4(0.9f, 0.3f, 0.1f, 1.0f) };
+        profiler.endCpu();
 
+        profiler.beginCpu("terrain");
+        profiler.beginGpu("terrain");
         glClearColor(0.529f, 0.808f, 0.922f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        ourShader.use();
+        //The variant of vs.vs for the colour mode, the points add the quantized positions to it 
+        unsigned int colorFeatures = heightColors ? HEIGHT_COLOR : 0;
+        Shader& ourShader = useSurfaceShader(colorFeatures);
 
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 500.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        cameraUniforms.update(projection, view);
 
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
+        ourShader.set(surfaceUniforms[colorFeatures].model, model);
 
-        //Rendering the points 
-        glBindVertexArray(VAO);
-        glPointSize(3.0f); 
-        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(points.size()));
-        glBindVertexArray(0);
+        if (terrainView == SHOW_WATER)
+        {
+            //Only the tiles that changed since the last frame are copied into the texture 
+            profiler.beginCpu("dem tiles");
+            erosion.takeChangedTiles([&](int tileX, int tileY, const float* data) { uploadDemTile(demMesh, streamBuffer, tileX, tileY, data); });
+            profiler.endCpu();
+            demShader.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, demMesh.texture);
+            glBindVertexArray(demMesh.VAO);
+            glDrawElements(GL_TRIANGLES, demMesh.indexCount, GL_UNSIGNED_INT, 0);
+            glBindVertexArray(0);
+        }
+        else if (terrainView != SHOW_POINTS)
+        {
+            //Rendering the fitted surface as a wireframe 
+            const LatticeMesh& mesh = terrainView == SHOW_LEAST_SQUARES ? fittedMesh : multilevelMesh;
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            glBindVertexArray(mesh.VAO);
+            glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
+            glBindVertexArray(0);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        }
+        else
+        {
+            //Rendering the points 
+            Shader& pointShader = useSurfaceShader(colorFeatures | QUANTIZED_POSITIONS);
+            pointShader.set(surfaceUniforms[colorFeatures | QUANTIZED_POSITIONS].model, model);
+            glBindVertexArray(VAO);
+            glPointSize(3.0f); 
+            glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(points.size()));
+            glBindVertexArray(0);
+        }
+        profiler.endGpu();
+        profiler.endCpu();
+
+        if (drawnBalls > 0)
+        {
+            //All the balls in one draw call 
+            profiler.beginCpu("balls");
+            profiler.beginGpu("balls");
+            instancedShader.use();
+            ballRenderer.draw(streamBuffer);
+            profiler.endGpu();
+            profiler.endCpu();
+        }
+
+        if (showProfiler)
+        {
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            profiler.beginCpu("overlay");
+            profilerOverlay.draw(profiler, overlayShader, streamBuffer, width, height);
+            profiler.endCpu();
+        }
 
+        streamBuffer.endFrame();
+        profiler.endFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
+    simulation.stop();
+    erosionThread.stop();
+    if (benchmark && benchmark->writeReport("benchmark.json", "Terrengdata", profiler))
+        cout << "The benchmark is written to benchmark.json" << endl;
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
-    glfwTerminate();
+    deleteLatticeMesh(fittedMesh);
+    deleteLatticeMesh(multilevelMesh);
+    deleteDemMesh(demMesh);
+    //glfwTerminate is called by glfwTerminator, after the destructors of the render loop objects 
     return 0;
 }
 
@@ -236,6 +662,76 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
+//Tessellates a spline surface and uploads it to a vertex array object with an element buffer 
+LatticeMesh createLatticeMesh(const SplineLattice& lattice, int samplesPerCell)
+{
+    vector<glm::vec3> vertices;
+    vector<unsigned int> indices;
+    lattice.tessellate(samplesPerCell, vertices, indices);
+    return createMesh(vertices, indices);
+}
+
+//Uploads a triangle mesh to a vertex array object with an element buffer 
+LatticeMesh createMesh(const vector<glm::vec3>& vertices, const vector<unsigned int>& indices)
+{
+    LatticeMesh mesh;
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
+
+    glBindVertexArray(mesh.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    mesh.indexCount = static_cast<GLsizei>(indices.size());
+    return mesh;
+}
+
+void deleteLatticeMesh(LatticeMesh& mesh)
+{
+    glDeleteVertexArrays(1, &mesh.VAO);
+    glDeleteBuffers(1, &mesh.VBO);
+    glDeleteBuffers(1, &mesh.EBO);
+}
+
+//Removes the old balls and drops new ones at random places a little above the terrain. 
+//The heights under all the new balls are found in one batch 
+void dropBalls(BallSystem& balls, const TriangleLocator& locator, int count)
+{
+    const TerrainMesh& terrain = locator.getMesh();
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<float> randomX(terrain.minCorner.x, terrain.maxCorner.x);
+    std::uniform_real_distribution<float> randomY(terrain.minCorner.y, terrain.maxCorner.y);
+    std::uniform_real_distribution<float> randomDrop(2.0f, 20.0f);
+    vector<float> x(count), y(count);
+    for (int i = 0; i < count; ++i)
+    {
+        x[i] = randomX(random);
+        y[i] = randomY(random);
+    }
+    vector<TriangleQuery> ground(count);
+    locator.locateBatch(ThreadPool::shared(), count, x.data(), y.data(), nullptr, ground.data());
+
+    balls.clear();
+    for (int i = 0; i < count; ++i)
+        balls.addBall(glm::vec3(x[i], y[i], ground[i].height + randomDrop(random) * balls.radius));
+}
+
+//Returns true only in the frame the key goes down, not every frame it is held 
+bool keyPressedOnce(GLFWwindow* window, int key)
+{
+    static bool wasPressed[GLFW_KEY_LAST + 1] = {};
+    bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+    bool once = pressed && !wasPressed[key];
+    wasPressed[key] = pressed;
+    return once;
+}
+
 //Function for conveting .laz file to a text file. The text file will contain x, y, z coordinates from the .laz file 
 void convertLazFilesToTextFiles(const string& inputFilename, const string& outputFilename)
 {  
@@ -360,12 +856,100 @@ vector<glm::vec3> loadPointsFromMultipleTextFiles(const vector<string>& textFile
     return allPoints;
 }
 
+//Samples the surface at the corner of every cell of the DEM (origin + x * cellSize, where dem.vs draws the height), 
+//sixteen rows per block of the thread pool 
+vector<float> sampleDem(const SplineLattice& lattice, const glm::vec2& origin, float cellSize, int width, int height)
+{
+    vector<float> heights(static_cast<size_t>(width) * height);
+    ThreadPool::shared().parallelFor(height, 16, [&](size_t begin, size_t end)
+        {
+            for (size_t y = begin; y < end; ++y)
+                for (int x = 0; x < width; ++x)
+                    heights[y * width + x] = lattice.evaluate(origin.x + x * cellSize, origin.y + y * cellSize);
+        });
+    return heights;
+}
 
+//Makes the texture of the DEM with the heights and no water, and a grid of at most maxMeshSize x maxMeshSize vertices 
+//that reads it. The vertices have no attributes, the shader finds the cell from the vertex number 
+DemMesh createDemMesh(const vector<float>& heights, int width, int height, int maxMeshSize)
+{
+    DemMesh mesh;
+    mesh.meshWidth = std::min(width, maxMeshSize);
+    mesh.meshHeight = std::min(height, maxMeshSize);
+    vector<unsigned int> indices;
+    indices.reserve(static_cast<size_t>(mesh.meshWidth - 1) * (mesh.meshHeight - 1) * 6);
+    for (int j = 0; j + 1 < mesh.meshHeight; ++j)
+    {
+        for (int i = 0; i + 1 < mesh.meshWidth; ++i)
+        {
+            unsigned int corner = j * mesh.meshWidth + i;
+            unsigned int quad[6] = { corner, corner + 1, corner + mesh.meshWidth, corner + 1, corner + mesh.meshWidth + 1, corner + mesh.meshWidth };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    mesh.indexCount = static_cast<GLsizei>(indices.size());
 
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.EBO);
+    glBindVertexArray(mesh.VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
 
+    //Two floats per cell, the texture is only read with texelFetch 
+    vector<float> cells(heights.size() * 2, 0.0f);
+    for (size_t i = 0; i < heights.size(); ++i)
+        cells[i * 2] = heights[i];
+    glGenTextures(1, &mesh.texture);
+    glBindTexture(GL_TEXTURE_2D, mesh.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, width, height, 0, GL_RG, GL_FLOAT, cells.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return mesh;
+}
 
+//Copies one tile of (terrain height, water depth) pairs into its part of the texture. The tile is written into the 
+//stream buffer, and the texture reads it from there as a pixel unpack buffer, so the copy happens on the GPU 
+void uploadDemTile(const DemMesh& mesh, StreamBuffer& stream, int tileX, int tileY, const float* data)
+{
+    const int tile = HydraulicErosion::TILE;
+    GLintptr offset = stream.write(data, tile * tile * 2 * sizeof(float));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stream.getBuffer());
+    glBindTexture(GL_TEXTURE_2D, mesh.texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, tileX * tile, tileY * tile, tile, tile, GL_RG, GL_FLOAT, (void*)offset);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
 
+void deleteDemMesh(DemMesh& mesh)
+{
+    glDeleteVertexArrays(1, &mesh.VAO);
+    glDeleteBuffers(1, &mesh.EBO);
+    glDeleteTextures(1, &mesh.texture);
+}
 
-
-
-
+//Follows the ray in small steps until it goes under the surface, and returns the point there. 
+//Returns false if the ray leaves the surface without hitting it 
+bool pickTerrain(const SplineLattice& lattice, const glm::vec3& origin, const glm::vec3& direction, glm::vec2& hit)
+{
+    glm::vec2 size(lattice.cellSize.x * lattice.cellsX, lattice.cellSize.y * lattice.cellsY);
+    float step = 0.5f * std::min(lattice.cellSize.x, lattice.cellSize.y);
+    float maxDistance = 2.0f * glm::length(size) + glm::length(glm::vec2(origin) - lattice.origin);
+    for (float t = 0.0f; t < maxDistance; t += step)
+    {
+        glm::vec3 point = origin + t * direction;
+        if (point.z <= lattice.evaluate(point.x, point.y))
+        {
+            glm::vec2 offset = glm::vec2(point) - lattice.origin;
+            if (offset.x < 0.0f || offset.y < 0.0f || offset.x > size.x || offset.y > size.y)
+                return false;
+            hit = glm::vec2(point);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+// Draws the profiler overlay in pixels on top of the scene. Every instance is one square of a letter: the top left
+// corner in xy and the side in w, all in pixels from the top left corner of the window.
+layout (location = 0) in vec3 aPos;              // a point of the unit cube, only x and y are used
+layout (location = 2) in vec4 instancePlace;
+layout (location = 3) in vec4 instanceColor;
+
+out vec3 ourColor;
+uniform vec2 screenSize;
+
+void main()
+{
+    vec2 pixel = instancePlace.xy + instancePlace.w * (aPos.xy + 0.5);
+    gl_Position = vec4(2.0 * pixel.x / screenSize.x - 1.0, 1.0 - 2.0 * pixel.y / screenSize.y, 0.0, 1.0);
+    ourColor = instanceColor.rgb;
+}
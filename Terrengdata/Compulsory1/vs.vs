@@ -1,15 +1,39 @@
 #version 330 core
+// Features, defined by the ShaderPermutations that compiles this file:
+// HEIGHT_COLOR         colours by height, from blue at heightRange.x to red at heightRange.y, instead of aColor
+// QUANTIZED_POSITIONS  aPos is 16-bit normalized inside a box, the position is positionOffset + positionScale * aPos
 layout (location = 0) in vec3 aPos;   // the position variable has attribute position 0
 layout (location = 1) in vec3 aColor; // the color variable has attribute position 1
   
 out vec3 ourColor; // output a color to the fragment shader
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera  // shared by all programs, updated once per frame
+{
+    mat4 projection;
+    mat4 view;
+};
+#ifdef HEIGHT_COLOR
+uniform vec2 heightRange;
+#endif
+#ifdef QUANTIZED_POSITIONS
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+#endif
 
 
 void main()
 {
-    gl_Position = projection * view * model* vec4(aPos, 1.0f);
+#ifdef QUANTIZED_POSITIONS
+    vec4 worldPosition = model * vec4(positionOffset + positionScale * aPos, 1.0f);
+#else
+    vec4 worldPosition = model * vec4(aPos, 1.0f);
+#endif
+    gl_Position = projection * view * worldPosition;
+#ifdef HEIGHT_COLOR
+    float height = clamp((worldPosition.z - heightRange.x) / (heightRange.y - heightRange.x), 0.0, 1.0);
+    ourColor = height < 0.5 ? mix(vec3(0.1, 0.3, 0.9), vec3(0.2, 0.8, 0.2), 2.0 * height)
+                            : mix(vec3(0.2, 0.8, 0.2), vec3(0.9, 0.2, 0.1), 2.0 * height - 1.0);
+#else
     ourColor = aColor; // set ourColor to the input color we got from the vertex data
-}       
\ No newline at end of file
+#endif
+}       